@@ -0,0 +1,82 @@
+/*
+ * FwCrc.cpp
+ *
+ *  Created on: 19 10 2026
+ *      Author: agent
+ */
+
+#include "FwCrc.h"
+#include "kl_lib.h"
+#include <stddef.h>
+
+static uint32_t ICrcWord(uint32_t Crc, uint32_t Word) {
+    Crc ^= Word;
+    for(uint32_t i=0; i<32; i++) {
+        if(Crc & 0x80000000UL) Crc = (Crc << 1) ^ 0x04C11DB7UL;
+        else Crc <<= 1;
+    }
+    return Crc;
+}
+
+uint32_t FwCrc32(const void *PData, uint32_t Len, uint32_t Crc) {
+    const uint8_t *p = (const uint8_t*)PData;
+    for(; Len >= 4; Len -= 4, p += 4) {
+        Crc = ICrcWord(Crc, p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24));
+    }
+    if(Len != 0) {
+        uint32_t Word = 0xFFFFFFFFUL;
+        for(uint32_t i=0; i<Len; i++) {
+            Word &= ~(0xFFUL << (i * 8));
+            Word |= (uint32_t)p[i] << (i * 8);
+        }
+        Crc = ICrcWord(Crc, Word);
+    }
+    return Crc;
+}
+
+uint32_t FwCrc32Hw(const void *PData, uint32_t Len) {
+    const stm32_dma_stream_t *PDma = dmaStreamAlloc(CRC_DMA, IRQ_PRIO_LOW, nullptr, nullptr);
+    if(PDma == nullptr) return FwCrc32(PData, Len);
+    rccEnableAHB1(RCC_AHB1ENR_CRCEN, FALSE);
+    // Defaults: 32-bit poly, no reversal of input or output
+    CRC->INIT = FW_CRC_INIT;
+    CRC->POL = 0x04C11DB7UL;
+    CRC->CR = CRC_CR_RESET;
+    const uint8_t *p = (const uint8_t*)PData;
+    uint32_t WordCnt = Len / 4;
+    while(WordCnt != 0) {
+        uint32_t N = (WordCnt > 0xFFFFUL)? 0xFFFFUL : WordCnt;
+        dmaStreamSetPeripheral(PDma, p);
+        dmaStreamSetMemory0(PDma, &CRC->DR);
+        dmaStreamSetTransactionSize(PDma, N);
+        dmaStreamSetMode(PDma, CRC_DMA_MODE);
+        dmaStreamEnable(PDma);
+        dmaWaitCompletion(PDma);
+        p += N * 4;
+        WordCnt -= N;
+    }
+    Len &= 3UL;
+    if(Len != 0) {
+        uint32_t Word = 0xFFFFFFFFUL;
+        for(uint32_t i=0; i<Len; i++) {
+            Word &= ~(0xFFUL << (i * 8));
+            Word |= (uint32_t)p[i] << (i * 8);
+        }
+        CRC->DR = Word;
+    }
+    uint32_t Crc = CRC->DR;
+    rccDisableAHB1(RCC_AHB1ENR_CRCEN);
+    dmaStreamFree(PDma);
+    return Crc;
+}
+
+uint8_t FwVerify(uint32_t AppStart, uint32_t MaxSz, const FwManifest_t **PPManifest) {
+    uint32_t Offset = *(uint32_t*)(AppStart + FW_MANIFEST_PTR_OFFSET);
+    if(Offset == 0xFFFFFFFFUL) return retvFail; // Erased: writing was cut
+    if(Offset == 0 or Offset & 3UL or Offset > (MaxSz - sizeof(FwManifest_t))) return retvNotFound;
+    const FwManifest_t *PMan = (const FwManifest_t*)(AppStart + Offset);
+    if(PMan->Magic != FW_MANIFEST_MAGIC or PMan->Len != Offset) return retvFail;
+    *PPManifest = PMan;
+    uint32_t Crc = FwCrc32Hw((void*)AppStart, Offset + offsetof(FwManifest_t, Crc));
+    return (Crc == PMan->Crc)? retvOk : retvFail;
+}
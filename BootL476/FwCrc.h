@@ -0,0 +1,40 @@
+/*
+ * FwCrc.h
+ *
+ *  Created on: 19 10 2026
+ *      Author: agent
+ */
+
+#pragma once
+
+#include <inttypes.h>
+
+/* CRC32 of firmware image, the way STM32 CRC unit computes it by default:
+ * poly 0x04C11DB7, init 0xFFFFFFFF, no reflection, no final xor; data is fed
+ * by 32-bit little-endian words, tail is padded with 0xFF up to a word.
+ * Tools/fwimage.py computes the same one.
+ * May be computed by chunks, passing previous result as Crc; all chunks but
+ * the last one must be multiple of 4 bytes.
+ */
+#define FW_CRC_INIT     0xFFFFFFFFUL
+
+uint32_t FwCrc32(const void *PData, uint32_t Len, uint32_t Crc = FW_CRC_INIT);
+// Same CRC by CRC unit fed by DMA: one bus transfer per word, CPU is idle
+uint32_t FwCrc32Hw(const void *PData, uint32_t Len);
+
+/* Manifest is appended to image by Tools/fwimage.py manifest. Its offset is
+ * put to reserved vector 7 (offset 0x1C), as the image length is unknown
+ * otherwise. Crc covers the image and manifest fields before it. */
+#define FW_MANIFEST_MAGIC       0x464D4B4CUL    // "LKMF"
+#define FW_MANIFEST_PTR_OFFSET  0x1CUL
+
+struct FwManifest_t {
+    uint32_t Magic, Len, Version, Crc;
+};
+
+/* retvOk if manifest is found and CRC matches, retvNotFound if image has no
+ * manifest, retvFail on CRC mismatch. PPManifest is set if manifest is found.
+ * Image without manifest has odd handler address or zero in vector 7, so
+ * erased vector 7, or pointer to something else than manifest, mean image
+ * writing was cut: retvFail too. */
+uint8_t FwVerify(uint32_t AppStart, uint32_t MaxSz, const FwManifest_t **PPManifest);
@@ -0,0 +1,90 @@
+/*
+ * FwDelta.cpp
+ *
+ *  Created on: 19 10 2026
+ *      Author: agent
+ */
+
+#include "FwDelta.h"
+#include "kl_lib.h"
+#include <string.h>
+
+namespace FwDelta {
+
+static FIL *IFile;
+static uint32_t IAppStart, INewLen;
+static Run_t IRun;   // Current run: Offset and Len of data not yet read
+static bool IEnded, IError;
+
+// Reads next run header if current one is exhausted
+static void IGetRun() {
+    if(IRun.Len != 0 or IEnded) return;
+    UINT N;
+    if(f_read(IFile, &IRun, sizeof(Run_t), &N) != FR_OK) IError = true;
+    else if(N == 0) IEnded = true;
+    else if(N != sizeof(Run_t) or IRun.Len == 0 or (IRun.Offset + IRun.Len) > INewLen) IError = true;
+    if(IError) { IEnded = true; IRun.Len = 0; }
+}
+
+uint8_t Start(FIL *PFile, uint32_t AppStart, Header_t *PHdr) {
+    UINT N;
+    if(f_read(PFile, PHdr, sizeof(Header_t), &N) != FR_OK or N != sizeof(Header_t)) return retvFail;
+    if(PHdr->Magic != FW_DELTA_MAGIC) return retvBadValue;
+    IFile = PFile;
+    IAppStart = AppStart;
+    INewLen = PHdr->NewLen;
+    IRun.Len = 0;
+    IEnded = false;
+    IError = false;
+    return retvOk;
+}
+
+uint32_t BuildPage(uint32_t Offset, uint32_t *PBuf, uint32_t PageSz) {
+    if(Offset >= INewLen or IError) return 0;
+    uint32_t Len = INewLen - Offset;
+    if(Len > PageSz) Len = PageSz;
+    uint8_t *p = (uint8_t*)PBuf;
+    memcpy(p, (void*)(IAppStart + Offset), Len);
+    uint32_t End = Offset + Len;
+    while(true) {
+        IGetRun();
+        if(IEnded or IRun.Offset >= End) break;
+        if(IRun.Offset < Offset) { IError = true; return 0; } // Unsorted or overlapping
+        uint32_t N = End - IRun.Offset;
+        if(N > IRun.Len) N = IRun.Len;
+        UINT NRead;
+        if(f_read(IFile, &p[IRun.Offset - Offset], N, &NRead) != FR_OK or NRead != N) {
+            IError = true;
+            return 0;
+        }
+        IRun.Offset += N;
+        IRun.Len -= N;
+    }
+    if(IError) return 0;
+    while(Len & 7UL) p[Len++] = 0xFF;
+    return Len;
+}
+
+uint8_t SkipTo(uint32_t Offset) {
+    while(true) {
+        IGetRun();
+        if(IEnded or IRun.Offset >= Offset) break;
+        uint32_t N = Offset - IRun.Offset;
+        if(N > IRun.Len) N = IRun.Len;
+        FSIZE_t Pos = f_tell(IFile) + N;
+        if(f_lseek(IFile, Pos) != FR_OK or f_tell(IFile) != Pos) { // File is shorter than runs say
+            IError = true;
+            break;
+        }
+        IRun.Offset += N;
+        IRun.Len -= N;
+    }
+    return IError? retvFail : retvOk;
+}
+
+bool Error() {
+    IGetRun();
+    return IError or !IEnded;
+}
+
+} // namespace
@@ -0,0 +1,44 @@
+/*
+ * FwDelta.h
+ *
+ *  Created on: 19 10 2026
+ *      Author: agent
+ */
+
+#pragma once
+
+#include "ff.h"
+
+/* Delta file: changes of new image against the one in flash (base).
+ *  Header_t | Run_t, data[Len] | Run_t, data[Len] | ...
+ * Runs are sorted and do not overlap; Offset is relative to app start.
+ * Any byte of new image which is not covered by runs equals to base one,
+ * so bytes beyond BaseLen must be covered. Both images are identified by
+ * FwCrc32 of their length. Made by Tools/fwimage.py diff.
+ */
+
+#define FW_DELTA_MAGIC      0x46444C4BUL    // "KLDF"
+
+namespace FwDelta {
+
+struct Header_t {
+    uint32_t Magic, BaseLen, BaseCrc, NewLen, NewCrc;
+} __attribute__((packed));
+
+struct Run_t {
+    uint32_t Offset;
+    uint16_t Len;
+} __attribute__((packed));
+
+// retvOk if header is fine; runs will be read starting after it
+uint8_t Start(FIL *PFile, uint32_t AppStart, Header_t *PHdr);
+/* Fills PBuf with page of new image at Offset: base page overlaid by runs.
+ * Returns count of bytes, padded with 0xFF up to double word; 0 at the end of
+ * image or on error, see Error(). Pages must be requested in order. */
+uint32_t BuildPage(uint32_t Offset, uint32_t *PBuf, uint32_t PageSz);
+// Skips data of runs below Offset, which is built already; used to resume
+uint8_t SkipTo(uint32_t Offset);
+// True if file is damaged: read error, unsorted run or unused runs left
+bool Error();
+
+} // namespace
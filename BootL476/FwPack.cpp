@@ -0,0 +1,113 @@
+/*
+ * FwPack.cpp
+ *
+ *  Created on: 19 10 2026
+ *      Author: agent
+ */
+
+#include "FwPack.h"
+#include "kl_lib.h"
+
+#define IN_BUF_SZ       512UL
+#define WIN_MASK        (FW_PACK_WINDOW - 1)
+
+namespace FwPack {
+
+uint32_t Cycles;
+
+static FIL *IFile;
+static uint8_t IIn[IN_BUF_SZ];
+static uint32_t IInPos, IInCnt;
+static uint8_t IWin[FW_PACK_WINDOW];
+static uint32_t IWinPos, IOutLeft;
+static uint32_t ILitLeft, IMatchLeft, IMatchOffset;
+static uint8_t IToken;
+static bool IMatchPending, IError;
+
+// -1 at the end of file or on error
+static int32_t IGetByte() {
+    if(IInPos >= IInCnt) {
+        UINT N;
+        if(f_read(IFile, IIn, IN_BUF_SZ, &N) != FR_OK or N == 0) {
+            IError = true;
+            return -1;
+        }
+        IInCnt = N;
+        IInPos = 0;
+    }
+    return IIn[IInPos++];
+}
+
+// Length extension: bytes are added while they equal 255
+static uint32_t IGetLen(uint32_t Len) {
+    if(Len != 15) return Len;
+    int32_t b;
+    do {
+        b = IGetByte();
+        if(b < 0) return 0;
+        Len += b;
+    } while(b == 255);
+    return Len;
+}
+
+uint8_t Start(FIL *PFile, Header_t *PHdr) {
+    UINT N;
+    if(f_read(PFile, PHdr, sizeof(Header_t), &N) != FR_OK or N != sizeof(Header_t)) return retvFail;
+    if(PHdr->Magic != FW_PACK_MAGIC or PHdr->Window > FW_PACK_WINDOW) return retvBadValue;
+    IFile = PFile;
+    IInPos = 0;
+    IInCnt = 0;
+    IWinPos = 0;
+    IOutLeft = PHdr->OrigLen;
+    ILitLeft = 0;
+    IMatchLeft = 0;
+    IMatchPending = false;
+    IError = false;
+    Cycles = 0;
+    CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+    DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+    return retvOk;
+}
+
+uint32_t Read(uint8_t *PDst, uint32_t Len) {
+    uint32_t StartCnt = DWT->CYCCNT;
+    uint32_t N = 0;
+    while(N < Len and IOutLeft != 0 and !IError) {
+        uint8_t b;
+        if(ILitLeft != 0) {
+            int32_t c = IGetByte();
+            if(c < 0) break;
+            b = c;
+            ILitLeft--;
+        }
+        else if(IMatchLeft != 0) {
+            b = IWin[(IWinPos - IMatchOffset) & WIN_MASK];
+            IMatchLeft--;
+        }
+        else if(IMatchPending) {
+            int32_t Lo = IGetByte(), Hi = IGetByte();
+            IMatchOffset = (Lo & 0xFF) | ((Hi & 0xFF) << 8);
+            if(IMatchOffset == 0 or IMatchOffset > FW_PACK_WINDOW or IMatchOffset > IWinPos) IError = true;
+            IMatchLeft = IGetLen(IToken & 0x0F) + 4;
+            IMatchPending = false;
+            continue;
+        }
+        else { // Next sequence
+            int32_t c = IGetByte();
+            if(c < 0) break;
+            IToken = c;
+            ILitLeft = IGetLen(IToken >> 4);
+            IMatchPending = true;
+            continue;
+        }
+        PDst[N++] = b;
+        IWin[IWinPos++ & WIN_MASK] = b;
+        IOutLeft--;
+    }
+    Cycles += DWT->CYCCNT - StartCnt;
+    return N;
+}
+
+bool Error() { return IError; }
+
+} // namespace
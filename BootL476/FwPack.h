@@ -0,0 +1,37 @@
+/*
+ * FwPack.h
+ *
+ *  Created on: 19 10 2026
+ *      Author: agent
+ */
+
+#pragma once
+
+#include "ff.h"
+
+/* Packed image: Header_t followed by LZ4 block format sequences:
+ *  Token | [Literal len ext] | Literals | Offset u16 | [Match len ext]
+ * Match offset never exceeds window, so decoder needs window-sized history
+ * only, whatever the image size. Last sequence has literals only; stream ends
+ * when OrigLen bytes are produced. Made by Tools/fwimage.py pack.
+ */
+
+#define FW_PACK_MAGIC       0x5A504B4BUL    // "KKPZ"
+#define FW_PACK_WINDOW      4096UL          // Power of 2; RAM used for history
+
+namespace FwPack {
+
+struct Header_t {
+    uint32_t Magic, OrigLen, OrigCrc, Window;
+} __attribute__((packed));
+
+// Reads header and (re)starts unpacking from the beginning of stream
+uint8_t Start(FIL *PFile, Header_t *PHdr);
+// Unpacks up to Len bytes; returns count, less than Len at the end of image or on error
+uint32_t Read(uint8_t *PDst, uint32_t Len);
+// True if stream is damaged: read error, bad offset, premature end
+bool Error();
+// CPU cycles spent in Read() since Start()
+extern uint32_t Cycles;
+
+} // namespace
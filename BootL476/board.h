@@ -50,6 +50,11 @@
 #define UART_DMA_TX_MODE(Chnl) (STM32_DMA_CR_CHSEL(Chnl) | DMA_PRIORITY_LOW | STM32_DMA_CR_MSIZE_BYTE | STM32_DMA_CR_PSIZE_BYTE | STM32_DMA_CR_MINC | STM32_DMA_CR_DIR_M2P | STM32_DMA_CR_TCIE)
 #define UART_DMA_RX_MODE(Chnl) (STM32_DMA_CR_CHSEL(Chnl) | DMA_PRIORITY_MEDIUM | STM32_DMA_CR_MSIZE_BYTE | STM32_DMA_CR_PSIZE_BYTE | STM32_DMA_CR_MINC | STM32_DMA_CR_DIR_P2M | STM32_DMA_CR_CIRC)
 
+// ==== CRC unit ====
+// Flash is source (peripheral address, incremented), CRC->DR is destination
+#define CRC_DMA         STM32_DMA_STREAM_ID(1, 1)
+#define CRC_DMA_MODE    (STM32_DMA_CR_CHSEL(0) | DMA_PRIORITY_VERYHIGH | STM32_DMA_CR_MSIZE_WORD | STM32_DMA_CR_PSIZE_WORD | STM32_DMA_CR_PINC | STM32_DMA_CR_DIR_M2M)
+
 #endif // DMA
 
 #if 1 // ========================== USART ======================================
@@ -64,3 +69,13 @@
     UART_DMA_TX, UART_DMA_RX, UART_DMA_TX_MODE(UART_DMA_CHNL), UART_DMA_RX_MODE(UART_DMA_CHNL), uartclkHSI
 
 #endif
+
+#if 1 // ====================== Backup registers ===============================
+// Shared by bootloader and app: keep the same in both board.h
+#define BKPREG_FW_PENDING       0   // FW_PENDING_MAGIC: app has found firmware file on disk
+#define BKPREG_BOOT_US          1   // Time from reset to jump to app, us; written by bootloader
+#define BKPREG_DELTA_ID         2   // Delta being applied in place, see FlashDelta in bootloader
+#define BKPREG_DELTA_DONE       3   // Offset of the first page not written yet by that delta
+#define BKPREG_DISK_PAGE        4   // Disk page held by scratch page, see WriteDiskPage in bootloader
+#define FW_PENDING_MAGIC        0x46575550UL
+#endif
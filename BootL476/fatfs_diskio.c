@@ -56,7 +56,6 @@ DRESULT disk_read (
 
 /*-----------------------------------------------------------------------*/
 /* Write Sector(s)                                                       */
-void ErasePage(uint32_t Addr);
 void WriteToMemory(uint32_t Addr, uint32_t *PBuf, uint32_t Len);
 
 static uint32_t IBuf[(BLOCK_SZ / sizeof(uint32_t))];
@@ -72,7 +71,6 @@ DRESULT disk_write (
 //    PrintfC("\r__DiskW");
     uint32_t Addr = FLASH_STORAGE_ADDR + (sector * BLOCK_SZ);
     while(count > 0) {
-        ErasePage(Addr);
         memcpy(IBuf, buff, BLOCK_SZ);
         WriteToMemory(Addr, IBuf, BLOCK_SZ);
         buff += BLOCK_SZ;
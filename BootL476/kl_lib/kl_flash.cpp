@@ -0,0 +1,77 @@
+/*
+ * kl_flash.cpp
+ *
+ *  Created on: 19 10 2026
+ *      Author: agent
+ */
+
+#include "kl_lib.h"
+
+/* Flash update policy over the low level Flash functions of kl_lib.cpp.
+ * It touches no registers, so host tests build it against the flash model. */
+
+#if defined STM32L4XX
+namespace Flash {
+
+UpdateStat_t UpdateStat;
+
+// Page torn by power loss may hold cells failing ECC check: it is to be erased
+static void IComparePage(uint32_t Address, const uint32_t *PData, int32_t ASzBytes, bool *PIsSame, bool *PCanProgram) {
+    const uint32_t *PCur = (const uint32_t*)Address;
+    uint32_t DWordCnt = (ASzBytes + 7) / 8;
+    *PIsSame = true;
+    *PCanProgram = true;
+    StartEccCheck();
+    for(uint32_t i=0; i<DWordCnt*2; i+=2) {
+        if(PCur[i] != PData[i] or PCur[i+1] != PData[i+1]) {
+            *PIsSame = false;
+            // Double word may be programmed only once after erase
+            if(PCur[i] != 0xFFFFFFFF or PCur[i+1] != 0xFFFFFFFF) {
+                *PCanProgram = false;
+                break;
+            }
+        }
+    }
+    if(EndEccCheck() != retvOk) {
+        *PIsSame = false;
+        *PCanProgram = false;
+    }
+}
+
+bool PageNeedsErase(uint32_t Address, const uint32_t *PData, int32_t ASzBytes) {
+    bool IsSame, CanProgram;
+    IComparePage(Address, PData, ASzBytes, &IsSame, &CanProgram);
+    return !IsSame and !CanProgram;
+}
+
+// Address must be page-aligned, flash must be unlocked
+uint8_t UpdatePage(uint32_t Address, uint32_t *PData, int32_t ASzBytes) {
+    const uint32_t *PCur = (const uint32_t*)Address;
+    uint32_t DWordCnt = (ASzBytes + 7) / 8;
+    bool IsSame, CanProgram;
+    IComparePage(Address, PData, ASzBytes, &IsSame, &CanProgram);
+    if(IsSame) {
+        UpdateStat.Skipped++;
+        return retvOk;
+    }
+    if(CanProgram) {
+        UpdateStat.ProgramOnly++;
+        // Program runs of changed double words
+        uint32_t i = 0;
+        while(i < DWordCnt) {
+            if(PCur[2*i] == PData[2*i] and PCur[2*i+1] == PData[2*i+1]) { i++; continue; }
+            uint32_t Start = i;
+            while(i < DWordCnt and (PCur[2*i] != PData[2*i] or PCur[2*i+1] != PData[2*i+1])) i++;
+            uint8_t status = ProgramBuf32(Address + Start * 8, &PData[2*Start], (i - Start) * 8);
+            if(status != retvOk) return status;
+        }
+        return retvOk;
+    }
+    UpdateStat.FullErase++;
+    uint8_t status = ErasePage((Address - FLASH_BASE) / FLASH_PAGE_SZ_BYTES);
+    if(status == retvOk) status = ProgramBuf32(Address, PData, DWordCnt * 8);
+    return status;
+}
+
+} // namespace
+#endif
@@ -453,6 +453,10 @@ void TmrKL_t::IIrqHandler() {    // Call it inside callback
 #endif
 
 #if 1 // ============================= DEBUG ===================================
+#if defined STM32L4XX
+namespace Flash { extern volatile bool IEccProbe, IEccFault; }
+#endif
+
 extern "C" {
 
 void chDbgPanic(const char *msg1) {
@@ -484,6 +488,23 @@ void HardFault_Handler(void) {
     while(true);
 }
 
+#if defined STM32L4XX
+// Double ECC error in flash: expected inside ECC check, fatal elsewhere
+void NMI_Handler(void) {
+    if(FLASH->ECCR & FLASH_ECCR_ECCD) {
+        FLASH->ECCR |= FLASH_ECCR_ECCD; // Clear flag
+        if(Flash::IEccProbe) {
+            Flash::IEccFault = true;
+            return;
+        }
+        PrintErrMsg("\rFlash ECC error\r");
+    }
+    else PrintErrMsg("\rNMI\r");
+    __ASM volatile("BKPT #01");
+    while(true);
+}
+#endif
+
 } // extern C
 #endif
 
@@ -675,6 +696,27 @@ uint8_t ProgramBuf32(uint32_t Address, uint32_t *PData, int32_t ASzBytes) {
     }
     return status;
 }
+
+// NMI handler reports double ECC error here while reading
+volatile bool IEccProbe = false, IEccFault = false;
+
+void StartEccCheck() {
+    IEccFault = false;
+    IEccProbe = true;
+}
+
+uint8_t EndEccCheck() {
+    __DSB();
+    __ISB();
+    IEccProbe = false;
+    return IEccFault? retvFail : retvOk;
+}
+
+uint8_t ReadChecked(void *PDst, uint32_t Addr, uint32_t Sz) {
+    StartEccCheck();
+    memcpy(PDst, (const void*)Addr, Sz);
+    return EndEccCheck();
+}
 #else
 uint8_t ProgramWord(uint32_t Address, uint32_t Data) {
     uint8_t status = WaitForLastOperation(FLASH_ProgramTimeout);
@@ -354,7 +354,7 @@ static inline void DelayLoop(volatile uint32_t ACounter) { while(ACounter--); }
 // On writes, write 0x5FA to VECTKEY, otherwise the write is ignored. 4 is SYSRESETREQ: System reset request
 #define REBOOT()                SCB->AIRCR = 0x05FA0004
 
-#if 0 // ======================= Power and backup unit =========================
+#if 1 // ======================= Power and backup unit =========================
 namespace BackupSpc {
     static inline void EnableAccess() {
         rccEnablePWRInterface(FALSE);
@@ -1414,12 +1414,31 @@ public:
 // =========================== Flash and Option bytes ==========================
 namespace Flash {
 
+#if defined STM32L4XX
+#define FLASH_PAGE_SZ_BYTES     2048UL
+#endif
+
 void UnlockFlash();
 void LockFlash();
 
 uint8_t ErasePage(uint32_t PageAddress);
 #if defined STM32L4XX
 uint8_t ProgramBuf32(uint32_t Address, uint32_t *PData, int32_t ASzBytes);
+// Compares data with page contents: skips identical page, programs changed
+// double words if they are erased, erases and programs otherwise
+struct UpdateStat_t {
+    uint32_t Skipped, ProgramOnly, FullErase;
+};
+extern UpdateStat_t UpdateStat;
+uint8_t UpdatePage(uint32_t Address, uint32_t *PData, int32_t ASzBytes);
+// True if data cannot be put to page without erasing it
+bool PageNeedsErase(uint32_t Address, const uint32_t *PData, int32_t ASzBytes);
+// Double word torn by power loss may fail ECC check and raise NMI when read.
+// Copies data and returns retvFail instead, if ECC error occurred.
+uint8_t ReadChecked(void *PDst, uint32_t Addr, uint32_t Sz);
+// Same for all reads in between, by CPU or DMA; data read from torn cell is garbage
+void StartEccCheck();
+uint8_t EndEccCheck();
 #else
 uint8_t ProgramWord(uint32_t Address, uint32_t Data);
 uint8_t ProgramBuf(void *PData, uint32_t ByteSz, uint32_t Addr);
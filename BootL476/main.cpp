@@ -5,6 +5,10 @@
 #include "led.h"
 #include "ff.h"
 #include "kl_fs_utils.h"
+#include "FwCrc.h"
+#include "FwDelta.h"
+#include "FwPack.h"
+#include <stddef.h>
 
 #if 1 // =============== Low level ================
 // Forever
@@ -16,26 +20,71 @@ LedBlinker_t Led(LED_PIN, omPushPull);
 
 // Setup this
 #define FILENAME_PATTERN        "Fw*.bin"
+#define PACKED_PATTERN          "Fw*.fwz"   // Used if no plain image found, see FwPack.h
+#define DELTA_PATTERN           "Fw*.dlt"   // Used if no full image found, see FwDelta.h
 #define BOOTLOADER_RSRVD_SPACE  0x8000UL    // 32768 bytes for bootloader
 #define TOTAL_FLASH_SZ          256000UL
 #define PAGE_SZ                 2048L       // bytes in page, see datasheet
 //// Do not touch
 #define FLASH_START_ADDR        0x08000000UL
 #define APP_START_ADDR          (FLASH_START_ADDR + BOOTLOADER_RSRVD_SPACE)
+#define APP_END_ADDR            0x08020000UL    // FAT disk starts here, see fatfs_diskio.c
+#define APP_MAX_SZ              (APP_END_ADDR - APP_START_ADDR)
+#define DISK_END_ADDR           (APP_END_ADDR + 0x20000UL)  // 128 KB, see fatfs_diskio.c
 //#define APP_START_PAGE          (BOOTLOADER_RSRVD_SPACE / PAGE_SZ)
 //#define TOTAL_PAGE_CNT          (TOTAL_FLASH_SZ / PAGE_SZ)
 //#define APP_PAGE_CNT            ((TOTAL_FLASH_SZ - BOOTLOADER_RSRVD_SPACE) / PAGE_SZ)
 
 void JumpToApp();
+void Update();
 extern "C" { // used in fatfs_diskio.c
-void ErasePage(uint32_t Addr);
 void WriteToMemory(uint32_t Addr, uint32_t *PBuf, uint32_t Len);
 }
+// Power loss during update may leave torn cells in app: it is broken then, not empty
 static inline bool AppIsEmpty() {
-    uint32_t FirstWord = *(uint32_t*)APP_START_ADDR;
+    uint32_t FirstWord;
+    if(Flash::ReadChecked(&FirstWord, APP_START_ADDR, 4) != retvOk) return false;
     return (FirstWord == 0xFFFFFFFF);
 }
 
+/* App sets marker when it finds firmware file on disk; FS is not mounted otherwise.
+ * Marker is cleared only when update is done or there is no file: app restarts
+ * to update only if marker is clear, so a bad file does not cause reboot loop. */
+static inline bool UpdateIsPending() {
+    return (BackupSpc::ReadRegister(BKPREG_FW_PENDING) == FW_PENDING_MAGIC);
+}
+static void ClearUpdatePending() {
+    BackupSpc::EnableAccess();
+    BackupSpc::WriteRegister(BKPREG_FW_PENDING, 0);
+    BackupSpc::DisableAccess();
+}
+
+// DWT cycles are counted from main() start, converted at clock change
+static uint32_t BootTime_us = 0;
+
+// Image without manifest is accepted as is: it cannot be checked
+static bool AppVerified = false;
+static uint32_t AppLen = APP_MAX_SZ; // Known from manifest only
+static bool VerifyApp() {
+    const FwManifest_t *PMan = nullptr;
+    systime_t Start = chVTGetSystemTimeX();
+    Flash::StartEccCheck();
+    uint8_t Rslt = FwVerify(APP_START_ADDR, APP_MAX_SZ, &PMan);
+    bool IsTorn = (Flash::EndEccCheck() != retvOk);
+    uint32_t Time_us = TIME_I2US(chVTTimeElapsedSinceX(Start));
+    if(IsTorn) {
+        Printf("App has torn cells\r");
+        Rslt = retvFail;
+    }
+    else if(Rslt == retvNotFound) Printf("No manifest, app not verified\r");
+    else if(PMan == nullptr) Printf("App is not complete\r");
+    else Printf("App v%u, %u bytes: CRC %S; verify %u.%03u ms\r", PMan->Version, PMan->Len,
+            (Rslt == retvOk)? "ok" : "FAIL", Time_us / 1000, Time_us % 1000);
+    AppVerified = (Rslt != retvFail);
+    if(Rslt == retvOk) AppLen = PMan->Len;
+    return AppVerified;
+}
+
 void OnError() {
     if(AppIsEmpty()) {
         Led.StartOrRestart(lsqError); // Display error
@@ -46,13 +95,330 @@ void OnError() {
 
 FATFS FlashFS;
 uint32_t Buf[(PAGE_SZ / 4)];
+
+// Reads next page of file, padding its tail up to double word: flash is programmed by 8 bytes
+static uint32_t ReadPage() {
+    UINT BytesCnt;
+    if(f_read(&CommonFile, Buf, PAGE_SZ, &BytesCnt) != FR_OK) {
+        Printf("Read error\r");
+        OnError();
+    }
+    while(BytesCnt & 7UL) ((uint8_t*)Buf)[BytesCnt++] = 0xFF;
+    return BytesCnt;
+}
+
+static uint32_t UnpackPage() {
+    uint32_t BytesCnt = FwPack::Read((uint8_t*)Buf, PAGE_SZ);
+    if(FwPack::Error()) {
+        Printf("Unpack error\r");
+        OnError();
+    }
+    while(BytesCnt & 7UL) ((uint8_t*)Buf)[BytesCnt++] = 0xFF;
+    return BytesCnt;
+}
+
+static void StartUnpack(FwPack::Header_t *PHdr) {
+    f_rewind(&CommonFile);
+    if(FwPack::Start(&CommonFile, PHdr) != retvOk) {
+        Printf("Bad packed image\r");
+        OnError();
+    }
+}
+
+/* Check pass: unpack all the image and check its CRC before anything is
+ * erased, as damaged stream would be found in the middle of erase pass
+ * otherwise. Unpacking is cheap comparing to flash operations. */
+static uint32_t CheckPacked() {
+    FwPack::Header_t Hdr;
+    StartUnpack(&Hdr);
+    if(Hdr.OrigLen > APP_MAX_SZ) {
+        Printf("Error: too large image\r");
+        OnError();
+    }
+    uint32_t BytesCnt, Len = 0, Crc = FW_CRC_INIT;
+    while((BytesCnt = FwPack::Read((uint8_t*)Buf, PAGE_SZ)) != 0) {
+        Crc = FwCrc32(Buf, BytesCnt, Crc);
+        Len += BytesCnt;
+    }
+    if(FwPack::Error() or Len != Hdr.OrigLen or Crc != Hdr.OrigCrc) {
+        Printf("Packed image is damaged\r");
+        OnError();
+    }
+    uint32_t PackedLen = f_size(&CommonFile);
+    uint32_t Ratio_x100 = (uint64_t)Len * 100 / PackedLen;
+    uint32_t Speed_kBps = (uint64_t)Len * (Clk.AHBFreqHz / 1000) / (FwPack::Cycles? FwPack::Cycles : 1);
+    Printf("Packed: %u -> %u bytes, ratio %u.%02u; unpack %u.%03u MB/s\r",
+            PackedLen, Len, Ratio_x100 / 100, Ratio_x100 % 100, Speed_kBps / 1000, Speed_kBps % 1000);
+    StartUnpack(&Hdr);
+    return Len;
+}
+
+/* Check pass for plain image: read all the file before anything is erased, so
+ * read error or truncated file do not leave half-erased app. If image has
+ * manifest, its CRC is checked too; image without it is only read through. */
+static void CheckPlain() {
+    uint32_t FileLen = f_size(&CommonFile);
+    UINT BytesCnt;
+    uint32_t Len = 0, Crc = FW_CRC_INIT, CrcLen = 0;
+    FwManifest_t Man;
+    uint8_t *PMan = (uint8_t*)&Man;
+    uint32_t ManOffset = 0;
+    systime_t Start = chVTGetSystemTimeX();
+    while(true) {
+        if(f_read(&CommonFile, Buf, PAGE_SZ, &BytesCnt) != FR_OK) {
+            Printf("Read error\r");
+            OnError();
+        }
+        if(BytesCnt == 0) break;
+        if(Len == 0 and BytesCnt > FW_MANIFEST_PTR_OFFSET + 3) {
+            ManOffset = Buf[FW_MANIFEST_PTR_OFFSET / 4];
+            if(ManOffset & 3UL or ManOffset > (FileLen - sizeof(FwManifest_t))) ManOffset = 0;
+            else CrcLen = ManOffset + offsetof(FwManifest_t, Crc);
+        }
+        // Collect manifest bytes, it may cross page boundary
+        for(uint32_t i=0; i<sizeof(FwManifest_t); i++) {
+            uint32_t Indx = ManOffset + i;
+            if(ManOffset != 0 and Indx >= Len and Indx < Len + BytesCnt) PMan[i] = ((uint8_t*)Buf)[Indx - Len];
+        }
+        if(Len < CrcLen) Crc = FwCrc32(Buf, MIN_(BytesCnt, CrcLen - Len), Crc);
+        Len += BytesCnt;
+    }
+    if(Len != FileLen) {
+        Printf("Read error\r");
+        OnError();
+    }
+    uint32_t Time_ms = TIME_I2MS(chVTTimeElapsedSinceX(Start));
+    if(ManOffset != 0 and Man.Magic == FW_MANIFEST_MAGIC and Man.Len == ManOffset) {
+        if(Crc != Man.Crc) {
+            Printf("Image is damaged\r");
+            OnError();
+        }
+        Printf("Image v%u: CRC ok; check %u ms\r", Man.Version, Time_ms);
+    }
+    else Printf("No manifest, image not checked; read %u ms\r", Time_ms);
+    f_rewind(&CommonFile);
+}
+
+static bool FindFile(const char *Pattern) {
+    if(f_findfirst(&Dir, &FileInfo, "", Pattern) != FR_OK) {
+        Printf("File search fail\r");
+        chThdSleepMilliseconds(99);
+        OnError();
+    }
+    return (FileInfo.fname[0] != 0);
+}
+
+// Plain or packed image: same passes, page source differs
+static void FlashImage(bool Packed) {
+    uint32_t (*NextPage)() = ReadPage;
+    uint32_t TotalLen = f_size(&CommonFile);
+    if(Packed) {
+        TotalLen = CheckPacked();
+        NextPage = UnpackPage;
+    }
+    else if(TotalLen > APP_MAX_SZ) {
+        Printf("Error: too large file\r");
+        OnError();
+    }
+    else CheckPlain();
+    /* Erase pass: erase in one go all the pages which cannot be programmed
+     * as is, without programming in between. Then program pass has only
+     * program operations; identical pages are skipped by both. */
+    systime_t Start = chVTGetSystemTimeX();
+    uint32_t BytesCnt, CurrentAddr = APP_START_ADDR, PreErased = 0;
+    while((BytesCnt = NextPage()) != 0) {
+        if(Flash::PageNeedsErase(CurrentAddr, Buf, BytesCnt)) {
+            if(Flash::ErasePage((CurrentAddr - FLASH_START_ADDR) / PAGE_SZ) != retvOk) {
+                Printf("Erase Fail\r");
+                chThdSleepMilliseconds(450);
+                REBOOT();
+            }
+            PreErased++;
+        }
+        CurrentAddr += BytesCnt;
+    }
+    uint32_t EraseTime_ms = TIME_I2MS(chVTTimeElapsedSinceX(Start));
+    // Program pass
+    Start = chVTGetSystemTimeX();
+    if(Packed) {
+        FwPack::Header_t Hdr;
+        StartUnpack(&Hdr);
+    }
+    else f_rewind(&CommonFile);
+    CurrentAddr = APP_START_ADDR;
+    while((BytesCnt = NextPage()) != 0) {
+        WriteToMemory(CurrentAddr, Buf, BytesCnt);
+        CurrentAddr += BytesCnt;
+    }
+    uint32_t ProgramTime_ms = TIME_I2MS(chVTTimeElapsedSinceX(Start));
+    Printf("\rWriting done: %u bytes; erase %u ms, program %u ms\r", TotalLen, EraseTime_ms, ProgramTime_ms);
+    Printf("Pages: skipped %u, pre-erased %u, programmed %u\r",
+            Flash::UpdateStat.Skipped, PreErased, Flash::UpdateStat.ProgramOnly);
+}
+
+#if 1 // ==== Delta ====
+/* Delta is applied over the image in flash, so the update costs time and wear
+ * of changed pages only. Single pass: every page is built from its own base
+ * contents, so it cannot be erased in advance.
+ * Page being rewritten loses its base, so the update is journaled to resume
+ * after power loss. New page goes to scratch page first, then BKPREG_DELTA_DONE
+ * marks it as held by scratch, then the page itself is written, then DONE moves
+ * to the next page. Pages below DONE are new ones, the rest are base. Scratch
+ * pages are the free ones after both images, taken in turn to spread wear.
+ * Backup registers keep the journal over main power loss only if VBAT is
+ * supplied; without it, a full image is needed to recover. */
+#define DELTA_SCRATCH_VALID     0x80000000UL    // Flag in BKPREG_DELTA_DONE
+
+static inline uint32_t DeltaJournalId(const FwDelta::Header_t &Hdr) {
+    return Hdr.BaseCrc ^ Hdr.NewCrc ^ FW_DELTA_MAGIC;
+}
+
+static void WriteJournal(uint32_t RegN, uint32_t Value) {
+    BackupSpc::EnableAccess();
+    BackupSpc::WriteRegister(RegN, Value);
+    BackupSpc::DisableAccess();
+}
+
+// Does not look at page before erasing: torn double word would cause ECC NMI on read
+static void RewritePage(uint32_t Addr, uint32_t *PBuf, uint32_t Len) {
+    if(Flash::ErasePage((Addr - FLASH_START_ADDR) / PAGE_SZ) != retvOk or
+            Flash::ProgramBuf32(Addr, PBuf, Len) != retvOk) {
+        Printf("Write Fail\r");
+        chThdSleepMilliseconds(450);
+        REBOOT();
+    }
+}
+
+static void FlashDelta() {
+    FwDelta::Header_t Hdr;
+    if(FwDelta::Start(&CommonFile, APP_START_ADDR, &Hdr) != retvOk or
+            Hdr.BaseLen > APP_MAX_SZ or Hdr.NewLen > APP_MAX_SZ) {
+        Printf("Bad delta\r");
+        OnError();
+    }
+    uint32_t FreeStart = (MAX_(Hdr.BaseLen, Hdr.NewLen) + PAGE_SZ - 1) & ~(PAGE_SZ - 1);
+    uint32_t ScratchCnt = (APP_MAX_SZ - FreeStart) / PAGE_SZ;
+    if(ScratchCnt == 0) { // Cannot resume without it
+        Printf("Delta: no free page for journal\r");
+        OnError();
+    }
+    uint32_t Offset = 0;
+    if(BackupSpc::ReadRegister(BKPREG_DELTA_ID) == DeltaJournalId(Hdr)) {
+        // Interrupted: base CRC does not match already; finish page in work and go on
+        uint32_t Done = BackupSpc::ReadRegister(BKPREG_DELTA_DONE);
+        Offset = Done & ~DELTA_SCRATCH_VALID;
+        if((Offset % PAGE_SZ) != 0 or Offset > FreeStart or FwDelta::SkipTo(Offset) != retvOk) {
+            Printf("Bad delta journal\r");
+            OnError();
+        }
+        Printf("Delta resumed at %u\r", Offset);
+        if(Done & DELTA_SCRATCH_VALID) {
+            memcpy(Buf, (void*)(APP_START_ADDR + FreeStart + ((Offset / PAGE_SZ) % ScratchCnt) * PAGE_SZ), PAGE_SZ);
+            RewritePage(APP_START_ADDR + Offset, Buf, PAGE_SZ);
+            Offset += PAGE_SZ;
+            if(FwDelta::SkipTo(Offset) != retvOk) {
+                Printf("Bad delta\r");
+                OnError();
+            }
+            WriteJournal(BKPREG_DELTA_DONE, Offset);
+        }
+    }
+    else {
+        if(FwCrc32Hw((void*)APP_START_ADDR, Hdr.BaseLen) != Hdr.BaseCrc) {
+            // Power loss after the journal was closed leaves applied delta on disk
+            if(FwCrc32Hw((void*)APP_START_ADDR, Hdr.NewLen) == Hdr.NewCrc) {
+                Printf("Delta already applied\r");
+                return;
+            }
+            Printf("Delta base mismatch\r");
+            OnError();
+        }
+        // Open journal: DONE is valid before ID points to it
+        WriteJournal(BKPREG_DELTA_ID, 0);
+        WriteJournal(BKPREG_DELTA_DONE, 0);
+        WriteJournal(BKPREG_DELTA_ID, DeltaJournalId(Hdr));
+    }
+    systime_t Start = chVTGetSystemTimeX();
+    uint32_t BytesCnt, Journaled = 0;
+    while((BytesCnt = FwDelta::BuildPage(Offset, Buf, PAGE_SZ)) != 0) {
+        uint32_t Addr = APP_START_ADDR + Offset;
+        if(memcmp((void*)Addr, Buf, BytesCnt) != 0) {
+            RewritePage(APP_START_ADDR + FreeStart + ((Offset / PAGE_SZ) % ScratchCnt) * PAGE_SZ, Buf, BytesCnt);
+            WriteJournal(BKPREG_DELTA_DONE, Offset | DELTA_SCRATCH_VALID);
+            WriteToMemory(Addr, Buf, BytesCnt);
+            Journaled++;
+        }
+        else Flash::UpdateStat.Skipped++;
+        Offset += PAGE_SZ;
+        WriteJournal(BKPREG_DELTA_DONE, Offset);
+    }
+    uint32_t Time_ms = TIME_I2MS(chVTTimeElapsedSinceX(Start));
+    if(FwDelta::Error() or FwCrc32Hw((void*)APP_START_ADDR, Hdr.NewLen) != Hdr.NewCrc) {
+        Printf("Delta apply fail\r"); // Base is modified already: nothing to jump to
+        Led.StartOrRestart(lsqError);
+        while(true);
+    }
+    WriteJournal(BKPREG_DELTA_ID, 0); // Close journal
+    Printf("\rDelta done: %u bytes of delta, %u -> %u bytes; %u ms\r",
+            (uint32_t)f_size(&CommonFile), Hdr.BaseLen, Hdr.NewLen, Time_ms);
+    Printf("Pages: skipped %u, journaled %u (programmed %u, erased and programmed %u)\r",
+            Flash::UpdateStat.Skipped, Journaled, Flash::UpdateStat.ProgramOnly, Flash::UpdateStat.FullErase);
+}
+#endif
+
+#if 1 // ==== Disk journal ====
+/* FatFs rewrites disk pages in place when the file is removed. Page torn by
+ * power loss would cause ECC NMI on mount at next boot, with update still
+ * pending, so disk page goes to scratch page first, then BKPREG_DISK_PAGE marks
+ * it as held by scratch, then the page itself is written. Scratch is the last
+ * app page if verified app does not reach it; otherwise page is written as is. */
+#define DISK_SCRATCH_ADDR       (APP_END_ADDR - PAGE_SZ)
+#define DISK_SCRATCH_DIRTY      1UL     // Scratch is being written, not valid
+
+static void WriteDiskPage(uint32_t Addr, uint32_t *PBuf, uint32_t Len) {
+    if(memcmp((void*)Addr, PBuf, Len) == 0) return;
+    WriteJournal(BKPREG_DISK_PAGE, DISK_SCRATCH_DIRTY);
+    RewritePage(DISK_SCRATCH_ADDR, PBuf, Len);
+    WriteJournal(BKPREG_DISK_PAGE, Addr);
+    RewritePage(Addr, PBuf, Len);
+    WriteJournal(BKPREG_DISK_PAGE, 0);
+}
+
+// Called before anything reads the disk
+static void ReplayDiskJournal() {
+    uint32_t Addr = BackupSpc::ReadRegister(BKPREG_DISK_PAGE);
+    if(Addr == 0) return;
+    chSysLock();
+    Flash::LockFlash();
+    Flash::UnlockFlash();
+    chSysUnlock();
+    if(Addr == DISK_SCRATCH_DIRTY) { // Disk page is intact, scratch may be torn
+        if(Flash::ErasePage((DISK_SCRATCH_ADDR - FLASH_START_ADDR) / PAGE_SZ) != retvOk) Printf("Erase Fail\r");
+    }
+    else if(Addr >= APP_END_ADDR and Addr < DISK_END_ADDR and (Addr % PAGE_SZ) == 0) {
+        memcpy(Buf, (void*)DISK_SCRATCH_ADDR, PAGE_SZ);
+        RewritePage(Addr, Buf, PAGE_SZ);
+        Printf("Disk page %X restored\r", Addr);
+    }
+    WriteJournal(BKPREG_DISK_PAGE, 0);
+    chSysLock();
+    Flash::LockFlash();
+    chSysUnlock();
+}
+#endif
 #endif
 
 int main(void) {
 #if 1 // ==== Init ====
+    // Boot time: core runs on MSI 4 MHz after reset
+    CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+    DWT->CYCCNT = 0;
+    DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
 //    Iwdg::InitAndStart(4500);
 //     Setup clock frequency
     Clk.SetCoreClk(cclk48MHz);
+    BootTime_us = DWT->CYCCNT / 4;
+    DWT->CYCCNT = 0;
     Clk.UpdateFreqValues();
 
     // Init OS
@@ -73,6 +439,23 @@ int main(void) {
     Led.Init();
     Led.On();
 
+    ReplayDiskJournal();
+    // Fast path: nothing to update, so no FS mount and file search
+    if(!UpdateIsPending()) JumpToApp();
+
+    Update();
+#endif
+
+    // Forever
+    while(true);
+}
+
+/* Mounts disk, flashes firmware file found there and jumps to app. Called when
+ * update is pending, or once when app is broken: marker is lost if power is
+ * cut during update without VBAT, and the file is the only way back then. */
+static bool UpdateTried = false;
+void Update() {
+    UpdateTried = true;
     FRESULT err;
     err = f_mount(&FlashFS, "", 0);
     if(err != FR_OK) {
@@ -80,22 +463,21 @@ int main(void) {
         chThdSleepMilliseconds(99);
         JumpToApp();
     }
-#endif
 #if 1 // =========================== Preparations ==============================
     // Try open file, jump to main app if not found
-    if(f_findfirst(&Dir, &FileInfo, "", FILENAME_PATTERN) != FR_OK) {
-        Printf("File search fail\r");
-        chThdSleepMilliseconds(99);
-        OnError();
-    }
-    if(FileInfo.fname[0] == 0) {
-        Printf("%S not found\r", FILENAME_PATTERN);
-        chThdSleepMilliseconds(99);
-        OnError();
+    bool IsPacked = false, IsDelta = false;
+    if(!FindFile(FILENAME_PATTERN)) {
+        IsPacked = FindFile(PACKED_PATTERN);
+        if(!IsPacked) IsDelta = FindFile(DELTA_PATTERN);
+        if(!IsPacked and !IsDelta) {
+            Printf("%S not found\r", FILENAME_PATTERN);
+            ClearUpdatePending();
+            chThdSleepMilliseconds(99);
+            OnError();
+        }
     }
     Printf("Found: %S\r", FileInfo.fname);
     if(TryOpenFileRead(FileInfo.fname, &CommonFile) != retvOk) OnError();
-    int32_t TotalLen = f_size(&CommonFile);
 
     // Unlock flash
     chSysLock();
@@ -105,52 +487,40 @@ int main(void) {
 #endif
 #if 1 // ======= Reading and flashing =======
     Led.StartOrRestart(lsqWriting);
-    // ==== Read file block by block, do not write first page ====
-    uint32_t BytesCnt, CurrentAddr = APP_START_ADDR;
-    while(TotalLen != 0) {
-        // Check flash address
-        if(CurrentAddr >= (FLASH_START_ADDR + TOTAL_FLASH_SZ)) {
-            Printf("Error: too large file\r");
-            break;
-        }
-
-        // How many bytes to read?
-        BytesCnt = MIN_(TotalLen, PAGE_SZ);
-        TotalLen -= BytesCnt;
-        // Read block
-        if(f_read(&CommonFile, Buf, BytesCnt, &BytesCnt) != FR_OK) {
-            Printf("Read error\r");
-            OnError();
-        }
-
-        ErasePage(CurrentAddr);
-        WriteToMemory(CurrentAddr, Buf, BytesCnt);
-        CurrentAddr += BytesCnt;
-    } // while
+    if(IsDelta) FlashDelta();
+    else FlashImage(IsPacked);
 #endif
-    Printf("\rWriting done\r");
+    // Keep the file if programmed image is bad: next power-up will retry
+    if(!VerifyApp()) {
+        Printf("Verify fail\r");
+        Led.StartOrRestart(lsqError);
+        while(true);
+    }
     chThdSleepMilliseconds(99);
     f_close(&CommonFile);
     // Remove firmware file
     f_unlink(FileInfo.fname);
+    ClearUpdatePending();
     chThdSleepMilliseconds(99);
 //    Iwdg::Reload();
     chSysLock();
     Flash::LockFlash();
     chSysUnlock();
     JumpToApp();
-
-    // Forever
-    while(true);
 }
 
 void JumpToApp() {
     // Check if writing successfull
-    if(AppIsEmpty()) {  // Unsuccessful, loop forever
-        Led.StartOrRestart(lsqError);
+    if(AppIsEmpty() or (!AppVerified and !VerifyApp())) {
+        if(!UpdateTried) Update();      // Does not return
+        Led.StartOrRestart(lsqError);   // No file, or it did not help: loop forever
         while(true);
     }
     Led.Stop();
+    // App reports it together with its own startup time
+    BackupSpc::EnableAccess();
+    BackupSpc::WriteRegister(BKPREG_BOOT_US, BootTime_us + DWT->CYCCNT / (Clk.AHBFreqHz / 1000000));
+    BackupSpc::DisableAccess();
     chSysLock();
     __disable_irq();
     // Start app
@@ -164,20 +534,16 @@ void JumpToApp() {
 }
 
 extern "C" {
-void ErasePage(uint32_t Addr) {
-    uint32_t PageAddr = (Addr - FLASH_START_ADDR) / PAGE_SZ;
-    if(Flash::ErasePage(PageAddr) != retvOk) {
-        Printf("\rErase fail\r");
-        chThdSleepMilliseconds(450);
-        REBOOT();
-    }
-}
+// Erases and programs only if page contents differ
 void WriteToMemory(uint32_t Addr, uint32_t *PBuf, uint32_t Len) {
-    if(Flash::ProgramBuf32(Addr, PBuf, Len) != retvOk) {
+    if(Addr >= APP_END_ADDR and Len == PAGE_SZ and APP_START_ADDR + AppLen <= DISK_SCRATCH_ADDR) {
+        WriteDiskPage(Addr, PBuf, Len);
+        return;
+    }
+    if(Flash::UpdatePage(Addr, PBuf, Len) != retvOk) {
         Printf("Write Fail\r");
         chThdSleepMilliseconds(450);
         REBOOT();
     }
-    Printf(".");
 }
 } // extern C
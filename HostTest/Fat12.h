@@ -0,0 +1,46 @@
+/*
+ * Fat12.h
+ *
+ *  Created on: 19 10 2026
+ *      Author: agent
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <string.h>
+
+/* Volume as PC formats the disk, FAT12 with one sector per cluster:
+ * Boot | FAT | FAT | Root dir (one sector) | Data...
+ * FatFs here is built without f_mkfs. */
+#define FAT12_SECTOR_FAT1   1
+#define FAT12_SECTOR_FAT2   2
+#define FAT12_SECTOR_ROOT   3
+
+static inline void Fat12St16(uint8_t *P, uint16_t v) { P[0] = v; P[1] = v >> 8; }
+
+static inline void Fat12Boot(uint8_t *S, uint32_t SectorSz, uint32_t SectorCnt) {
+    memset(S, 0, SectorSz);
+    memcpy(S, "\xEB\x3C\x90" "MSDOS5.0", 11);
+    Fat12St16(S + 11, SectorSz);    // Bytes per sector
+    S[13] = 1;                      // Sectors per cluster
+    Fat12St16(S + 14, 1);           // Reserved sectors
+    S[16] = 2;                      // FAT count
+    Fat12St16(S + 17, SectorSz / 32); // Root dir entries
+    Fat12St16(S + 19, SectorCnt);   // Total sectors
+    S[21] = 0xF8;                   // Media
+    Fat12St16(S + 22, 1);           // Sectors per FAT
+    Fat12St16(S + 24, 63);
+    Fat12St16(S + 26, 255);
+    S[36] = 0x80;
+    S[38] = 0x29;
+    memcpy(S + 39, "\x19\x10\x26\x20" "LEDTREE    " "FAT12   ", 4 + 11 + 8);
+    S[510] = 0x55;
+    S[511] = 0xAA;
+}
+
+// First sector of each FAT; other sectors are zero
+static inline void Fat12Fat(uint8_t *S, uint32_t SectorSz) {
+    memset(S, 0, SectorSz);
+    memcpy(S, "\xF8\xFF\xFF", 3);
+}
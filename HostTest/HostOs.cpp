@@ -0,0 +1,296 @@
+/*
+ * HostOs.cpp
+ *
+ *  Created on: 19 10 2026
+ *      Author: agent
+ */
+
+#include "HostOs.h"
+#include "shell.h"
+#include "dlog.h"
+#include "shell_cmd.h"
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <functional>
+#include <vector>
+#include <strings.h>
+#include <sys/mman.h>
+
+namespace HostOs {
+
+bool Quiet = false;
+static uint64_t ITime = 0;
+// Never destroyed: threads still wait in them when main() returns
+static std::mutex &IMtx = *new std::mutex;
+static std::condition_variable &ICv = *new std::condition_variable;
+
+struct HostThd_t {
+    thread_t Thd;
+    std::unique_lock<std::mutex> *PLock = nullptr;
+    bool Waiting = false, Exited = false;
+    std::function<bool()> Ready;
+    uint64_t Deadline = 0;
+};
+static std::vector<HostThd_t*> IThds;
+static thread_local HostThd_t *PSelf = nullptr;
+
+void Init() {
+    PSelf = new HostThd_t;
+    PSelf->Thd.state = CH_STATE_CURRENT;
+    PSelf->PLock = new std::unique_lock<std::mutex>(IMtx);
+    IThds.push_back(PSelf);
+}
+
+uint64_t Now() { return ITime; }
+void Advance(uint32_t us) { ITime += us; }
+
+static bool IsBlocked(HostThd_t *P) {
+    return P->Exited or (P->Waiting and !P->Ready() and ITime < P->Deadline);
+}
+
+// Gives the lock away until Ready() or timeout. When nobody can run,
+// time jumps to the nearest deadline.
+static bool IWait(std::function<bool()> Ready, sysinterval_t Timeout) {
+    HostThd_t *P = PSelf;
+    P->Ready = Ready;
+    P->Deadline = (Timeout == TIME_INFINITE)? UINT64_MAX : (ITime + Timeout);
+    P->Waiting = true;
+    P->Thd.state = CH_STATE_SUSPENDED;
+    while(IsBlocked(P)) {
+        bool AllBlocked = true;
+        uint64_t Nearest = UINT64_MAX;
+        for(HostThd_t *T : IThds) {
+            if(!IsBlocked(T)) { AllBlocked = false; break; }
+            if(!T->Exited and T->Deadline < Nearest) Nearest = T->Deadline;
+        }
+        if(AllBlocked) {
+            if(Nearest == UINT64_MAX) {
+                printf("Deadlock: every thread waits forever\n");
+                fflush(stdout);
+                _exit(1);
+            }
+            ITime = Nearest;
+            continue;
+        }
+        ICv.notify_all();
+        ICv.wait(*P->PLock);
+    }
+    P->Waiting = false;
+    P->Thd.state = CH_STATE_CURRENT;
+    return P->Ready();
+}
+
+bool WaitFor(std::function<bool()> Ready, sysinterval_t Timeout) { return IWait(Ready, Timeout); }
+
+#if 1 // ============================ Printf ===================================
+static char ILastChar = 0;
+static void IPutChar(char c) {
+    if(c == '\n' and ILastChar == '\r') { ILastChar = c; return; }
+    ILastChar = c;
+    putchar(c == '\r'? '\n' : c);
+}
+static void IPutStr(const char *S) { while(*S) IPutChar(*S++); }
+
+void VPrintf(const char *Format, va_list Args) {
+    char Spec[16], Out[64];
+    while(*Format) {
+        if(*Format != '%') { IPutChar(*Format++); continue; }
+        // Copy flags, width and precision as is
+        uint32_t n = 0;
+        Spec[n++] = *Format++;
+        while(*Format and strchr("-+ #0123456789.", *Format) and n < sizeof(Spec) - 3) Spec[n++] = *Format++;
+        bool IsLong = false;
+        while(*Format == 'l' or *Format == 'h' or *Format == 'z') IsLong |= (*Format++ != 'h');
+        char Type = *Format++;
+        switch(Type) {
+            case 'S': case 's': {
+                Spec[n++] = 's'; Spec[n] = 0;
+                const char *S = va_arg(Args, const char*);
+                char Buf[512];
+                snprintf(Buf, sizeof(Buf), Spec, S? S : "(null)");
+                IPutStr(Buf);
+            } break;
+            case 'A': { // Byte array: pointer, length, separator
+                uint8_t *Ptr = va_arg(Args, uint8_t*);
+                int32_t Len = va_arg(Args, int32_t);
+                char Sep = (char)va_arg(Args, int);
+                for(int32_t i=0; i<Len; i++) {
+                    snprintf(Out, sizeof(Out), "%02X", Ptr[i]);
+                    IPutStr(Out);
+                    if(i != Len-1 and Sep != 0) IPutChar(Sep);
+                }
+            } break;
+            case 'c':
+                IPutChar((char)va_arg(Args, int));
+                break;
+            case 'u': case 'd': case 'i': case 'X': case 'x': case 'o':
+                if(IsLong) { Spec[n++] = 'l'; Spec[n++] = 'l'; }
+                Spec[n++] = Type; Spec[n] = 0;
+                if(IsLong) snprintf(Out, sizeof(Out), Spec, va_arg(Args, long long));
+                else snprintf(Out, sizeof(Out), Spec, va_arg(Args, int));
+                IPutStr(Out);
+                break;
+            case 'f':
+                Spec[n++] = 'f'; Spec[n] = 0;
+                snprintf(Out, sizeof(Out), Spec, va_arg(Args, double));
+                IPutStr(Out);
+                break;
+            case '%': IPutChar('%'); break;
+            case 0: return;
+            default: break;
+        }
+    }
+    fflush(stdout);
+}
+#endif
+
+} // namespace
+
+using namespace HostOs;
+
+#if 1 // ============================ Printf ===================================
+void Printf(const char *format, ...) {
+    if(HostOs::Quiet) return;
+    va_list args;
+    va_start(args, format);
+    HostOs::VPrintf(format, args);
+    va_end(args);
+}
+
+void PrintfI(const char *format, ...) {
+    if(HostOs::Quiet) return;
+    va_list args;
+    va_start(args, format);
+    HostOs::VPrintf(format, args);
+    va_end(args);
+}
+
+extern "C"
+void PrintfC(const char *format, ...) {
+    if(HostOs::Quiet) return;
+    va_list args;
+    va_start(args, format);
+    HostOs::VPrintf(format, args);
+    va_end(args);
+}
+
+void Shell_t::Print(const char *format, ...) {
+    va_list args;
+    va_start(args, format);
+    HostOs::VPrintf(format, args);
+    va_end(args);
+}
+
+// Deferred log is not printed on host
+void DeferredLog::PutI(const char *Fmt, uint32_t ArgCnt, const uint32_t *PArgs) {}
+#endif
+
+#if 1 // ========================== Core and clock ==============================
+extern "C" {
+CoreDebug_Type HostCoreDebug;
+DWT_Type HostDwt;
+SCB_Type HostScb;
+CRC_TypeDef HostCrc;
+}
+Clk_t Clk;
+// Backup domain survives reset, so it is shared with forked child too
+uint32_t *HostBkpReg = (uint32_t*)mmap(nullptr, 32 * sizeof(uint32_t), PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+#endif
+
+#if 1 // ========================== Shell commands =============================
+// Registered by static constructors: must exist before any of them runs
+static std::vector<const ShellCmd_t*>& ICmds() {
+    static std::vector<const ShellCmd_t*> *P = new std::vector<const ShellCmd_t*>;
+    return *P;
+}
+
+ShellCmdReg_t::ShellCmdReg_t(const ShellCmd_t *PCmd) { ICmds().push_back(PCmd); }
+
+uint8_t ShellCmds::Run(Shell_t *PShell, const char *Name) {
+    for(const ShellCmd_t *P : ICmds()) {
+        if(strcasecmp(P->Name, Name) != 0) continue;
+        ShellArgs_t Args;
+        Args.Cnt = 0;
+        P->Handler(PShell, Args);
+        return retvOk;
+    }
+    return retvCmdUnknown;
+}
+#endif
+
+#if 1 // ============================ Kernel ===================================
+extern "C" {
+void chSysLock() {}
+void chSysUnlock() {}
+void chSchRescheduleS() {}
+
+systime_t chVTGetSystemTimeX() { return (systime_t)ITime; }
+
+thread_t *chThdCreateStatic(void *wsp, size_t size, tprio_t prio, tfunc_t pf, void *arg) {
+    HostThd_t *P = new HostThd_t;
+    P->Thd.state = CH_STATE_READY;
+    P->Thd.func = pf;
+    P->Thd.arg = arg;
+    IThds.push_back(P);
+    // Starts when creator gives the lock away
+    std::thread([P]() {
+        std::unique_lock<std::mutex> Lock(IMtx);
+        PSelf = P;
+        P->PLock = &Lock;
+        P->Thd.state = CH_STATE_CURRENT;
+        P->Thd.func(P->Thd.arg);
+        P->Exited = true;
+        P->Thd.state = CH_STATE_FINAL;
+        ICv.notify_all();
+    }).detach();
+    return &P->Thd;
+}
+
+thread_t *chThdGetSelfX() { return &PSelf->Thd; }
+
+void chThdSleep(sysinterval_t time) { IWait([]() { return false; }, time); }
+
+// Equal priority threads are not used: nobody to yield to
+void chThdYield() {}
+void chSchReadyI(thread_t *tp) {}
+
+void chEvtSignalI(thread_t *tp, eventmask_t events) {
+    tp->epending |= events;
+    ICv.notify_all();
+}
+void chEvtSignal(thread_t *tp, eventmask_t events) { chEvtSignalI(tp, events); }
+
+eventmask_t chEvtWaitAnyTimeout(eventmask_t events, sysinterval_t timeout) {
+    thread_t *tp = &PSelf->Thd;
+    if(timeout != TIME_IMMEDIATE) IWait([tp, events]() { return (tp->epending & events) != 0; }, timeout);
+    eventmask_t m = tp->epending & events;
+    tp->epending &= ~m;
+    return m;
+}
+
+void chSemObjectInit(semaphore_t *sp, int32_t n) { sp->cnt = n; }
+
+msg_t chSemWaitTimeout(semaphore_t *sp, sysinterval_t timeout) {
+    if(sp->cnt <= 0) {
+        if(timeout == TIME_IMMEDIATE) return MSG_TIMEOUT;
+        if(!IWait([sp]() { return sp->cnt > 0; }, timeout)) return MSG_TIMEOUT;
+    }
+    sp->cnt--;
+    return MSG_OK;
+}
+
+void chSemSignal(semaphore_t *sp) {
+    sp->cnt++;
+    ICv.notify_all();
+}
+
+void chBSemObjectInit(binary_semaphore_t *bsp, bool taken) { bsp->sem.cnt = taken? 0 : 1; }
+msg_t chBSemWaitTimeout(binary_semaphore_t *bsp, sysinterval_t timeout) { return chSemWaitTimeout(&bsp->sem, timeout); }
+void chBSemSignal(binary_semaphore_t *bsp) {
+    bsp->sem.cnt = 1;
+    ICv.notify_all();
+}
+void chBSemReset(binary_semaphore_t *bsp, bool taken) { bsp->sem.cnt = taken? 0 : 1; }
+} // extern C
+#endif
@@ -0,0 +1,40 @@
+/*
+ * HostOs.h
+ *
+ *  Created on: 19 10 2026
+ *      Author: agent
+ */
+
+#pragma once
+
+#include "ch.h"
+#include <stdarg.h>
+#include <stdio.h>
+#include <unistd.h>
+#include <functional>
+
+/* Kernel stand-in for host builds. Works as single core: thread runs only
+ * while it holds the kernel lock, and gives it away in waits only. So run
+ * order is reproducible, and virtual time does not depend on host speed.
+ * When every thread waits, time jumps to the nearest timeout. */
+namespace HostOs {
+
+// Call once from main() before anything else
+void Init();
+// Virtual time in us, moved by flash and USB models
+uint64_t Now();
+void Advance(uint32_t us);
+// Gives the kernel lock away until Ready() or timeout, false on timeout.
+// For host-side models waiting for target threads.
+bool WaitFor(std::function<bool()> Ready, sysinterval_t Timeout);
+// Device output: off when sweeping thousands of power cuts
+extern bool Quiet;
+// Kreyl's Printf dialect: %S is string, %A is byte array (Ptr, Len, Separator)
+void VPrintf(const char *Format, va_list Args);
+
+} // namespace
+
+// Fails the test: prints where and exits with error
+#define HOST_CHECK(Cond, ...) do { if(!(Cond)) { \
+    printf("FAIL %s:%u: ", __FILE__, __LINE__); printf(__VA_ARGS__); printf("\n"); \
+    fflush(stdout); _exit(1); } } while(0)
@@ -0,0 +1,274 @@
+/*
+ * NorFlash.cpp
+ *
+ *  Created on: 19 10 2026
+ *      Author: agent
+ */
+
+#include "NorFlash.h"
+#include "HostOs.h"
+#include "kl_lib.h"
+#include <sys/mman.h>
+#include <signal.h>
+#include <ucontext.h>
+#include <random>
+#include <vector>
+
+#define HOST_PAGE_SZ    4096UL
+#define DWORD_ERASED    0xFFFFFFFFFFFFFFFFULL
+
+namespace NorFlash {
+
+// Flash state is in shared memory: it stays after forked child is done
+struct Shared_t {
+    uint8_t Torn[NOR_SZ / 8];   // Double words failing ECC check
+    Stat_t Stat;
+    uint32_t OpCnt;
+};
+static Shared_t &IShr = *(Shared_t*)mmap(nullptr, sizeof(Shared_t), PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+Stat_t &Stat = IShr.Stat;
+TearMode_t TearMode = tmRandom;
+
+struct Image_t {
+    std::vector<uint8_t> Mem, Torn;
+    Stat_t Stat;
+};
+
+static uint8_t *const IMem = (uint8_t*)NOR_BASE;
+static uint8_t IArmed[NOR_SZ / HOST_PAGE_SZ];   // Host page is protected: it has torn ones
+static int32_t ICutAt = -1;
+static uint32_t IFailFirst = 0, IFailCnt = 0;
+static bool IUnlocked = false;
+static std::mt19937 IRnd(1);
+
+#if 1 // ======================= Torn double words =============================
+bool DWordIsTorn(uint32_t Addr) { return IShr.Torn[(Addr - NOR_BASE) / 8]; }
+
+bool HasTornIn(uint32_t Addr, uint32_t Sz) {
+    if(Sz == 0) return false;
+    uint32_t First = (Addr - NOR_BASE) / 8, Last = (Addr + Sz - 1 - NOR_BASE) / 8;
+    for(uint32_t i=First; i<=Last and i<(NOR_SZ / 8); i++) if(IShr.Torn[i]) return true;
+    return false;
+}
+
+// Plain reads of host page holding torn double word are trapped
+static void IArm(uint32_t Offset) {
+    uint32_t Pg = Offset / HOST_PAGE_SZ;
+    bool Torn = HasTornIn(NOR_BASE + Pg * HOST_PAGE_SZ, HOST_PAGE_SZ);
+#if defined(__x86_64__)
+    if(Torn != (bool)IArmed[Pg]) mprotect(IMem + Pg * HOST_PAGE_SZ, HOST_PAGE_SZ, Torn? PROT_NONE : (PROT_READ | PROT_WRITE));
+#endif
+    IArmed[Pg] = Torn;
+}
+
+static void IDisarm(uint32_t Offset) {
+    uint32_t Pg = Offset / HOST_PAGE_SZ;
+    if(!IArmed[Pg]) return;
+    mprotect(IMem + Pg * HOST_PAGE_SZ, HOST_PAGE_SZ, PROT_READ | PROT_WRITE);
+    IArmed[Pg] = 0;
+}
+
+// Power is lost in the middle of changing the cells: some bits are done
+static void ITear(uint32_t Offset, uint64_t Target, bool IsErase) {
+    uint64_t Old, Rnd = ((uint64_t)IRnd() << 32) | IRnd();
+    memcpy(&Old, IMem + Offset, 8);
+    uint64_t V = IsErase? (Old | Rnd) : (Old & (Target | Rnd));
+    bool Ecc = (TearMode == tmEcc) or (TearMode == tmRandom and (IRnd() & 1));
+    memcpy(IMem + Offset, &V, 8);
+    IShr.Torn[Offset / 8] = (V != DWORD_ERASED) and Ecc;
+}
+
+static uint32_t IStepPage = 0;
+// Flash::StartEccCheck in effect: NMI handler notes ECC error and returns
+static volatile bool IEccProbe = false, IEccFault = false;
+
+static void OnSegv(int Sig, siginfo_t *Info, void *PCtx) {
+    uint32_t Addr = (uint32_t)(uintptr_t)Info->si_addr;
+    if((uintptr_t)Info->si_addr < NOR_BASE or (uintptr_t)Info->si_addr >= NOR_BASE + NOR_SZ) {
+        signal(SIGSEGV, SIG_DFL); // Real crash: let it happen
+        return;
+    }
+    if(HasTornIn(Addr, 1) and IEccProbe) IEccFault = true;
+    else if(HasTornIn(Addr, 1)) {
+        char S[99];
+        int n = snprintf(S, sizeof(S), "NMI: plain read of torn double word at %X\n", Addr);
+        if(write(1, S, n) < 0) {}
+        _exit(1);
+    }
+    // Let this instruction run and protect the page back after it
+    IStepPage = Addr & ~(HOST_PAGE_SZ - 1);
+    mprotect((void*)(uintptr_t)IStepPage, HOST_PAGE_SZ, PROT_READ | PROT_WRITE);
+#if defined(__x86_64__)
+    ((ucontext_t*)PCtx)->uc_mcontext.gregs[REG_EFL] |= 0x100; // Trap flag
+#endif
+}
+
+static void OnTrap(int Sig, siginfo_t *Info, void *PCtx) {
+    if(IStepPage != 0) mprotect((void*)(uintptr_t)IStepPage, HOST_PAGE_SZ, PROT_NONE);
+    IStepPage = 0;
+#if defined(__x86_64__)
+    ((ucontext_t*)PCtx)->uc_mcontext.gregs[REG_EFL] &= ~0x100;
+#endif
+}
+#endif
+
+#if 1 // ============================= Control =================================
+void Init() {
+    void *P = mmap(IMem, NOR_SZ, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS | MAP_FIXED_NOREPLACE, -1, 0);
+    HOST_CHECK(P == IMem, "Flash array cannot be mapped at %lX", NOR_BASE);
+    struct sigaction Sa;
+    memset(&Sa, 0, sizeof(Sa));
+    Sa.sa_flags = SA_SIGINFO;
+    Sa.sa_sigaction = OnSegv;
+    sigaction(SIGSEGV, &Sa, nullptr);
+    Sa.sa_sigaction = OnTrap;
+    sigaction(SIGTRAP, &Sa, nullptr);
+    EraseAll();
+}
+
+void EraseAll() {
+    for(uint32_t i=0; i<NOR_SZ; i += HOST_PAGE_SZ) IDisarm(i);
+    memset(IMem, 0xFF, NOR_SZ);
+    memset(IShr.Torn, 0, sizeof(IShr.Torn));
+    memset(&Stat, 0, sizeof(Stat));
+    IFailCnt = 0;
+    ICutAt = -1;
+}
+
+uint32_t OpCnt() { return IShr.OpCnt; }
+
+void Resync() {
+    for(uint32_t i=0; i<NOR_SZ; i += HOST_PAGE_SZ) IArm(i);
+}
+
+void ChargeRead(uint32_t Sz) {
+    Stat.BytesRead += Sz;
+    HostOs::Advance(Sz / NOR_READ_BYTES_PER_US);
+}
+void CutPowerAfter(int32_t Steps) { ICutAt = Steps; }
+void FailPages(uint32_t FirstPage, uint32_t Cnt) {
+    IFailFirst = FirstPage;
+    IFailCnt = Cnt;
+}
+
+Image_t* Save() {
+    Image_t *P = new Image_t;
+    for(uint32_t i=0; i<NOR_SZ; i += HOST_PAGE_SZ) IDisarm(i);
+    P->Mem.assign(IMem, IMem + NOR_SZ);
+    P->Torn.assign(IShr.Torn, IShr.Torn + sizeof(IShr.Torn));
+    P->Stat = Stat;
+    for(uint32_t i=0; i<NOR_SZ; i += HOST_PAGE_SZ) IArm(i);
+    return P;
+}
+
+void Restore(const Image_t *PImage) {
+    for(uint32_t i=0; i<NOR_SZ; i += HOST_PAGE_SZ) IDisarm(i);
+    memcpy(IMem, PImage->Mem.data(), NOR_SZ);
+    memcpy(IShr.Torn, PImage->Torn.data(), sizeof(IShr.Torn));
+    Stat = PImage->Stat;
+    for(uint32_t i=0; i<NOR_SZ; i += HOST_PAGE_SZ) IArm(i);
+}
+
+void Free(Image_t *PImage) { delete PImage; }
+#endif
+
+// Returns true if power is lost during this step
+static bool IStep() {
+    IShr.OpCnt++;
+    if(ICutAt < 0) return false;
+    return (ICutAt-- == 0);
+}
+
+static bool IPageFails(uint32_t Page) { return Page >= IFailFirst and Page < IFailFirst + IFailCnt; }
+
+} // namespace
+
+using namespace NorFlash;
+
+#if 1 // ========================== Flash interface ============================
+namespace Flash {
+
+void UnlockFlash() { IUnlocked = true; }
+void LockFlash() { IUnlocked = false; }
+void ClearPendingFlags() {}
+
+uint8_t ErasePage(uint32_t PageAddress) {
+    if(PageAddress >= NOR_PAGE_CNT or IPageFails(PageAddress)) return retvFail;
+    if(!IUnlocked) {
+        Stat.Violations++;
+        return retvWriteProtect;
+    }
+    uint32_t Offset = PageAddress * NOR_PAGE_SZ;
+    IDisarm(Offset);
+    if(IStep()) {
+        for(uint32_t i=0; i<NOR_PAGE_SZ; i+=8) ITear(Offset + i, DWORD_ERASED, true);
+        IArm(Offset);
+        throw PowerCut_t();
+    }
+    memset(IMem + Offset, 0xFF, NOR_PAGE_SZ);
+    memset(&IShr.Torn[Offset / 8], 0, NOR_PAGE_SZ / 8);
+    IArm(Offset);
+    Stat.Erases++;
+    Stat.PageErases[PageAddress]++;
+    HostOs::Advance(NOR_ERASE_US);
+    return retvOk;
+}
+
+uint8_t ProgramBuf32(uint32_t Address, uint32_t *PData, int32_t ASzBytes) {
+    while(ASzBytes >= 7) {
+        if(Address < NOR_BASE or Address + 8 > NOR_BASE + NOR_SZ or (Address & 7) != 0) return retvFail;
+        uint32_t Offset = Address - NOR_BASE;
+        if(IPageFails(Offset / NOR_PAGE_SZ)) return retvFail;
+        if(!IUnlocked) {
+            Stat.Violations++;
+            return retvWriteProtect;
+        }
+        uint64_t Cur, New;
+        memcpy(&New, PData, 8);
+        IDisarm(Offset);
+        memcpy(&Cur, IMem + Offset, 8);
+        if(IStep()) {
+            ITear(Offset, New, false);
+            IArm(Offset);
+            throw PowerCut_t();
+        }
+        // Only zeros may be written over programmed double word
+        if((Cur != DWORD_ERASED or IShr.Torn[Offset / 8]) and New != 0) {
+            IArm(Offset);
+            Stat.Violations++;
+            return retvFail;
+        }
+        Cur &= New;
+        memcpy(IMem + Offset, &Cur, 8);
+        IShr.Torn[Offset / 8] = 0;
+        IArm(Offset);
+        Stat.DWords++;
+        HostOs::Advance(NOR_PROGRAM_US);
+        Address += 8;
+        PData += 2;
+        ASzBytes -= 8;
+    }
+    return retvOk;
+}
+
+void StartEccCheck() {
+    IEccFault = false;
+    IEccProbe = true;
+}
+
+uint8_t EndEccCheck() {
+    IEccProbe = false;
+    return IEccFault? retvFail : retvOk;
+}
+
+uint8_t ReadChecked(void *PDst, uint32_t Addr, uint32_t Sz) {
+    uint32_t Offset = Addr - NOR_BASE;
+    for(uint32_t i = Offset & ~(HOST_PAGE_SZ - 1); i < Offset + Sz; i += HOST_PAGE_SZ) IDisarm(i);
+    memcpy(PDst, (const void*)(uintptr_t)Addr, Sz);
+    for(uint32_t i = Offset & ~(HOST_PAGE_SZ - 1); i < Offset + Sz; i += HOST_PAGE_SZ) IArm(i);
+    ChargeRead(Sz);
+    return HasTornIn(Addr, Sz)? retvFail : retvOk;
+}
+
+} // namespace
+#endif
@@ -0,0 +1,73 @@
+/*
+ * NorFlash.h
+ *
+ *  Created on: 19 10 2026
+ *      Author: agent
+ */
+
+#pragma once
+
+#include <stdint.h>
+
+/* Model of STM32L476 inner flash behind Flash:: functions of kl_lib.h.
+ * Array is mapped at its real address, so code under test reads it through
+ * plain pointers, as on target.
+ * - Double word may be programmed once after erase, as PROGERR rule says;
+ *   otherwise programming fails and Stat.Violations grows.
+ * - Erase and program take datasheet typical time of virtual clock. Plain
+ *   reads cannot be seen, so readers charge them with ChargeRead.
+ * - Power cut: after given number of erase and double word program steps
+ *   the step in progress is torn and PowerCut_t is thrown. Torn double word
+ *   holds partially changed bits; half of them fail ECC check. Those are
+ *   reported by Flash::ReadChecked and inside Flash::StartEccCheck and
+ *   EndEccCheck; plain read of one elsewhere is NMI on target, and here it
+ *   stops the test (x86-64 hosts).
+ * - State is shared with forked child processes, so code under test may run
+ *   in one and exit as on reset: see Resync(). */
+
+#define NOR_BASE            0x08000000UL
+#define NOR_SZ              (256UL * 1024UL)
+#define NOR_PAGE_SZ         2048UL
+#define NOR_PAGE_CNT        (NOR_SZ / NOR_PAGE_SZ)
+#define NOR_ERASE_US        22020   // Page erase, typ
+#define NOR_PROGRAM_US      82      // Double word, typ
+// Estimate: word per 5 cycles at 80 MHz with 4 wait states and prefetch
+#define NOR_READ_BYTES_PER_US   64
+
+namespace NorFlash {
+
+struct PowerCut_t {};
+
+struct Stat_t {
+    uint32_t Erases, DWords, Violations, BytesRead;
+    uint32_t PageErases[NOR_PAGE_CNT];
+};
+extern Stat_t &Stat;
+
+// Kind of torn double word, tmRandom picks one by seeded generator
+enum TearMode_t {tmRandom, tmEcc, tmPartial};
+extern TearMode_t TearMode;
+
+void Init();
+// Whole array is erased, statistics are reset
+void EraseAll();
+// Number of erase and program steps since Init, to plan power cuts
+uint32_t OpCnt();
+// Brings page protection of this process in line with changes made by child
+void Resync();
+// Cut power at the step with this number from now; -1 cancels the cut
+void CutPowerAfter(int32_t Steps);
+// Erase and program of these pages fail, as of worn-out flash
+void FailPages(uint32_t FirstPage, uint32_t Cnt);
+// Moves virtual clock as reading of Sz bytes would
+void ChargeRead(uint32_t Sz);
+bool DWordIsTorn(uint32_t Addr);
+bool HasTornIn(uint32_t Addr, uint32_t Sz);
+
+// Whole state, to restart power cut sweep from the same point
+struct Image_t;
+Image_t* Save();
+void Restore(const Image_t *PImage);
+void Free(Image_t *PImage);
+
+} // namespace
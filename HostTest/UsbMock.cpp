@@ -0,0 +1,358 @@
+/*
+ * UsbMock.cpp
+ *
+ *  Created on: 19 10 2026
+ *      Author: agent
+ */
+
+#include "UsbMock.h"
+#include "HostOs.h"
+#include "hal.h"
+#include "usb_msd.h"
+#include "usb_cdc.h"
+#include "MsgQ.h"
+#include "descriptors_msd.h"
+#include "kl_lib.h"
+#include "shell.h"
+#include <vector>
+
+#define MS_CBW_SIGNATURE    0x43425355UL
+
+// Target objects of modules not built here
+USBDriver USBD1;
+UsbCdc_t UsbCdc;
+EvtMsgQ_t<EvtMsg_t, MAIN_EVT_Q_LEN> EvtQMain;
+RCC_TypeDef HostRcc;
+PWR_TypeDef HostPwr;
+
+// Host does not ask descriptors: enumeration is modelled by its events only
+const USBDescriptor *GetDescriptor(USBDriver *usbp, uint8_t dtype, uint8_t dindex, uint16_t lang) { return nullptr; }
+
+namespace UsbMock {
+
+static bool IConnected = false;
+// Transfers device has started and host has not finished yet
+static struct {
+    uint8_t *Buf;
+    uint32_t Sz, Cnt;
+    bool Pending;
+} IRx;
+static struct {
+    const uint8_t *Buf;
+    uint32_t Sz, Cnt;
+    bool Pending;
+} ITx;
+
+#if 1 // ============================= Bus =====================================
+void Attach() {
+    USBDriver *usbp = &USBD1;
+    HOST_CHECK(IConnected and usbp->config != nullptr, "device is not connected");
+    // Bus reset aborts transfers and drops endpoints
+    IRx.Pending = false;
+    ITx.Pending = false;
+    usbp->transmitting = 0;
+    memset(usbp->epc, 0, sizeof(usbp->epc));
+    usbp->state = USB_READY;
+    usbp->config->event_cb(usbp, USB_EVENT_RESET);
+    usbp->state = USB_SELECTED;
+    usbp->config->event_cb(usbp, USB_EVENT_ADDRESS);
+    usbp->state = USB_ACTIVE;
+    usbp->config->event_cb(usbp, USB_EVENT_CONFIGURED);
+    // GET_MAX_LUN: class request to interface 0
+    const uint8_t Setup[8] = {0xA1, 0xFE, 0, 0, 0, 0, 1, 0};
+    memcpy(usbp->setup, Setup, 8);
+    usbp->ep0n = 0;
+    HOST_CHECK(usbp->config->requests_hook_cb(usbp), "GET_MAX_LUN not handled");
+    HOST_CHECK(usbp->ep0n == 1 and usbp->ep0next[0] == 0, "GET_MAX_LUN: %u bytes", (uint32_t)usbp->ep0n);
+    // Device thread starts waiting for CBW
+    HOST_CHECK(HostOs::WaitFor([]() { return IRx.Pending; }, TIME_MS2I(100)), "device does not wait for CBW");
+}
+
+void Suspend() {
+    USBD1.state = USB_SUSPENDED;
+    USBD1.config->event_cb(&USBD1, USB_EVENT_SUSPEND);
+}
+
+void Resume() {
+    USBD1.state = USB_ACTIVE;
+    USBD1.config->event_cb(&USBD1, USB_EVENT_WAKEUP);
+}
+
+// Host side of bulk OUT: packets go to device buffer while it receives.
+// Stops when device starts transmitting status instead.
+static uint32_t IBulkOut(const uint8_t *Ptr, uint32_t Len) {
+    uint32_t Sent = 0;
+    while(Sent < Len) {
+        HostOs::WaitFor([]() { return IRx.Pending or ITx.Pending; }, TIME_MS2I(USB_HOST_TIMEOUT_MS));
+        if(!IRx.Pending) break;
+        uint32_t N = MIN_((uint32_t)USB_PKT_SZ, Len - Sent);
+        HOST_CHECK(N <= IRx.Sz - IRx.Cnt, "OUT packet of %u does not fit receive of %u", N, IRx.Sz - IRx.Cnt);
+        memcpy(IRx.Buf + IRx.Cnt, Ptr + Sent, N);
+        HostOs::Advance(USB_PKT_US);
+        IRx.Cnt += N;
+        Sent += N;
+        if(IRx.Cnt == IRx.Sz or N < USB_PKT_SZ) {
+            IRx.Pending = false;
+            USBD1.epc[EP_MSD_OUT_ID]->out_state->rxcnt = IRx.Cnt;
+            USBD1.epc[EP_MSD_OUT_ID]->out_cb(&USBD1, EP_MSD_OUT_ID);
+        }
+    }
+    return Sent;
+}
+
+// Host side of bulk IN: takes packets of device transmits until short one
+// or Len is got
+static uint32_t IBulkIn(uint8_t *Ptr, uint32_t Len) {
+    uint32_t Got = 0;
+    while(Got < Len) {
+        if(!HostOs::WaitFor([]() { return ITx.Pending; }, TIME_MS2I(USB_HOST_TIMEOUT_MS))) break;
+        uint32_t N = MIN_((uint32_t)USB_PKT_SZ, ITx.Sz - ITx.Cnt);
+        HOST_CHECK(N <= Len - Got, "Babble: IN packet of %u, %u expected", N, Len - Got);
+        memcpy(Ptr + Got, ITx.Buf + ITx.Cnt, N);
+        HostOs::Advance(USB_PKT_US);
+        ITx.Cnt += N;
+        Got += N;
+        if(ITx.Cnt == ITx.Sz) {
+            ITx.Pending = false;
+            USBD1.transmitting &= ~(1U << EP_MSD_IN_ID);
+            USBD1.epc[EP_MSD_IN_ID]->in_state->txcnt = ITx.Cnt;
+            USBD1.epc[EP_MSD_IN_ID]->in_cb(&USBD1, EP_MSD_IN_ID);
+        }
+        if(N < USB_PKT_SZ) break; // Short packet ends transfer
+    }
+    return Got;
+}
+#endif
+
+#if 1 // ===================== Bulk-Only Transport =============================
+struct CmdStat_t {
+    uint8_t Opcode;
+    uint32_t Cnt, Fails, Bytes;
+    uint64_t Time_us;
+};
+static std::vector<CmdStat_t> IStat;
+static uint32_t ITag = 0;
+static FILE *PRec = nullptr;
+static FILE *PCap = nullptr;
+
+#define CAP_DEV_ADDR    2
+#define CAP_EP_OUT      EP_MSD_OUT_ID
+#define CAP_EP_IN       (0x80 | EP_MSD_IN_ID)
+// Header of mmapped usbmon, link type 220
+struct UsbmonHdr_t {
+    uint64_t Id;
+    char Type;              // 'S' submission, 'C' completion
+    uint8_t XferType;       // 3 is bulk
+    uint8_t Ep;             // Direction in bit 7
+    uint8_t Dev;
+    uint16_t Bus;
+    char FlagSetup;
+    char FlagData;          // 0 if data follows
+    int64_t Sec;
+    int32_t Usec;
+    int32_t Status;
+    uint32_t Length, LenCap;
+    uint8_t Setup[8];
+    int32_t Interval, StartFrame;
+    uint32_t XferFlags, Ndesc;
+} __attribute__((packed));
+
+// One URB event: OUT data goes with submission, IN data with completion
+static void ICapture(char Type, uint8_t Ep, uint32_t Length, const void *Data, uint32_t LenCap) {
+    if(!PCap) return;
+    UsbmonHdr_t H;
+    memset(&H, 0, sizeof(H));
+    H.Id = ITag;
+    H.Type = Type;
+    H.XferType = 3;
+    H.Ep = Ep;
+    H.Dev = CAP_DEV_ADDR;
+    H.Bus = 1;
+    H.FlagSetup = '-';
+    H.FlagData = LenCap? 0 : (Ep & 0x80)? '<' : '>';
+    uint64_t Now = HostOs::Now();
+    H.Sec = Now / 1000000;
+    H.Usec = Now % 1000000;
+    H.Length = Length;
+    H.LenCap = LenCap;
+    uint32_t RecSz = sizeof(H) + LenCap;
+    uint32_t Rec[4] = {(uint32_t)H.Sec, (uint32_t)H.Usec, RecSz, RecSz};
+    fwrite(Rec, 1, sizeof(Rec), PCap);
+    fwrite(&H, 1, sizeof(H), PCap);
+    if(LenCap) fwrite(Data, 1, LenCap, PCap);
+}
+
+static void IAddStat(uint8_t Opcode, bool Failed, uint32_t Bytes, uint64_t Time_us) {
+    for(CmdStat_t &C : IStat) {
+        if(C.Opcode != Opcode) continue;
+        C.Cnt++;
+        if(Failed) C.Fails++;
+        C.Bytes += Bytes;
+        C.Time_us += Time_us;
+        return;
+    }
+    IStat.push_back({Opcode, 1, (uint32_t)Failed, Bytes, Time_us});
+}
+
+BotRslt_t Command(const uint8_t *Cdb, uint8_t CdbLen, uint8_t Dir, void *Data, uint32_t DataLen) {
+    BotRslt_t R = {0, 0, 0, 0, false};
+    uint64_t Start = HostOs::Now();
+    MS_CommandBlockWrapper_t Cbw;
+    memset(&Cbw, 0, sizeof(Cbw));
+    Cbw.Signature = MS_CBW_SIGNATURE;
+    Cbw.Tag = ++ITag;
+    Cbw.DataTransferLen = DataLen;
+    Cbw.Flags = Dir;
+    Cbw.SCSICmdLen = CdbLen;
+    memcpy(Cbw.SCSICmdData, Cdb, CdbLen);
+    if(PRec) {
+        fwrite(&Cbw, 1, MS_CMD_SZ, PRec);
+        if(Dir == BOT_DIR_OUT and DataLen) fwrite(Data, 1, DataLen, PRec);
+    }
+    ICapture('S', CAP_EP_OUT, MS_CMD_SZ, &Cbw, MS_CMD_SZ);
+    HOST_CHECK(IBulkOut((uint8_t*)&Cbw, MS_CMD_SZ) == MS_CMD_SZ, "CBW of %02X not taken", Cdb[0]);
+    ICapture('C', CAP_EP_OUT, MS_CMD_SZ, nullptr, 0);
+
+    // Data phase
+    MS_CommandStatusWrapper_t Csw;
+    uint32_t CswSz = 0;
+    if(DataLen != 0 and Dir == BOT_DIR_IN) {
+        ICapture('S', CAP_EP_IN, DataLen, nullptr, 0);
+        R.Moved = IBulkIn((uint8_t*)Data, DataLen);
+        ICapture('C', CAP_EP_IN, R.Moved, Data, R.Moved);
+        if(R.Moved == sizeof(Csw) and DataLen != sizeof(Csw) and ((MS_CommandStatusWrapper_t*)Data)->Signature == MS_CSW_SIGNATURE) {
+            memcpy(&Csw, Data, sizeof(Csw));
+            CswSz = sizeof(Csw);
+            R.Moved = 0;
+            R.PhaseSkipped = true;
+        }
+    }
+    else if(DataLen != 0) {
+        ICapture('S', CAP_EP_OUT, DataLen, Data, DataLen);
+        R.Moved = IBulkOut((const uint8_t*)Data, DataLen);
+        ICapture('C', CAP_EP_OUT, R.Moved, nullptr, 0);
+        R.Undrained = DataLen - R.Moved;
+    }
+
+    // Status phase
+    if(CswSz == 0) {
+        ICapture('S', CAP_EP_IN, sizeof(Csw), nullptr, 0);
+        CswSz = IBulkIn((uint8_t*)&Csw, sizeof(Csw));
+        ICapture('C', CAP_EP_IN, CswSz, &Csw, CswSz);
+    }
+    HOST_CHECK(CswSz == sizeof(Csw), "CSW of %02X: %u bytes", Cdb[0], CswSz);
+    HOST_CHECK(Csw.Signature == MS_CSW_SIGNATURE, "CSW of %02X: signature %X", Cdb[0], Csw.Signature);
+    HOST_CHECK(Csw.Tag == Cbw.Tag, "CSW of %02X: tag %u, %u expected", Cdb[0], Csw.Tag, Cbw.Tag);
+    R.Status = Csw.Status;
+    R.Residue = Csw.DataTransferResidue;
+    // IN residue is exactly what was not sent; OUT data taken may be not processed
+    if(Dir == BOT_DIR_IN) HOST_CHECK(R.Residue == DataLen - R.Moved,
+            "CSW of %02X: residue %u, %u bytes of %u sent", Cdb[0], R.Residue, R.Moved, DataLen);
+    else HOST_CHECK(R.Residue >= DataLen - R.Moved and R.Residue <= DataLen,
+            "CSW of %02X: residue %u, %u bytes of %u taken", Cdb[0], R.Residue, R.Moved, DataLen);
+    if(PRec) fwrite(&Csw, 1, sizeof(Csw), PRec);
+    IAddStat(Cdb[0], R.Status != SCSI_STATUS_OK, R.Moved, HostOs::Now() - Start);
+    return R;
+}
+
+void SendCbw(const uint8_t *Cdb, uint8_t CdbLen, uint8_t Dir, uint32_t DataLen) {
+    MS_CommandBlockWrapper_t Cbw;
+    memset(&Cbw, 0, sizeof(Cbw));
+    Cbw.Signature = MS_CBW_SIGNATURE;
+    Cbw.Tag = ++ITag;
+    Cbw.DataTransferLen = DataLen;
+    Cbw.Flags = Dir;
+    Cbw.SCSICmdLen = CdbLen;
+    memcpy(Cbw.SCSICmdData, Cdb, CdbLen);
+    HOST_CHECK(IBulkOut((uint8_t*)&Cbw, MS_CMD_SZ) == MS_CMD_SZ, "CBW of %02X not taken", Cdb[0]);
+}
+
+bool InIsPending() { return ITx.Pending; }
+
+void Record(FILE *PFile) { PRec = PFile; }
+
+void Capture(FILE *PFile) {
+    PCap = PFile;
+    if(PCap and ftell(PCap) == 0) {
+        // pcap header: version 2.4, snap length, link type 220
+        uint32_t Hdr[6] = {0xA1B2C3D4, 0x00040002, 0, 0, 0x40000, 220};
+        fwrite(Hdr, 1, sizeof(Hdr), PCap);
+    }
+}
+
+uint32_t Replay(FILE *PFile) {
+    MS_CommandBlockWrapper_t Cbw;
+    MS_CommandStatusWrapper_t Csw;
+    std::vector<uint8_t> Data;
+    uint32_t Cnt = 0;
+    while(fread(&Cbw, 1, MS_CMD_SZ, PFile) == MS_CMD_SZ) {
+        HOST_CHECK(Cbw.Signature == MS_CBW_SIGNATURE, "Stream: bad CBW %u", Cnt);
+        Data.assign(Cbw.DataTransferLen, 0);
+        if(Cbw.Flags == BOT_DIR_OUT and Cbw.DataTransferLen)
+            HOST_CHECK(fread(Data.data(), 1, Cbw.DataTransferLen, PFile) == Cbw.DataTransferLen, "Stream: no data %u", Cnt);
+        HOST_CHECK(fread(&Csw, 1, sizeof(Csw), PFile) == sizeof(Csw), "Stream: no CSW %u", Cnt);
+        BotRslt_t R = Command(Cbw.SCSICmdData, Cbw.SCSICmdLen, Cbw.Flags, Data.data(), Cbw.DataTransferLen);
+        HOST_CHECK(R.Status == Csw.Status and R.Residue == Csw.DataTransferResidue,
+                "Replay of %u, %02X: status %u residue %u, recorded %u %u", Cnt, Cbw.SCSICmdData[0],
+                R.Status, R.Residue, Csw.Status, Csw.DataTransferResidue);
+        Cnt++;
+    }
+    return Cnt;
+}
+
+void StatReset() { IStat.clear(); }
+
+void StatPrint() {
+    for(CmdStat_t &C : IStat) {
+        uint32_t Us = (uint32_t)C.Time_us;
+        Printf("Cmd %02X: %5u, fails %u, %7u us, %5u cmd/s, %4u KB/s\r", C.Opcode, C.Cnt, C.Fails, Us,
+                Us? (uint32_t)((uint64_t)C.Cnt * 1000000ULL / Us) : 0,
+                Us? (uint32_t)((uint64_t)C.Bytes * 1000000ULL / 1024 / Us) : 0);
+    }
+}
+#endif
+
+} // namespace
+
+using namespace UsbMock;
+
+#if 1 // ======================== Driver interface =============================
+extern "C" {
+void usbInit() {}
+
+void usbStart(USBDriver *usbp, const USBConfig *config) {
+    usbp->config = config;
+    usbp->state = USB_READY;
+}
+
+void usbStop(USBDriver *usbp) {
+    usbp->state = USB_STOP;
+    usbp->transmitting = 0;
+    memset(usbp->epc, 0, sizeof(usbp->epc));
+    IRx.Pending = false;
+    ITx.Pending = false;
+}
+
+void usbConnectBus(USBDriver *usbp) { IConnected = true; }
+void usbDisconnectBus(USBDriver *usbp) { IConnected = false; }
+
+void usbInitEndpointI(USBDriver *usbp, usbep_t ep, const USBEndpointConfig *epcp) { usbp->epc[ep] = epcp; }
+
+void usbStartReceiveI(USBDriver *usbp, usbep_t ep, uint8_t *buf, size_t n) {
+    HOST_CHECK(usbp->epc[ep] != nullptr and !IRx.Pending, "Receive on EP%u: not ready or busy", ep);
+    IRx.Buf = buf;
+    IRx.Sz = n;
+    IRx.Cnt = 0;
+    IRx.Pending = true;
+}
+
+void usbStartTransmitI(USBDriver *usbp, usbep_t ep, const uint8_t *buf, size_t n) {
+    HOST_CHECK(usbp->epc[ep] != nullptr and !ITx.Pending, "Transmit on EP%u: not ready or busy", ep);
+    ITx.Buf = buf;
+    ITx.Sz = n;
+    ITx.Cnt = 0;
+    ITx.Pending = true;
+    usbp->transmitting |= 1U << ep;
+}
+} // extern C
+#endif
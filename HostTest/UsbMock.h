@@ -0,0 +1,74 @@
+/*
+ * UsbMock.h
+ *
+ *  Created on: 19 10 2026
+ *      Author: agent
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <stdio.h>
+
+/* USB host model for usb_msd.cpp. Device side is the USBDriver API of
+ * stub/hal_usb.h; host side moves bulk data packet by packet between
+ * host buffers and the buffers device gave to usbStartReceiveI and
+ * usbStartTransmitI, and calls endpoint callbacks when transfer is done.
+ * Every packet takes USB_PKT_US of virtual time.
+ * Over it, Bulk-Only Transport as PC does it: CBW, data phase, CSW.
+ * - Device may send CSW instead of IN data (phase is skipped), as Linux
+ *   allows: 13-byte short packet with CSW signature is taken as status.
+ * - OUT data device did not take before sending CSW is counted as
+ *   undrained: real host would hang on it, so tests expect none. */
+
+#define USB_PKT_SZ          64
+// About 1 MB/s, as full-speed bulk gets with one endpoint busy
+#define USB_PKT_US          64
+// Host gives up on the command after this, as Linux usb-storage does
+#define USB_HOST_TIMEOUT_MS 30000
+
+#define BOT_DIR_OUT         0x00
+#define BOT_DIR_IN          0x80
+
+namespace UsbMock {
+
+// Bus reset, SET_ADDRESS, SET_CONFIGURATION and GET_MAX_LUN; device must
+// be connected with UsbMsd.Connect() before
+void Attach();
+void Suspend();
+void Resume();
+
+struct BotRslt_t {
+    uint8_t Status;         // From CSW
+    uint32_t Residue;       // From CSW
+    uint32_t Moved;         // Data phase bytes moved
+    uint32_t Undrained;     // OUT data device did not take
+    bool PhaseSkipped;      // CSW came instead of IN data
+};
+
+/* Runs one command. Transport errors (no CSW, wrong signature or tag,
+ * residue not matching data sent) fail the test: device is broken then. */
+BotRslt_t Command(const uint8_t *Cdb, uint8_t CdbLen, uint8_t Dir, void *Data, uint32_t DataLen);
+
+/* Host sends CBW and takes nothing more, as hung one: device must give up
+ * on the data phase and must not start a transfer over the one left there */
+void SendCbw(const uint8_t *Cdb, uint8_t CdbLen, uint8_t Dir, uint32_t DataLen);
+// Device transfer is on IN endpoint, not taken by host
+bool InIsPending();
+
+/* Commands and OUT data are written to file while it is set: CBW, OUT data
+ * if any, CSW. Replay sends them again and checks status and residue. */
+void Record(FILE *PFile);
+// Returns number of commands replayed; fails the test on status mismatch
+uint32_t Replay(FILE *PFile);
+
+/* Bulk transfers are written to file while it is set, as usbmon pcap
+ * (link type 220) of Linux host: same input for Tools/usbcap2stream.py
+ * as real capture is. */
+void Capture(FILE *PFile);
+
+// Host side statistics per opcode, over Command() calls
+void StatReset();
+void StatPrint();
+
+} // namespace
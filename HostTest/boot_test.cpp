@@ -0,0 +1,326 @@
+/*
+ * boot_test.cpp
+ *
+ *  Created on: 19 10 2026
+ *      Author: agent
+ */
+
+/* Bootloader update from disk over NOR flash model, with power loss.
+ * BootL476/main.cpp runs as is in forked child: exit of the child is reset,
+ * so statics start from scratch at every boot, while flash and backup
+ * registers are shared and stay. Power is cut at every erase and program
+ * step of an update, then the device boots until it jumps to app:
+ * - app is the new image, checked by its manifest;
+ * - update file is removed and pending marker is cleared;
+ * - nothing is programmed over non-erased flash.
+ * Delta sweep also cuts the resumed update once more at random step.
+ * Without VBAT the marker is lost at the cut: broken app makes bootloader
+ * look for the file itself, so plain image update must still get through. */
+
+#include "HostOs.h"
+#include "NorFlash.h"
+#include "Fat12.h"
+#include "kl_lib.h"
+#include "ff.h"
+#include "FwCrc.h"
+#include "FwDelta.h"
+#include <sys/wait.h>
+#include <vector>
+
+int BootMain();
+
+#define APP_START_ADDR      0x08008000UL
+#define APP_MAX_SZ          (0x08020000UL - APP_START_ADDR)
+#define DISK_ADDR           0x08020000UL
+#define DISK_SECTOR_SZ      2048UL
+#define DISK_SECTOR_CNT     64UL
+
+typedef std::vector<uint8_t> Bin_t;
+
+// Boot outcome: exit code of the child. NMI exits with 1, see NorFlash.cpp
+enum BootRslt_t {brNmi = 1, brJump = 10, brReboot, brHalt, brPowerCut, brReturned};
+static const char* RsltName(int R) {
+    switch(R) {
+        case brNmi:      return "NMI";
+        case brJump:     return "jump to app";
+        case brReboot:   return "reboot";
+        case brHalt:     return "error halt";
+        case brPowerCut: return "power cut";
+        case brReturned: return "return from main";
+        default:         return "crash";
+    }
+}
+
+static uint32_t Seed = 1;
+static uint32_t Rand(uint32_t Top) {
+    Seed = Seed * 1103515245UL + 12345UL;
+    return (Seed >> 16) % Top;
+}
+
+#if 1 // ============================== Images =================================
+// Random code with vector table and manifest, as Tools/fwimage.py manifest makes it
+static Bin_t MakeApp(uint32_t Len, uint32_t Version) {
+    Bin_t B(Len);
+    for(uint32_t i=0; i<Len; i++) B[i] = Rand(256);
+    uint32_t W[2] = {0x20018000UL, APP_START_ADDR + 0x1C1};   // Stack and Reset_Handler
+    memcpy(&B[0], W, 8);
+    memcpy(&B[FW_MANIFEST_PTR_OFFSET], &Len, 4);
+    FwManifest_t Man = {FW_MANIFEST_MAGIC, Len, Version, 0};
+    B.insert(B.end(), (uint8_t*)&Man, (uint8_t*)&Man + sizeof(Man));
+    Man.Crc = FwCrc32(B.data(), Len + offsetof(FwManifest_t, Crc));
+    memcpy(&B[Len], &Man, sizeof(Man));
+    return B;
+}
+
+// Next version: some functions changed, some code added at the end
+static Bin_t MakeNext(const Bin_t &Base, uint32_t Grow, uint32_t Version) {
+    uint32_t Len = Base.size() - sizeof(FwManifest_t);
+    Bin_t B(Base.begin(), Base.begin() + Len);
+    for(uint32_t i=0; i<7; i++) {
+        uint32_t Start = 64 + Rand(Len - 2048), N = 4 + Rand(600);
+        for(uint32_t j=Start; j<Start+N; j++) B[j] = Rand(256);
+    }
+    for(uint32_t i=0; i<Grow; i++) B.push_back(Rand(256));
+    Len += Grow;
+    memcpy(&B[FW_MANIFEST_PTR_OFFSET], &Len, 4);
+    FwManifest_t Man = {FW_MANIFEST_MAGIC, Len, Version, 0};
+    B.insert(B.end(), (uint8_t*)&Man, (uint8_t*)&Man + sizeof(Man));
+    Man.Crc = FwCrc32(B.data(), Len + offsetof(FwManifest_t, Crc));
+    memcpy(&B[Len], &Man, sizeof(Man));
+    return B;
+}
+
+// Same runs as Tools/fwimage.py diff_runs: gaps up to run header are merged
+static Bin_t MakeDelta(const Bin_t &Base, const Bin_t &New) {
+    FwDelta::Header_t Hdr = {FW_DELTA_MAGIC, (uint32_t)Base.size(), FwCrc32(Base.data(), Base.size()),
+            (uint32_t)New.size(), FwCrc32(New.data(), New.size())};
+    Bin_t D((uint8_t*)&Hdr, (uint8_t*)&Hdr + sizeof(Hdr));
+    std::vector<std::pair<uint32_t, uint32_t>> Runs;
+    uint32_t i = 0;
+    while(i < New.size()) {
+        if(i < Base.size() and New[i] == Base[i]) { i++; continue; }
+        uint32_t Start = i;
+        while(i < New.size() and (i >= Base.size() or New[i] != Base[i])) i++;
+        if(!Runs.empty() and Start - (Runs.back().first + Runs.back().second) <= sizeof(FwDelta::Run_t)) {
+            Start = Runs.back().first;
+            Runs.pop_back();
+        }
+        Runs.push_back({Start, i - Start});
+    }
+    for(auto &R : Runs) {
+        while(R.second != 0) {
+            FwDelta::Run_t Run = {R.first, (uint16_t)MIN_(R.second, 0xFFFFUL)};
+            D.insert(D.end(), (uint8_t*)&Run, (uint8_t*)&Run + sizeof(Run));
+            D.insert(D.end(), New.begin() + Run.Offset, New.begin() + Run.Offset + Run.Len);
+            R.first += Run.Len;
+            R.second -= Run.Len;
+        }
+    }
+    return D;
+}
+#endif
+
+#if 1 // =========================== Flash and disk ============================
+static void Program(uint32_t Addr, const uint8_t *P, uint32_t Len) {
+    static uint32_t Page[NOR_PAGE_SZ / 4];
+    Flash::UnlockFlash();
+    for(uint32_t i=0; i<Len; i+=NOR_PAGE_SZ) {
+        uint32_t N = MIN_(Len - i, NOR_PAGE_SZ);
+        memset(Page, 0xFF, sizeof(Page));
+        memcpy(Page, P + i, N);
+        HOST_CHECK(Flash::UpdatePage(Addr + i, Page, (N + 7) & ~7UL) == retvOk, "program %X", Addr + i);
+    }
+    Flash::LockFlash();
+}
+
+// Disk as PC formats it, with update file written as over USB
+static void PrepareDisk(const char *FName, const Bin_t &File) {
+    uint8_t S[DISK_SECTOR_SZ];
+    Fat12Boot(S, DISK_SECTOR_SZ, DISK_SECTOR_CNT);
+    Program(DISK_ADDR, S, DISK_SECTOR_SZ);
+    Fat12Fat(S, DISK_SECTOR_SZ);
+    Program(DISK_ADDR + FAT12_SECTOR_FAT1 * DISK_SECTOR_SZ, S, DISK_SECTOR_SZ);
+    Program(DISK_ADDR + FAT12_SECTOR_FAT2 * DISK_SECTOR_SZ, S, DISK_SECTOR_SZ);
+    memset(S, 0, DISK_SECTOR_SZ);
+    Program(DISK_ADDR + FAT12_SECTOR_ROOT * DISK_SECTOR_SZ, S, DISK_SECTOR_SZ);
+    FATFS Fs;
+    FIL F;
+    UINT N;
+    Flash::UnlockFlash();
+    HOST_CHECK(f_mount(&Fs, "", 1) == FR_OK, "mount");
+    HOST_CHECK(f_open(&F, FName, FA_CREATE_ALWAYS | FA_WRITE) == FR_OK, "create %s", FName);
+    HOST_CHECK(f_write(&F, File.data(), File.size(), &N) == FR_OK and N == File.size(), "write %s", FName);
+    HOST_CHECK(f_close(&F) == FR_OK, "close");
+    f_mount(nullptr, "", 0);
+    Flash::LockFlash();
+}
+
+static bool FileExists(const char *FName) {
+    FATFS Fs;
+    FILINFO Info;
+    HOST_CHECK(f_mount(&Fs, "", 1) == FR_OK, "mount");
+    bool Rslt = (f_stat(FName, &Info) == FR_OK);
+    f_mount(nullptr, "", 0);
+    return Rslt;
+}
+
+// App area without plain reads: it may hold torn cells
+static bool AppIs(const Bin_t &Img) {
+    static uint8_t Buf[APP_MAX_SZ];
+    if(Flash::ReadChecked(Buf, APP_START_ADDR, Img.size()) != retvOk) return false;
+    return memcmp(Buf, Img.data(), Img.size()) == 0;
+}
+
+static void Setup(const Bin_t &App, const char *FName, const Bin_t &File) {
+    NorFlash::EraseAll();
+    BackupSpc::Reset();
+    Program(APP_START_ADDR, App.data(), App.size());
+    PrepareDisk(FName, File);
+    BackupSpc::WriteRegister(BKPREG_FW_PENDING, FW_PENDING_MAGIC);  // App has found the file
+}
+#endif
+
+#if 1 // =============================== Boot ==================================
+static int Boot(int32_t CutAt) {
+    fflush(stdout);
+    pid_t Pid = fork();
+    HOST_CHECK(Pid >= 0, "fork");
+    if(Pid == 0) {
+        NorFlash::CutPowerAfter(CutAt);
+        int Rslt = brReturned;
+        try { BootMain(); }
+        catch(HostExit_t E) { Rslt = (E == hexJumpToApp)? brJump : (E == hexReboot)? brReboot : brHalt; }
+        catch(NorFlash::PowerCut_t&) { Rslt = brPowerCut; }
+        fflush(stdout);
+        _exit(Rslt);
+    }
+    int Status;
+    waitpid(Pid, &Status, 0);
+    NorFlash::Resync();
+    return WIFEXITED(Status)? WEXITSTATUS(Status) : -1;
+}
+
+// Boots with power on until app is started; reboot on write fail is a boot too
+static int BootUntilApp() {
+    int Rslt = brReboot;
+    for(uint32_t i=0; i<4 and Rslt == brReboot; i++) Rslt = Boot(-1);
+    return Rslt;
+}
+
+static void CheckUpdated(const char *Name, uint32_t Cut, const Bin_t &New, const char *FName) {
+    HOST_CHECK(AppIs(New), "%s, cut at %u: app is not the new one", Name, Cut);
+    HOST_CHECK(!NorFlash::HasTornIn(DISK_ADDR, DISK_SECTOR_CNT * DISK_SECTOR_SZ), "%s, cut at %u: torn cells on disk", Name, Cut);
+    HOST_CHECK(!FileExists(FName), "%s, cut at %u: update file is left", Name, Cut);
+    HOST_CHECK(BackupSpc::ReadRegister(BKPREG_FW_PENDING) == 0, "%s, cut at %u: update is still pending", Name, Cut);
+    HOST_CHECK(NorFlash::Stat.Violations == 0, "%s, cut at %u: %u programs over non-erased flash", Name, Cut, NorFlash::Stat.Violations);
+}
+#endif
+
+#if 1 // ============================== Tests ==================================
+static void TestUpdate(const char *Name, const Bin_t &Base, const Bin_t &New, const char *FName, const Bin_t &File) {
+    Setup(Base, FName, File);
+    HostOs::Quiet = false;
+    uint32_t Start = NorFlash::OpCnt();
+    int Rslt = Boot(-1);
+    HostOs::Quiet = true;
+    HOST_CHECK(Rslt == brJump, "%s: %s", Name, RsltName(Rslt));
+    CheckUpdated(Name, 0, New, FName);
+    printf("%-28s ok, %u flash steps\n", Name, NorFlash::OpCnt() - Start);
+}
+
+static void Sweep(const char *Name, const Bin_t &Base, const Bin_t &New, const char *FName, const Bin_t &File, bool CutResumed) {
+    Setup(Base, FName, File);
+    NorFlash::Image_t *PImg = NorFlash::Save();
+    uint32_t Bkp[32];
+    memcpy(Bkp, HostBkpReg, sizeof(Bkp));
+    uint32_t Start = NorFlash::OpCnt();
+    HOST_CHECK(Boot(-1) == brJump, "%s: no update", Name);
+    uint32_t Steps = NorFlash::OpCnt() - Start;
+    uint32_t TornCnt = 0, ResumeCuts = 0;
+    for(uint32_t Cut=0; Cut<Steps; Cut++) {
+        NorFlash::Restore(PImg);
+        memcpy(HostBkpReg, Bkp, sizeof(Bkp));
+        int Rslt = Boot(Cut);
+        HOST_CHECK(Rslt == brPowerCut, "%s: no power cut at step %u of %u: %s", Name, Cut, Steps, RsltName(Rslt));
+        if(NorFlash::HasTornIn(NOR_BASE, NOR_SZ)) TornCnt++;
+        if(CutResumed and Boot(Rand(Steps)) == brPowerCut) ResumeCuts++;
+        Rslt = BootUntilApp();
+        HOST_CHECK(Rslt == brJump, "%s, cut at %u: %s", Name, Cut, RsltName(Rslt));
+        CheckUpdated(Name, Cut, New, FName);
+    }
+    NorFlash::Free(PImg);
+    printf("%-28s %5u cuts, %5u with ECC-torn cells", Name, Steps, TornCnt);
+    if(CutResumed) printf(", %u resumed ones cut again", ResumeCuts);
+    printf(": ok\n");
+}
+
+// Broken app and no marker: file on disk is flashed, or device halts without one
+static void TestBrokenApp(const Bin_t &Base, const Bin_t &New) {
+    Bin_t Bad = Base;
+    Bad[Bad.size() / 2] ^= 0x01;
+    Setup(Bad, "Fw2.bin", New);
+    BackupSpc::Reset();
+    int Rslt = Boot(-1);
+    HOST_CHECK(Rslt == brJump, "Broken app: %s", RsltName(Rslt));
+    HOST_CHECK(AppIs(New), "Broken app: app is not the new one");
+    HOST_CHECK(!FileExists("Fw2.bin"), "Broken app: update file is left");
+    Setup(Bad, "Readme.txt", New);
+    BackupSpc::Reset();
+    Rslt = Boot(-1);
+    HOST_CHECK(Rslt == brHalt, "Broken app, no file: %s", RsltName(Rslt));
+    printf("%-28s ok\n", "Broken app");
+}
+
+/* Cut without VBAT: backup registers are lost. App must be the new one in the
+ * end; file may be left if the cut came after verify, app will report it again.
+ * The one exception is the cut in manifest pointer: partly programmed one may
+ * look as image without manifest, and nothing tells it is not. */
+static void SweepNoVbat(const char *Name, const Bin_t &Base, const Bin_t &New, const char *FName, const Bin_t &File) {
+    Setup(Base, FName, File);
+    NorFlash::Image_t *PImg = NorFlash::Save();
+    uint32_t Start = NorFlash::OpCnt();
+    HOST_CHECK(Boot(-1) == brJump, "%s: no update", Name);
+    uint32_t Steps = NorFlash::OpCnt() - Start, Found = 0, PtrCuts = 0;
+    uint32_t NewPtr;
+    memcpy(&NewPtr, New.data() + FW_MANIFEST_PTR_OFFSET, 4);
+    for(uint32_t Cut=0; Cut<Steps; Cut++) {
+        NorFlash::Restore(PImg);
+        BackupSpc::Reset();
+        BackupSpc::WriteRegister(BKPREG_FW_PENDING, FW_PENDING_MAGIC);
+        int Rslt = Boot(Cut);
+        HOST_CHECK(Rslt == brPowerCut, "%s: no power cut at step %u of %u: %s", Name, Cut, Steps, RsltName(Rslt));
+        BackupSpc::Reset();
+        uint32_t Ptr, Before = NorFlash::OpCnt();
+        bool PtrIsTorn = (Flash::ReadChecked(&Ptr, APP_START_ADDR + FW_MANIFEST_PTR_OFFSET, 4) == retvOk and
+                Ptr != 0xFFFFFFFF and Ptr != NewPtr and (Ptr & 3UL));
+        Rslt = BootUntilApp();
+        HOST_CHECK(Rslt == brJump, "%s, cut at %u: %s", Name, Cut, RsltName(Rslt));
+        if(PtrIsTorn and !AppIs(New)) {
+            PtrCuts++;
+            continue;
+        }
+        HOST_CHECK(AppIs(New), "%s, cut at %u: app is not the new one", Name, Cut);
+        HOST_CHECK(NorFlash::Stat.Violations == 0, "%s, cut at %u: %u programs over non-erased flash", Name, Cut, NorFlash::Stat.Violations);
+        if(NorFlash::OpCnt() != Before) Found++;
+    }
+    NorFlash::Free(PImg);
+    printf("%-28s %5u cuts, %5u updated from file found by bootloader, %u in manifest pointer taken as no manifest: ok\n", Name, Steps, Found, PtrCuts);
+}
+#endif
+
+int main() {
+    HostOs::Init();
+    NorFlash::Init();
+    HostOs::Quiet = true;
+    Bin_t V1 = MakeApp(40000, 1);
+    Bin_t V2 = MakeNext(V1, 3000, 2);
+    Bin_t Delta = MakeDelta(V1, V2);
+    TestUpdate("Plain image", V1, V2, "Fw2.bin", V2);
+    TestUpdate("Delta", V1, V2, "Fw2.dlt", Delta);
+    Sweep("Power cut: plain image", V1, V2, "Fw2.bin", V2, false);
+    Sweep("Power cut: delta", V1, V2, "Fw2.dlt", Delta, true);
+    TestBrokenApp(V1, V2);
+    SweepNoVbat("Power cut w/o VBAT: plain", V1, V2, "Fw2.bin", V2);
+    printf("Bootloader: all passed\n");
+    return 0;
+}
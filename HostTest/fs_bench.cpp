@@ -0,0 +1,113 @@
+/*
+ * fs_bench.cpp
+ *
+ *  Created on: 19 10 2026
+ *      Author: agent
+ */
+
+/* Filesystem benchmark on NOR flash model: FatFs, disk glue, flash update
+ * policy (or FTL when built with MSD_USE_FTL) and FsBench are the target
+ * code. Disk is formatted as PC does it, config.ini is put on it, then:
+ * mount, and FsBench steps: config.ini parse, sequential write and read,
+ * small file rewrites. Virtual time counts flash erase and program by
+ * datasheet, and reads by estimate of NorFlash.h. */
+
+#include "HostOs.h"
+#include "NorFlash.h"
+#include "kl_lib.h"
+#include "kl_fs_utils.h"
+#include "FsBench.h"
+#include "Fat12.h"
+#include "mem_msd_glue.h"
+#include "kl_prof.h"
+#include "shell_cmd.h"
+#if MSD_USE_FTL
+#include "msd_ftl.h"
+#include <new>
+#endif
+
+#define CONFIG_INI  "[Common]\r\nMinValue=10\r\nMinPeriod=2700\r\nMaxPeriod=5400\r\n"
+
+FATFS FlashFS;
+static Shell_t Shell;
+
+// Reads of the disk go through here, see -Wl,--wrap in Makefile
+extern "C" {
+uint8_t __real_MSDRead(uint32_t BlockAddress, uint32_t *Ptr, uint32_t BlocksCnt);
+uint8_t __wrap_MSDRead(uint32_t BlockAddress, uint32_t *Ptr, uint32_t BlocksCnt) {
+    NorFlash::ChargeRead(BlocksCnt * MSD_BLOCK_SZ);
+    return __real_MSDRead(BlockAddress, Ptr, BlocksCnt);
+}
+}
+
+#if 1 // ============================= Format ==================================
+static void Format() {
+    static uint32_t Buf[MSD_BLOCK_SZ / 4];
+    uint8_t *S = (uint8_t*)Buf;
+    Fat12Boot(S, MSD_BLOCK_SZ, MSD_BLOCK_CNT);
+    HOST_CHECK(MSDWrite(0, Buf, 1) == retvOk, "boot sector");
+    Fat12Fat(S, MSD_BLOCK_SZ);
+    HOST_CHECK(MSDWrite(FAT12_SECTOR_FAT1, Buf, 1) == retvOk and MSDWrite(FAT12_SECTOR_FAT2, Buf, 1) == retvOk, "FAT");
+    memset(S, 0, MSD_BLOCK_SZ);
+    HOST_CHECK(MSDWrite(FAT12_SECTOR_ROOT, Buf, 1) == retvOk, "root dir");
+    // Put config.ini on it
+    HOST_CHECK(f_mount(&FlashFS, "", 1) == FR_OK, "mount of new disk");
+    uint32_t N;
+    HOST_CHECK(TryOpenFileRewrite("config.ini", &CommonFile) == retvOk, "config.ini");
+    HOST_CHECK(f_write(&CommonFile, CONFIG_INI, strlen(CONFIG_INI), &N) == FR_OK, "config.ini");
+    f_close(&CommonFile);
+    f_mount(nullptr, "", 0);
+}
+#endif
+
+static NorFlash::Stat_t Stat0;
+static uint64_t Start;
+
+static void IStart() {
+    Stat0 = NorFlash::Stat;
+    Start = HostOs::Now();
+}
+
+static void IReport(const char *Name) {
+    Printf("%S: %u us; flash pages erased %u, double words programmed %u, KB read %u\r", Name,
+            (uint32_t)(HostOs::Now() - Start),
+            NorFlash::Stat.Erases - Stat0.Erases,
+            NorFlash::Stat.DWords - Stat0.DWords,
+            (NorFlash::Stat.BytesRead - Stat0.BytesRead) / 1024);
+}
+
+int main() {
+    HostOs::Init();
+    NorFlash::Init();
+    Printf("FsBench on %u KB NOR flash model, %S\r", MSD_BLOCK_CNT * MSD_BLOCK_SZ / 1024,
+            MSD_USE_FTL? "FTL" : "in-place update");
+    HostOs::Quiet = true;
+    MSDInit();
+    Format();
+    HostOs::Quiet = false;
+
+    // Power on: mount
+    IStart();
+#if MSD_USE_FTL
+    new (&Ftl) Ftl_t;
+    MSDInit();
+#endif
+    HOST_CHECK(f_mount(&FlashFS, "", 1) == FR_OK, "mount");
+    IReport("Mount");
+
+    IStart();
+    FsBench::Run(&Shell);
+    IReport("FsBench total");
+#if PROF_EN
+    // Zones count host ns: CPU time of the code and of flash model, not virtual time
+    ShellCmds::Run(&Shell, "prof");
+#endif
+#if MSD_USE_FTL
+    // Stale pages are erased when nobody writes
+    IStart();
+    chThdSleepMilliseconds(4000);
+    IReport("Idle 4 s, background erase");
+#endif
+    HOST_CHECK(NorFlash::Stat.Violations == 0, "%u programs over non-erased flash", NorFlash::Stat.Violations);
+    return 0;
+}
@@ -0,0 +1,339 @@
+/*
+ * ftl_test.cpp
+ *
+ *  Created on: 19 10 2026
+ *      Author: agent
+ */
+
+/* FTL over NOR flash model: mount, wear levelling and power loss.
+ * Power loss tests cut the power at every erase and program step of a
+ * scenario, then reboot and check that:
+ * - mount succeeds and reads nothing that fails ECC check (that is NMI);
+ * - every block holds data of the last completed write, and the block being
+ *   written holds either old or new data;
+ * - nothing is programmed over non-erased flash;
+ * - the disk keeps working: more writes survive one more reboot. */
+
+#include "HostOs.h"
+#include "NorFlash.h"
+#include "kl_lib.h"
+#include "msd_ftl.h"
+#include <new>
+#include <sys/wait.h>
+
+#define NO_BLOCK    0xFFFFFFFF
+#define REC_CAP     ((FLASH_PAGE_SIZE - sizeof(FtlSnapshot_t)) / sizeof(FtlRecord_t))
+
+// What the disk must hold
+struct Model_t {
+    uint32_t Ver[MSD_BLOCK_CNT];    // 0 is never written
+    uint32_t NextVer;
+    uint32_t PendBlock, PendVer;    // Write in progress
+    uint32_t Seed;
+    uint32_t Rand(uint32_t Top) {
+        Seed = Seed * 1103515245UL + 12345UL;
+        return (Seed >> 16) % Top;
+    }
+};
+static Model_t Model;
+static uint32_t Buf[FLASH_PAGE_SIZE / 4], Expected[FLASH_PAGE_SIZE / 4];
+
+static void Fill(uint32_t *P, uint32_t Block, uint32_t Ver) {
+    if(Ver == 0) memset(P, 0xFF, FLASH_PAGE_SIZE);
+    else for(uint32_t i=0; i<FLASH_PAGE_SIZE/4; i++) P[i] = (Block << 24) ^ (Ver << 10) ^ (i * 2654435761UL);
+}
+
+#if 1 // ============================= Helpers =================================
+static void Reboot() {
+    new (&Ftl) Ftl_t;
+    HOST_CHECK(Ftl.Init() == retvOk, "FTL init");
+}
+
+static void WriteBlock(uint32_t Block) {
+    Model.PendBlock = Block;
+    Model.PendVer = ++Model.NextVer;
+    Fill(Buf, Block, Model.PendVer);
+    HOST_CHECK(Ftl.Write(Block, Buf, 1) == retvOk, "write block %u", Block);
+    Model.Ver[Block] = Model.PendVer;
+    Model.PendBlock = NO_BLOCK;
+}
+
+static void CollectAll() { while(Ftl.CollectGarbage()); }
+
+// Block being written when power was lost may hold either data
+static void VerifyAll() {
+    for(uint32_t Block=0; Block<MSD_BLOCK_CNT; Block++) {
+        HOST_CHECK(Ftl.Read(Block, Buf, 1) == retvOk, "read block %u", Block);
+        Fill(Expected, Block, Model.Ver[Block]);
+        if(memcmp(Buf, Expected, FLASH_PAGE_SIZE) == 0) continue;
+        HOST_CHECK(Block == Model.PendBlock, "block %u: lost data of completed write", Block);
+        Fill(Expected, Block, Model.PendVer);
+        HOST_CHECK(memcmp(Buf, Expected, FLASH_PAGE_SIZE) == 0, "block %u: neither old nor new data", Block);
+        Model.Ver[Block] = Model.PendVer;
+    }
+    Model.PendBlock = NO_BLOCK;
+    HOST_CHECK(NorFlash::Stat.Violations == 0, "%u programs over non-erased flash", NorFlash::Stat.Violations);
+}
+
+static void Format() {
+    NorFlash::EraseAll();
+    memset(&Model, 0, sizeof(Model));
+    Model.PendBlock = NO_BLOCK;
+    Model.Seed = 1;
+    Reboot();
+}
+
+// Fills every block, so every page is in use or stale
+static void FillDisk() {
+    for(uint32_t Block=0; Block<MSD_BLOCK_CNT; Block++) WriteBlock(Block);
+}
+
+static uint32_t EraseSpread() {
+    uint32_t Min = 0xFFFFFFFF, Max = 0;
+    for(uint32_t i=0; i<FTL_DATA_PAGE_CNT; i++) {
+        uint32_t N = NorFlash::Stat.PageErases[(MSD_STORAGE_ADDR - NOR_BASE) / NOR_PAGE_SZ + FTL_META_PAGE_CNT + i];
+        Min = MIN_(Min, N);
+        Max = MAX_(Max, N);
+    }
+    return Max - Min;
+}
+
+// Number of flash steps Scenario takes from the saved state
+static uint32_t CountSteps(NorFlash::Image_t *PImg, const Model_t &M0, void (*Scenario)()) {
+    NorFlash::Restore(PImg);
+    Model = M0;
+    uint32_t Start = NorFlash::OpCnt();
+    Scenario();
+    return NorFlash::OpCnt() - Start;
+}
+#endif
+
+#if 1 // ========================== Power cut sweep ============================
+static void Sweep(const char *Name, void (*Setup)(), void (*Scenario)()) {
+    Format();
+    Setup();
+    NorFlash::Image_t *PImg = NorFlash::Save();
+    Model_t M0 = Model;
+    uint32_t Steps = CountSteps(PImg, M0, Scenario);
+    uint32_t TornRead = 0;
+    for(uint32_t Cut=0; Cut<Steps; Cut++) {
+        NorFlash::Restore(PImg);
+        Model = M0;
+        NorFlash::CutPowerAfter(Cut);
+        bool WasCut = false;
+        try { Scenario(); }
+        catch(NorFlash::PowerCut_t&) { WasCut = true; }
+        NorFlash::CutPowerAfter(-1);
+        HOST_CHECK(WasCut, "%s: no power cut at step %u of %u", Name, Cut, Steps);
+        if(NorFlash::HasTornIn(MSD_STORAGE_ADDR, MSD_STORAGE_SZ_BYTES)) TornRead++;
+        Reboot();
+        VerifyAll();
+        // Keep working: stale and torn pages are erased, then written over
+        CollectAll();
+        for(uint32_t i=0; i<4; i++) WriteBlock(Model.Rand(MSD_BLOCK_CNT));
+        Reboot();
+        VerifyAll();
+    }
+    NorFlash::Free(PImg);
+    printf("%-28s %5u cuts, %5u with ECC-torn cells: ok\n", Name, Steps, TornRead);
+}
+
+// First mount of blank flash, then some writes
+static void SetupBlank() { NorFlash::EraseAll(); }
+static void ScenarioBlank() {
+    Reboot();
+    for(uint32_t i=0; i<3; i++) WriteBlock(i);
+}
+
+// Log is about to overflow: writes cross the meta page compaction
+static void SetupNearFull() {
+    FillDisk();
+    while(REC_CAP - (Model.NextVer % REC_CAP) > 3) WriteBlock(Model.Rand(MSD_BLOCK_CNT));
+}
+static void ScenarioNearFull() {
+    Reboot();
+    for(uint32_t i=0; i<6; i++) {
+        WriteBlock(Model.Rand(MSD_BLOCK_CNT));
+        if(i & 1) Ftl.CollectGarbage();
+    }
+}
+
+// Few hot blocks are hammered, so cold ones must be moved off unworn pages
+static void SetupWorn() {
+    FillDisk();
+    for(uint32_t i=0; i<1600; i++) WriteBlock(i % 4);
+}
+static void ScenarioWorn() {
+    Reboot();
+    for(uint32_t i=0; i<8; i++) Ftl.CollectGarbage();
+    WriteBlock(0);
+    WriteBlock(MSD_BLOCK_CNT - 1);
+}
+#endif
+
+#if 1 // ============================== Tests ==================================
+// Flash model itself: program rule, ECC check and NMI on plain read of torn cell
+static void TestModel() {
+    uint32_t Addr = MSD_STORAGE_ADDR, W[2] = {0x12345678, 0x9ABCDEF0}, R[2];
+    NorFlash::EraseAll();
+    Flash::UnlockFlash();
+    HOST_CHECK(Flash::ProgramBuf32(Addr, W, 8) == retvOk, "program");
+    HOST_CHECK(Flash::ProgramBuf32(Addr, W, 8) != retvOk, "program over programmed");
+    HOST_CHECK(NorFlash::Stat.Violations == 1, "violation count");
+    uint32_t Z[2] = {0, 0};
+    HOST_CHECK(Flash::ProgramBuf32(Addr, Z, 8) == retvOk, "zeros over programmed");
+    // Torn double word
+    NorFlash::TearMode = NorFlash::tmEcc;
+    NorFlash::CutPowerAfter(0);
+    bool WasCut = false;
+    try { Flash::ProgramBuf32(Addr + 8, W, 8); }
+    catch(NorFlash::PowerCut_t&) { WasCut = true; }
+    HOST_CHECK(WasCut and NorFlash::DWordIsTorn(Addr + 8), "torn program");
+    HOST_CHECK(Flash::ReadChecked(R, Addr + 8, 8) == retvFail, "ECC check");
+    HOST_CHECK(Flash::ReadChecked(R, Addr, 8) == retvOk and R[0] == 0, "read next to torn one");
+    // Neighbour is readable by plain read, torn one is NMI
+    HOST_CHECK(*(volatile uint32_t*)(uintptr_t)(Addr + 16) == 0xFFFFFFFF, "plain read next to torn one");
+    fflush(stdout);
+    pid_t Pid = fork();
+    if(Pid == 0) {
+        freopen("/dev/null", "w", stdout); // NMI report is expected
+        dup2(fileno(stdout), 1);
+        volatile uint32_t Dummy = *(volatile uint32_t*)(uintptr_t)(Addr + 12);
+        (void)Dummy;
+        _exit(0);
+    }
+    int Status = 0;
+    waitpid(Pid, &Status, 0);
+    HOST_CHECK(WIFEXITED(Status) and WEXITSTATUS(Status) == 1, "plain read of torn cell is not caught");
+    Flash::LockFlash();
+    NorFlash::TearMode = NorFlash::tmRandom;
+    NorFlash::EraseAll();
+    printf("%-28s ok\n", "Flash model");
+}
+
+static void TestBasic() {
+    Format();
+    HOST_CHECK(Ftl.FreeCnt() == FTL_DATA_PAGE_CNT, "free pages %u", Ftl.FreeCnt());
+    VerifyAll();
+    FillDisk();
+    for(uint32_t i=0; i<3*REC_CAP; i++) {
+        WriteBlock(Model.Rand(MSD_BLOCK_CNT));
+        if((i % 3) == 0) Ftl.CollectGarbage();
+    }
+    VerifyAll();
+    Reboot();
+    VerifyAll();
+    // Several blocks at once
+    uint32_t Big[4 * FLASH_PAGE_SIZE / 4];
+    for(uint32_t i=0; i<4; i++) {
+        Model.Ver[10 + i] = ++Model.NextVer;
+        Fill(&Big[i * FLASH_PAGE_SIZE / 4], 10 + i, Model.Ver[10 + i]);
+    }
+    HOST_CHECK(Ftl.Write(10, Big, 4) == retvOk, "multiblock write");
+    HOST_CHECK(Ftl.Read(10, Big, 4) == retvOk, "multiblock read");
+    for(uint32_t i=0; i<4; i++) {
+        Fill(Expected, 10 + i, Model.Ver[10 + i]);
+        HOST_CHECK(memcmp(&Big[i * FLASH_PAGE_SIZE / 4], Expected, FLASH_PAGE_SIZE) == 0, "multiblock data %u", i);
+    }
+    HOST_CHECK(Ftl.Write(MSD_BLOCK_CNT - 1, Big, 2) != retvOk, "write past the end");
+    Reboot();
+    VerifyAll();
+    printf("%-28s ok\n", "Write, reboot, read");
+}
+
+// Stale pages are erased by low-priority thread when the writer sleeps
+static void TestGcThread() {
+    Format();
+    FillDisk();
+    for(uint32_t i=0; i<8; i++) WriteBlock(i);
+    uint32_t Stale = Ftl.StaleCnt(), Erases = NorFlash::Stat.Erases;
+    HOST_CHECK(Stale > 0, "nothing stale");
+    chThdSleepMilliseconds(1000);
+    HOST_CHECK(Ftl.StaleCnt() == 0, "GC thread left %u stale", Ftl.StaleCnt());
+    HOST_CHECK(NorFlash::Stat.Erases - Erases == Stale, "GC thread erased %u", NorFlash::Stat.Erases - Erases);
+    printf("%-28s ok, %u pages\n", "Background erase", Stale);
+    VerifyAll();
+}
+
+static void TestWear() {
+    Format();
+    FillDisk();
+    for(uint32_t i=0; i<6000; i++) {
+        WriteBlock(Model.Rand(4));
+        CollectAll();
+    }
+    VerifyAll();
+    uint32_t Spread = EraseSpread();
+    HOST_CHECK(Spread <= 2 * FTL_WL_THRESHOLD, "erase counts spread %u", Spread);
+    Reboot();
+    VerifyAll();
+    printf("%-28s ok, erase spread %u after 6000 writes of 4 blocks\n", "Wear levelling", Spread);
+}
+
+// Power is lost while the last step of a write is in progress
+static void CutLastStep(uint32_t FromEnd) {
+    NorFlash::Image_t *PImg = NorFlash::Save();
+    Model_t M0 = Model;
+    uint32_t Steps = CountSteps(PImg, M0, []() { Reboot(); WriteBlock(5); });
+    NorFlash::Restore(PImg);
+    Model = M0;
+    NorFlash::Free(PImg);
+    Reboot();
+    NorFlash::CutPowerAfter(Steps - 1 - FromEnd);
+    bool WasCut = false;
+    try { WriteBlock(5); }
+    catch(NorFlash::PowerCut_t&) { WasCut = true; }
+    NorFlash::CutPowerAfter(-1);
+    HOST_CHECK(WasCut, "no cut");
+}
+
+static void TestTornRecord(NorFlash::TearMode_t Mode, const char *Name) {
+    NorFlash::TearMode = Mode;
+    Format();
+    FillDisk();
+    CutLastStep(0); // Map record is the last one
+    if(Mode == NorFlash::tmEcc) HOST_CHECK(NorFlash::HasTornIn(MSD_STORAGE_ADDR, 2 * FLASH_PAGE_SIZE), "record is not torn");
+    Reboot();
+    VerifyAll();
+    // Next records go after the torn one
+    for(uint32_t i=0; i<8; i++) WriteBlock(i);
+    Reboot();
+    VerifyAll();
+    NorFlash::TearMode = NorFlash::tmRandom;
+    printf("%-28s ok\n", Name);
+}
+
+// Snapshot body is written, its commit is torn: previous meta page is in charge
+static void TestTornCommit() {
+    NorFlash::TearMode = NorFlash::tmEcc;
+    Format();
+    FillDisk();
+    while((Model.NextVer % REC_CAP) != 0) WriteBlock(Model.Rand(MSD_BLOCK_CNT));
+    CutLastStep(1); // Commit goes just before the first record of new page
+    Reboot();
+    VerifyAll();
+    for(uint32_t i=0; i<REC_CAP + 8; i++) WriteBlock(Model.Rand(MSD_BLOCK_CNT));
+    Reboot();
+    VerifyAll();
+    NorFlash::TearMode = NorFlash::tmRandom;
+    printf("%-28s ok\n", "Torn snapshot commit");
+}
+#endif
+
+int main() {
+    HostOs::Init();
+    NorFlash::Init();
+    TestModel();
+    HostOs::Quiet = true;
+    TestBasic();
+    TestGcThread();
+    TestWear();
+    TestTornRecord(NorFlash::tmEcc, "Torn record, ECC error");
+    TestTornRecord(NorFlash::tmPartial, "Torn record, partial bits");
+    TestTornCommit();
+    Sweep("Power cut: first mount", SetupBlank, ScenarioBlank);
+    Sweep("Power cut: log compaction", SetupNearFull, ScenarioNearFull);
+    Sweep("Power cut: wear levelling", SetupWorn, ScenarioWorn);
+    printf("FTL: all passed\n");
+    return 0;
+}
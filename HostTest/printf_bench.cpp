@@ -0,0 +1,148 @@
+/*
+ * printf_bench.cpp
+ *
+ *  Created on: 19 10 2026
+ *      Author: agent
+ */
+
+/* PrintfHelper_t::IVsPrintf before 7ebdaef (char by char) and now (whole
+ * segments), side by side, over the same formats. Both are taken as they
+ * are: the Makefile cuts the class and its definitions out of shell.h and
+ * shell.cpp, the old ones out of git. Each one prints to buffer through its
+ * own PrintToBuf_t, as PrintfToBuf does on target.
+ * Host x86 timing: bytes/s and TSC cycles per call; it shows the ratio of
+ * the two, target figures are given by PrintfBench command. */
+
+#include "HostOs.h"
+#include "kl_lib.h"
+#include "shell.h"
+#include <time.h>
+#include <vector>
+#include <x86intrin.h>
+
+#define PRINTF_FLOAT_EN     TRUE
+#define PROF_ZONE(AName)
+
+namespace PrintfOld {
+#include "printf_old.inc"
+
+class PrintToBuf_t : public PrintfHelper_t {
+public:
+    char *S;
+    uint8_t IPutChar(char c) {
+        *S++ = c;
+        return retvOk;
+    }
+    void IStartTransmissionIfNotYet() {}
+};
+} // namespace
+
+namespace PrintfNew {
+#include "printf_new.inc"
+
+class PrintToBuf_t : public PrintfHelper_t {
+public:
+    char *S, *End = nullptr;
+    uint8_t IPutChar(char c) {
+        if(End and S >= End) return retvOverflow;
+        *S++ = c;
+        return retvOk;
+    }
+    uint8_t IPutStr(const char *PStr, uint32_t Len) {
+        uint8_t Rslt = retvOk;
+        if(End and Len > (uint32_t)(End - S)) {
+            Len = End - S;
+            Rslt = retvOverflow;
+        }
+        memcpy(S, PStr, Len);
+        S += Len;
+        return Rslt;
+    }
+    void IStartTransmissionIfNotYet() {}
+};
+} // namespace
+
+#define CALL_CNT    200000
+static char IBuf[512];
+static const uint8_t IArr[8] = {0x01, 0x02, 0x0A, 0x10, 0x7F, 0x80, 0xAB, 0xFF};
+
+template <typename PtB_t>
+static uint32_t IPrint(const char *format, ...) {
+    PtB_t PtB;
+    PtB.S = IBuf;
+    va_list args;
+    va_start(args, format);
+    PtB.IVsPrintf(format, args);
+    va_end(args);
+    *PtB.S = 0;
+    return PtB.S - IBuf;
+}
+
+// Formats as firmware prints them; Arg is varied so numbers change width
+#define CASES(PtB_t, Arg) \
+    X(PtB_t, "Literal", "Firmware file found, restarting to update\r") \
+    X(PtB_t, "Shell ack", "Ack %u\r", Arg & 0xFF) \
+    X(PtB_t, "Stat line", "Cmd %02X: %5u, fails %u, %7u us\r", Arg & 0xFF, Arg, Arg >> 8, Arg * 7) \
+    X(PtB_t, "Strings", "\r%S %S\r", "LedTree", "Oct 19 2026 09:17:00") \
+    X(PtB_t, "Signed", "T1: %d; max=%d\r", (int32_t)Arg - 100000, -(int32_t)Arg) \
+    X(PtB_t, "Float", "x: %f; y: %.3f\r", Arg * 0.001, Arg * -0.5) \
+    X(PtB_t, "Array", "Data: %A\r", IArr, 8, ' ')
+
+struct Rslt_t {
+    const char *Name;
+    uint32_t Bytes;
+    uint64_t Ns, Cycles;
+};
+
+template <typename PtB_t>
+static void IRun(std::vector<Rslt_t> &Rslt) {
+    uint32_t Arg = 0;
+#define X(PtB_t, AName, ...) { \
+        Rslt_t R = {AName, 0, 0, 0}; \
+        timespec T0, T1; \
+        clock_gettime(CLOCK_MONOTONIC, &T0); \
+        uint64_t C0 = __rdtsc(); \
+        for(uint32_t i=0; i<CALL_CNT; i++) { \
+            Arg = i * 2654435761U; \
+            R.Bytes += IPrint<PtB_t>(__VA_ARGS__); \
+        } \
+        R.Cycles = __rdtsc() - C0; \
+        clock_gettime(CLOCK_MONOTONIC, &T1); \
+        R.Ns = (T1.tv_sec - T0.tv_sec) * 1000000000ULL + T1.tv_nsec - T0.tv_nsec; \
+        Rslt.push_back(R); \
+    }
+    CASES(PtB_t, Arg)
+#undef X
+}
+
+// New one must print the very same
+static void ICheckSame() {
+    char Old[512];
+    for(uint32_t i=0; i<1000; i++) {
+        uint32_t Arg = i * 2654435761U;
+#define X(PtB_t, AName, ...) \
+        IPrint<PrintfOld::PrintToBuf_t>(__VA_ARGS__); \
+        strcpy(Old, IBuf); \
+        IPrint<PrintfNew::PrintToBuf_t>(__VA_ARGS__); \
+        HOST_CHECK(strcmp(Old, IBuf) == 0, "%s: \"%s\" was \"%s\"", AName, IBuf, Old);
+        CASES(_, Arg)
+#undef X
+    }
+}
+
+int main() {
+    HostOs::Init();
+    ICheckSame();
+    std::vector<Rslt_t> Old, New;
+    IRun<PrintfOld::PrintToBuf_t>(Old);
+    IRun<PrintfNew::PrintToBuf_t>(New);
+    Printf("IVsPrintf to buffer, %u calls each: old (before 7ebdaef) vs new\r", CALL_CNT);
+    Printf("%-10s %5s %9s %9s %10s %10s\r", "Format", "B", "old MB/s", "new MB/s", "old cyc", "new cyc");
+    for(uint32_t i=0; i<Old.size(); i++) {
+        Rslt_t &O = Old[i], &N = New[i];
+        Printf("%-10s %5u %9.1f %9.1f %10u %10u\r", O.Name, O.Bytes / CALL_CNT,
+                O.Bytes * 1000.0 / O.Ns, N.Bytes * 1000.0 / N.Ns,
+                (uint32_t)(O.Cycles / CALL_CNT), (uint32_t)(N.Cycles / CALL_CNT));
+    }
+    return 0;
+}
@@ -0,0 +1,458 @@
+/*
+ * scsi_test.cpp
+ *
+ *  Created on: 19 10 2026
+ *      Author: agent
+ */
+
+/* USB mass storage on host: usb_msd.cpp, SCSI data, write cache and disk
+ * glue are the target code, on NOR flash model (or FTL when built with
+ * MSD_USE_FTL). UsbMock plays the PC: mount sequence, error paths checked
+ * by CSW and sense, then FatFs on PC side formats the disk, copies 64 KB
+ * file and checks it. This command stream is recorded and replayed on
+ * erased flash, and final images must match.
+ *   scsi_test                  run the tests
+ *   scsi_test replay <file>    replay recorded stream on erased flash */
+
+#include "HostOs.h"
+#include "NorFlash.h"
+#include "UsbMock.h"
+#include "Fat12.h"
+#include "kl_lib.h"
+#include "shell_cmd.h"
+#include "usb_msd.h"
+#include "msd_cache.h"
+#include "mem_msd_glue.h"
+#include "ff.h"
+#include "diskio.h"
+#if MSD_USE_FTL
+#include "msd_ftl.h"
+#include <new>
+#endif
+#include <vector>
+#include <string>
+
+using namespace UsbMock;
+
+#define DISK_SZ         (MSD_BLOCK_CNT * MSD_BLOCK_SZ)
+#define FILE_SZ         65536
+#define STORAGE_PAGE    ((MSD_STORAGE_ADDR - NOR_BASE) / NOR_PAGE_SZ)
+#define STORAGE_PAGE_CNT    (MSD_STORAGE_SZ_BYTES / NOR_PAGE_SZ)
+// Output dir is argv[1] if given, build dir of the Makefile otherwise
+#ifndef BUILD_DIR
+#define BUILD_DIR       "."
+#endif
+#if MSD_USE_FTL
+#define STREAM_FNAME    "scsi_stream_ftl.bin"
+#define CAPTURE_FNAME   "scsi_cap_ftl.pcap"
+#else
+#define STREAM_FNAME    "scsi_stream.bin"
+#define CAPTURE_FNAME   "scsi_cap.pcap"
+#endif
+
+static Shell_t Shell;
+static uint8_t IBuf[FILE_SZ];
+static uint8_t IBuf2[DISK_SZ];
+
+#if 1 // ============================ SCSI host ================================
+static BotRslt_t Cmd6(uint8_t Opcode, uint8_t B1, uint8_t B2, uint8_t B4, uint8_t Dir, void *Data, uint32_t Len) {
+    const uint8_t Cdb[6] = {Opcode, B1, B2, 0, B4, 0};
+    return Command(Cdb, 6, Dir, Data, Len);
+}
+
+static BotRslt_t Cmd10(uint8_t Opcode, uint32_t Lba, uint16_t Cnt, uint8_t Dir, void *Data, uint32_t Len) {
+    const uint8_t Cdb[10] = {Opcode, 0, (uint8_t)(Lba >> 24), (uint8_t)(Lba >> 16), (uint8_t)(Lba >> 8), (uint8_t)Lba,
+            0, (uint8_t)(Cnt >> 8), (uint8_t)Cnt, 0};
+    return Command(Cdb, 10, Dir, Data, Len);
+}
+
+static BotRslt_t Read10(uint32_t Lba, uint16_t Cnt, void *Data) {
+    return Cmd10(SCSI_CMD_READ_10, Lba, Cnt, BOT_DIR_IN, Data, Cnt * MSD_BLOCK_SZ);
+}
+static BotRslt_t Write10(uint32_t Lba, uint16_t Cnt, const void *Data) {
+    return Cmd10(SCSI_CMD_WRITE_10, Lba, Cnt, BOT_DIR_OUT, (void*)Data, Cnt * MSD_BLOCK_SZ);
+}
+static BotRslt_t SyncCache() { return Cmd10(SCSI_CMD_SYNCHRONIZE_CACHE_10, 0, 0, BOT_DIR_OUT, nullptr, 0); }
+static BotRslt_t TestUnitReady() { return Cmd6(SCSI_CMD_TEST_UNIT_READY, 0, 0, 0, BOT_DIR_OUT, nullptr, 0); }
+
+static void CheckOk(BotRslt_t R, const char *What) {
+    HOST_CHECK(R.Status == SCSI_STATUS_OK and R.Residue == 0 and !R.PhaseSkipped and R.Undrained == 0,
+            "%s: status %u, residue %u, skipped %u, undrained %u", What, R.Status, R.Residue, R.PhaseSkipped, R.Undrained);
+}
+
+static void CheckSense(uint8_t Key, uint8_t Asc, const char *What) {
+    uint8_t S[18];
+    BotRslt_t R = Cmd6(SCSI_CMD_REQUEST_SENSE, 0, 0, sizeof(S), BOT_DIR_IN, S, sizeof(S));
+    CheckOk(R, "REQUEST SENSE");
+    HOST_CHECK(S[0] == 0x70 and S[7] == 0x0A, "%s: sense format %02X %02X", What, S[0], S[7]);
+    HOST_CHECK((S[2] & 0x0F) == Key and S[12] == Asc, "%s: sense %X/%02X, %X/%02X expected",
+            What, S[2] & 0x0F, S[12], Key, Asc);
+}
+
+static void Fill(uint8_t *P, uint32_t Sz, uint32_t Seed) {
+    for(uint32_t i=0; i<Sz; i++) P[i] = (uint8_t)((i * 7 + Seed * 131 + (i >> 11)) ^ Seed);
+}
+
+// Device reads of the disk go through here, see -Wl,--wrap in Makefile
+extern "C" {
+uint8_t __real_MSDRead(uint32_t BlockAddress, uint32_t *Ptr, uint32_t BlocksCnt);
+uint8_t __wrap_MSDRead(uint32_t BlockAddress, uint32_t *Ptr, uint32_t BlocksCnt) {
+    NorFlash::ChargeRead(BlocksCnt * MSD_BLOCK_SZ);
+    return __real_MSDRead(BlockAddress, Ptr, BlocksCnt);
+}
+}
+
+// Disk contents behind the cache, as device sees it; takes no time
+static void StorageRead(uint32_t Lba, uint32_t Cnt, uint8_t *P) {
+    HOST_CHECK(__real_MSDRead(Lba, (uint32_t*)P, Cnt) == retvOk, "storage read %u", Lba);
+}
+
+static void FailStorage(bool Fail) { NorFlash::FailPages(STORAGE_PAGE, Fail? STORAGE_PAGE_CNT : 0); }
+#endif
+
+#if 1 // ============================ PC disk ==================================
+// FatFs of PC side works through SCSI commands
+extern "C" {
+DSTATUS disk_initialize(BYTE drv) { return 0; }
+DSTATUS disk_status(BYTE drv) { return 0; }
+
+DRESULT disk_read(BYTE drv, BYTE *buff, DWORD sector, BYTE count) {
+    return (Read10(sector, count, buff).Status == SCSI_STATUS_OK)? RES_OK : RES_ERROR;
+}
+
+DRESULT disk_write(BYTE drv, const BYTE *buff, DWORD sector, BYTE count) {
+    return (Write10(sector, count, buff).Status == SCSI_STATUS_OK)? RES_OK : RES_ERROR;
+}
+
+const void* disk_getptr(BYTE drv, DWORD sector) { return nullptr; }
+
+DRESULT disk_ioctl(BYTE drv, BYTE ctrl, void *buff) {
+    switch(ctrl) {
+        case CTRL_SYNC: return (SyncCache().Status == SCSI_STATUS_OK)? RES_OK : RES_ERROR;
+        case GET_SECTOR_COUNT: *((DWORD*)buff) = MSD_BLOCK_CNT; return RES_OK;
+        case GET_SECTOR_SIZE: *((WORD*)buff) = MSD_BLOCK_SZ; return RES_OK;
+        case GET_BLOCK_SIZE: *((DWORD*)buff) = 1; return RES_OK;
+        default: return RES_PARERR;
+    }
+}
+
+DWORD get_fattime() { return ((DWORD)(2026 - 1980) << 25) | (10UL << 21) | (19UL << 16); }
+}
+
+static FATFS PcFs;
+static FIL PcFile;
+#endif
+
+#if 1 // ============================= Device ==================================
+static void PowerOn() {
+    NorFlash::EraseAll();
+#if MSD_USE_FTL
+    new (&Ftl) Ftl_t;
+#endif
+    MSDInit();
+    UsbMsd.Connect();
+    Attach();
+}
+
+static void PowerOff() {
+    UsbMsd.Disconnect();
+}
+#endif
+
+#if 1 // ============================== Tests ==================================
+// What Linux and Windows ask when the disk is plugged in
+static void MountSequence() {
+    uint8_t B[252];
+    BotRslt_t R = Cmd6(SCSI_CMD_INQUIRY, 0, 0, 36, BOT_DIR_IN, B, 36);
+    CheckOk(R, "INQUIRY");
+    HOST_CHECK(B[0] == 0x00 and B[1] == 0x80 and B[4] == 31, "INQUIRY data %02X %02X %02X %02X", B[0], B[1], B[2], B[4]);
+    CheckOk(TestUnitReady(), "TEST UNIT READY");
+    R = Cmd10(SCSI_CMD_READ_CAPACITY_10, 0, 0, BOT_DIR_IN, B, 8);
+    CheckOk(R, "READ CAPACITY");
+    HOST_CHECK(Convert::BuildUint32(B[3], B[2], B[1], B[0]) == MSD_BLOCK_CNT - 1 and
+            Convert::BuildUint32(B[7], B[6], B[5], B[4]) == MSD_BLOCK_SZ, "READ CAPACITY data");
+    // Windows asks 252 bytes of format capacities
+    R = Cmd10(SCSI_READ_FORMAT_CAPACITIES, 0, 252, BOT_DIR_IN, B, 252);
+    HOST_CHECK(R.Status == SCSI_STATUS_OK and R.Moved == 12 and R.Residue == 240, "READ FORMAT CAPACITIES: %u %u", R.Moved, R.Residue);
+    HOST_CHECK(B[3] == 8 and Convert::BuildUint32(B[7], B[6], B[5], B[4]) == MSD_BLOCK_CNT, "READ FORMAT CAPACITIES data");
+    R = Cmd6(SCSI_CMD_MODE_SENSE_6, 0, SCSI_MODE_PAGE_ALL, 192, BOT_DIR_IN, B, 192);
+    HOST_CHECK(R.Status == SCSI_STATUS_OK and R.Moved == B[0] + 1U, "MODE SENSE all pages");
+    R = Cmd6(SCSI_CMD_MODE_SENSE_6, 0, SCSI_MODE_PAGE_CACHING, 192, BOT_DIR_IN, B, 192);
+    HOST_CHECK(R.Status == SCSI_STATUS_OK and R.Moved == B[0] + 1U, "MODE SENSE caching page");
+    CheckOk(Cmd6(SCSI_CMD_PREVENT_ALLOW_MEDIUM_REMOVAL, 0, 0, 1, BOT_DIR_OUT, nullptr, 0), "PREVENT ALLOW");
+    CheckSense(SCSI_SENSE_KEY_GOOD, SCSI_ASENSE_NO_ADDITIONAL_INFORMATION, "after mount");
+}
+
+// Device sends less than asked: residue tells the rest
+static void TestResidue() {
+    uint8_t B[255];
+    BotRslt_t R = Cmd6(SCSI_CMD_INQUIRY, 0, 0, 255, BOT_DIR_IN, B, 255);
+    HOST_CHECK(R.Status == SCSI_STATUS_OK and R.Moved == 36 and R.Residue == 255 - 36, "INQUIRY 255: %u %u", R.Moved, R.Residue);
+    R = Cmd6(SCSI_CMD_REQUEST_SENSE, 0, 0, 252, BOT_DIR_IN, B, 252);
+    HOST_CHECK(R.Status == SCSI_STATUS_OK and R.Moved == 18 and R.Residue == 252 - 18, "REQUEST SENSE 252: %u %u", R.Moved, R.Residue);
+    // Transfer length does not match blocks: rejected before data phase
+    R = Cmd10(SCSI_CMD_READ_10, 0, 1, BOT_DIR_IN, IBuf, 2 * MSD_BLOCK_SZ);
+    HOST_CHECK(R.Status == SCSI_STATUS_CHECK_CONDITION and R.PhaseSkipped and R.Residue == 2 * MSD_BLOCK_SZ, "READ length mismatch");
+    CheckSense(SCSI_SENSE_KEY_ILLEGAL_REQUEST, SCSI_ASENSE_INVALID_COMMAND, "READ length mismatch");
+    R = Read10(MSD_BLOCK_CNT - 1, 2, IBuf);
+    HOST_CHECK(R.Status == SCSI_STATUS_CHECK_CONDITION and R.PhaseSkipped and R.Residue == 2 * MSD_BLOCK_SZ, "READ out of range");
+    CheckSense(SCSI_SENSE_KEY_ILLEGAL_REQUEST, SCSI_ASENSE_LOGICAL_BLOCK_ADDRESS_OUT_OF_RANGE, "READ out of range");
+    // Unknown command
+    R = Cmd6(SCSI_CMD_READ_6, 0, 0, 1, BOT_DIR_OUT, nullptr, 0);
+    HOST_CHECK(R.Status == SCSI_STATUS_CHECK_CONDITION and R.Residue == 0, "READ(6)");
+    CheckSense(SCSI_SENSE_KEY_ILLEGAL_REQUEST, SCSI_ASENSE_INVALID_COMMAND, "READ(6)");
+    Printf("Residue: ok\r");
+}
+
+// Caching page comes with WCE set, alone or within all pages
+static void TestModeSense() {
+    uint8_t B[192];
+    for(uint8_t Page : {SCSI_MODE_PAGE_CACHING, SCSI_MODE_PAGE_ALL}) {
+        memset(B, 0xA5, sizeof(B));
+        BotRslt_t R = Cmd6(SCSI_CMD_MODE_SENSE_6, 0, Page, 192, BOT_DIR_IN, B, 192);
+        HOST_CHECK(R.Status == SCSI_STATUS_OK and R.Moved == MODE_SENSE6_HDR_SZ + MODE_SENSE6_CACHING_PAGE_SZ and
+                R.Residue == 192 - R.Moved, "MODE SENSE %02X: %u %u", Page, R.Moved, R.Residue);
+        HOST_CHECK(B[0] == R.Moved - 1 and B[3] == 0, "MODE SENSE %02X: header %02X %02X", Page, B[0], B[3]);
+        HOST_CHECK(B[4] == SCSI_MODE_PAGE_CACHING and B[5] == MODE_SENSE6_CACHING_PAGE_SZ - 2, "MODE SENSE %02X: page %02X %02X", Page, B[4], B[5]);
+        HOST_CHECK((bool)(B[6] & 0x04) == (bool)MSD_WRITE_CACHE_EN, "MODE SENSE %02X: WCE %u", Page, B[6] & 0x04);
+        // Short allocation length: data is cut, length byte tells the whole
+        R = Cmd6(SCSI_CMD_MODE_SENSE_6, 0, Page, 4, BOT_DIR_IN, B, 4);
+        HOST_CHECK(R.Status == SCSI_STATUS_OK and R.Moved == 4 and R.Residue == 0 and B[0] == MODE_SENSE6_HDR_SZ + MODE_SENSE6_CACHING_PAGE_SZ - 1,
+                "MODE SENSE %02X, 4 bytes: %u %u %u", Page, R.Moved, R.Residue, B[0]);
+    }
+    // Other pages are not supported: header only
+    BotRslt_t R = Cmd6(SCSI_CMD_MODE_SENSE_6, 0, 0x1C, 192, BOT_DIR_IN, B, 192);
+    HOST_CHECK(R.Status == SCSI_STATUS_OK and R.Moved == MODE_SENSE6_HDR_SZ and B[0] == MODE_SENSE6_HDR_SZ - 1, "MODE SENSE 1C: %u", R.Moved);
+    Printf("Mode sense: ok\r");
+}
+
+// Rejected WRITE(10) must take its data anyway, or the stream is out of sync
+static void TestRejectedWrite() {
+    Fill(IBuf, 2 * MSD_BLOCK_SZ, 1);
+    BotRslt_t R = Write10(MSD_BLOCK_CNT - 1, 2, IBuf);
+    HOST_CHECK(R.Status == SCSI_STATUS_CHECK_CONDITION and R.Residue == 2 * MSD_BLOCK_SZ and R.Undrained == 0,
+            "WRITE out of range: status %u, residue %u, undrained %u", R.Status, R.Residue, R.Undrained);
+    CheckSense(SCSI_SENSE_KEY_ILLEGAL_REQUEST, SCSI_ASENSE_LOGICAL_BLOCK_ADDRESS_OUT_OF_RANGE, "WRITE out of range");
+    R = Cmd10(SCSI_CMD_WRITE_10, 4, 1, BOT_DIR_OUT, IBuf, 2 * MSD_BLOCK_SZ);
+    HOST_CHECK(R.Status == SCSI_STATUS_CHECK_CONDITION and R.Residue == 2 * MSD_BLOCK_SZ and R.Undrained == 0,
+            "WRITE length mismatch: status %u, residue %u, undrained %u", R.Status, R.Residue, R.Undrained);
+    CheckSense(SCSI_SENSE_KEY_ILLEGAL_REQUEST, SCSI_ASENSE_INVALID_COMMAND, "WRITE length mismatch");
+    // MODE SELECT(6) is not supported, its parameter list is drained too
+    R = Cmd6(0x15, 0x10, 0, 12, BOT_DIR_OUT, IBuf, 12);
+    HOST_CHECK(R.Status == SCSI_STATUS_CHECK_CONDITION and R.Residue == 12 and R.Undrained == 0,
+            "MODE SELECT: status %u, residue %u, undrained %u", R.Status, R.Residue, R.Undrained);
+    CheckSense(SCSI_SENSE_KEY_ILLEGAL_REQUEST, SCSI_ASENSE_INVALID_COMMAND, "MODE SELECT");
+    // Nothing is written, and next commands are fine
+    CheckOk(Read10(4, 1, IBuf2), "READ after rejected write");
+    HOST_CHECK(memcmp(IBuf2, IBuf, MSD_BLOCK_SZ) != 0, "rejected data is written");
+    CheckOk(TestUnitReady(), "TEST UNIT READY after rejected write");
+    Printf("Rejected write: ok\r");
+}
+
+/* Flash fails while cached blocks are evicted in the middle of WRITE(10):
+ * the rest of data is drained, status is MEDIUM ERROR, residue is what was
+ * not processed. Failed blocks stay cached and get out after flash recovers. */
+static void TestWriteFault() {
+    CheckOk(SyncCache(), "SYNC CACHE");
+    FailStorage(true);
+    const uint32_t Cnt = 2 * MSD_CACHE_LINE_CNT;
+    Fill(IBuf, Cnt * MSD_BLOCK_SZ, 2);
+    BotRslt_t R = Write10(8, Cnt, IBuf);
+    // Cache takes first line count of blocks, in chunks of data buffer
+    uint32_t Taken = MSD_CACHE_LINE_CNT * MSD_BLOCK_SZ;
+    HOST_CHECK(R.Status == SCSI_STATUS_CHECK_CONDITION and R.Residue == Cnt * MSD_BLOCK_SZ - Taken and R.Undrained == 0,
+            "WRITE with flash failing: status %u, residue %u, undrained %u", R.Status, R.Residue, R.Undrained);
+    CheckSense(SCSI_SENSE_KEY_MEDIUM_ERROR, SCSI_ASENSE_WRITE_FAULT, "WRITE with flash failing");
+    CheckOk(TestUnitReady(), "TEST UNIT READY after write fault");
+    R = SyncCache();
+    HOST_CHECK(R.Status == SCSI_STATUS_CHECK_CONDITION, "SYNC CACHE with flash failing");
+    CheckSense(SCSI_SENSE_KEY_MEDIUM_ERROR, SCSI_ASENSE_WRITE_FAULT, "SYNC CACHE with flash failing");
+    FailStorage(false);
+    CheckOk(SyncCache(), "SYNC CACHE after flash recovered");
+    StorageRead(8, MSD_CACHE_LINE_CNT, IBuf2);
+    HOST_CHECK(memcmp(IBuf, IBuf2, Taken) == 0, "cached blocks are lost");
+    Printf("Write fault: ok\r");
+}
+
+// Idle flush fails: next command without data reports it
+static void TestDeferredFault() {
+    Fill(IBuf, MSD_BLOCK_SZ, 3);
+    CheckOk(Write10(30, 1, IBuf), "WRITE");
+    FailStorage(true);
+    chThdSleepMilliseconds(MSD_CACHE_IDLE_FLUSH_MS + 500);
+    // Reads have data phase: not a place to report it
+    CheckOk(Read10(30, 1, IBuf2), "READ after failed idle flush");
+    HOST_CHECK(memcmp(IBuf, IBuf2, MSD_BLOCK_SZ) == 0, "cached block is not read");
+    BotRslt_t R = TestUnitReady();
+    HOST_CHECK(R.Status == SCSI_STATUS_CHECK_CONDITION and R.Residue == 0, "deferred error is not reported");
+    CheckSense(SCSI_SENSE_KEY_MEDIUM_ERROR, SCSI_ASENSE_WRITE_FAULT, "deferred error");
+    CheckOk(TestUnitReady(), "TEST UNIT READY after deferred error");
+    FailStorage(false);
+    CheckOk(SyncCache(), "SYNC CACHE after flash recovered");
+    StorageRead(30, 1, IBuf2);
+    HOST_CHECK(memcmp(IBuf, IBuf2, MSD_BLOCK_SZ) == 0, "cached block is lost");
+    Printf("Deferred write fault: ok\r");
+}
+
+// Eject flushes the cache: failure is reported by its status, as SYNC CACHE does
+static void TestEjectFault() {
+    Fill(IBuf, MSD_BLOCK_SZ, 7);
+    CheckOk(Write10(29, 1, IBuf), "WRITE");
+    FailStorage(true);
+    BotRslt_t R = Cmd6(SCSI_CMD_START_STOP_UNIT, 0, 0, 0x02, BOT_DIR_OUT, nullptr, 0);
+    HOST_CHECK(R.Status == SCSI_STATUS_CHECK_CONDITION, "eject with flash failing");
+    CheckSense(SCSI_SENSE_KEY_MEDIUM_ERROR, SCSI_ASENSE_WRITE_FAULT, "eject with flash failing");
+    FailStorage(false);
+    CheckOk(Cmd6(SCSI_CMD_START_STOP_UNIT, 0, 0, 0x03, BOT_DIR_OUT, nullptr, 0), "load");
+    CheckOk(SyncCache(), "SYNC CACHE after flash recovered");
+    StorageRead(29, 1, IBuf2);
+    HOST_CHECK(memcmp(IBuf, IBuf2, MSD_BLOCK_SZ) == 0, "cached block is lost");
+    Printf("Eject write fault: ok\r");
+}
+
+/* Host takes no IN data: device gives up the command after timeout and sends
+ * no status over the busy endpoint, nor data of next command; bus reset of
+ * reset recovery brings it back. */
+static void TestInTimeout() {
+    uint8_t Cdb[10] = {SCSI_CMD_READ_10, 0, 0, 0, 0, 0, 0, 0, 8, 0};
+    SendCbw(Cdb, 10, BOT_DIR_IN, 8 * MSD_BLOCK_SZ);
+    chThdSleepMilliseconds(MSD_TIMEOUT_MS + 100);
+    HOST_CHECK(InIsPending(), "READ data is not on endpoint");
+    uint8_t Inq[6] = {SCSI_CMD_INQUIRY, 0, 0, 0, 36, 0};
+    SendCbw(Inq, 6, BOT_DIR_IN, 36);
+    chThdSleepMilliseconds(100);
+    Attach();
+    CheckOk(TestUnitReady(), "TEST UNIT READY after reset");
+    CheckOk(Read10(0, 8, IBuf2), "READ after reset");
+    Printf("IN timeout: ok\r");
+}
+
+// Cached data gets to flash on suspend and on disconnect
+static void TestSuspendDisconnect() {
+    Fill(IBuf, MSD_BLOCK_SZ, 4);
+    CheckOk(Write10(31, 1, IBuf), "WRITE");
+    HOST_CHECK(MsdCache.IsDirty(), "block is not cached");
+    Suspend();
+    HOST_CHECK(HostOs::WaitFor([]() { return !MsdCache.IsDirty(); }, TIME_MS2I(MSD_CACHE_IDLE_FLUSH_MS / 2)), "no flush on suspend");
+    StorageRead(31, 1, IBuf2);
+    HOST_CHECK(memcmp(IBuf, IBuf2, MSD_BLOCK_SZ) == 0, "suspend: block is not written");
+    Resume();
+    Fill(IBuf, MSD_BLOCK_SZ, 5);
+    CheckOk(Write10(31, 1, IBuf), "WRITE after resume");
+    UsbMsd.Disconnect();
+    StorageRead(31, 1, IBuf2);
+    HOST_CHECK(memcmp(IBuf, IBuf2, MSD_BLOCK_SZ) == 0, "disconnect: block is not written");
+    UsbMsd.Connect();
+    Attach();
+    CheckOk(TestUnitReady(), "TEST UNIT READY after reconnect");
+    Printf("Suspend and disconnect: ok\r");
+}
+
+// PC formats the disk, copies the file, and checks it after remount
+static void CopyFile() {
+    uint8_t *S = IBuf2;
+    Fat12Boot(S, MSD_BLOCK_SZ, MSD_BLOCK_CNT);
+    CheckOk(Write10(0, 1, S), "WRITE boot sector");
+    Fat12Fat(S, MSD_BLOCK_SZ);
+    CheckOk(Write10(FAT12_SECTOR_FAT1, 1, S), "WRITE FAT");
+    CheckOk(Write10(FAT12_SECTOR_FAT2, 1, S), "WRITE FAT");
+    memset(S, 0, MSD_BLOCK_SZ);
+    CheckOk(Write10(FAT12_SECTOR_ROOT, 1, S), "WRITE root dir");
+
+    HOST_CHECK(f_mount(&PcFs, "", 1) == FR_OK, "mount");
+    Fill(IBuf, FILE_SZ, 6);
+    UINT N;
+    HOST_CHECK(f_open(&PcFile, "copy.bin", FA_CREATE_ALWAYS | FA_WRITE) == FR_OK, "open for write");
+    HOST_CHECK(f_write(&PcFile, IBuf, FILE_SZ, &N) == FR_OK and N == FILE_SZ, "write");
+    HOST_CHECK(f_close(&PcFile) == FR_OK, "close");
+    f_mount(nullptr, "", 0);
+    CheckOk(SyncCache(), "SYNC CACHE");
+
+    // fsck: new mount reads it all back
+    HOST_CHECK(f_mount(&PcFs, "", 1) == FR_OK, "remount");
+    HOST_CHECK(f_open(&PcFile, "copy.bin", FA_READ) == FR_OK, "open for read");
+    HOST_CHECK(f_size(&PcFile) == FILE_SZ, "file size %u", (uint32_t)f_size(&PcFile));
+    HOST_CHECK(f_read(&PcFile, IBuf2, FILE_SZ, &N) == FR_OK and N == FILE_SZ, "read");
+    HOST_CHECK(memcmp(IBuf, IBuf2, FILE_SZ) == 0, "file data differ");
+    f_close(&PcFile);
+    f_mount(nullptr, "", 0);
+    // Whole disk as PC sees it is what is in flash
+    static uint8_t Disk[DISK_SZ];
+    for(uint32_t Lba=0; Lba<MSD_BLOCK_CNT; Lba += 16) {
+        uint32_t Cnt = MIN_(16UL, MSD_BLOCK_CNT - Lba);
+        CheckOk(Read10(Lba, Cnt, &Disk[Lba * MSD_BLOCK_SZ]), "READ disk");
+    }
+    StorageRead(0, MSD_BLOCK_CNT, IBuf2);
+    HOST_CHECK(memcmp(Disk, IBuf2, DISK_SZ) == 0, "disk read differs from flash");
+}
+
+/* Stream of the copy is recorded, then replayed on erased flash. Same
+ * session is captured as usbmon pcap: make test converts it with
+ * Tools/usbcap2stream.py and replays, as it is done with real capture. */
+static void TestRecordReplay(const char *Dir) {
+    std::string Fname = std::string(Dir) + "/" STREAM_FNAME;
+    std::string CapName = std::string(Dir) + "/" CAPTURE_FNAME;
+    FILE *F = fopen(Fname.c_str(), "w+b");
+    HOST_CHECK(F != nullptr, "cannot create %s", Fname.c_str());
+    FILE *PCap = fopen(CapName.c_str(), "wb");
+    HOST_CHECK(PCap != nullptr, "cannot create %s", CapName.c_str());
+    PowerOff();
+    PowerOn();
+    UsbMsd.Stat.Reset();
+    StatReset();
+    uint64_t Start = HostOs::Now();
+    Record(F);
+    Capture(PCap);
+    MountSequence();
+    CopyFile();
+    Record(nullptr);
+    Capture(nullptr);
+    fclose(PCap);
+    Printf("Mount, format, 64 KB copy and check: %u ms\r", (uint32_t)((HostOs::Now() - Start) / 1000));
+    StatPrint();
+    chThdSleepMilliseconds(1); // Device counts last command after its CSW
+    Printf("Device side:\r");
+    ShellCmds::Run(&Shell, "MsdStat");
+    std::vector<uint8_t> Image(DISK_SZ);
+    StorageRead(0, MSD_BLOCK_CNT, Image.data());
+
+    PowerOff();
+    PowerOn();
+    rewind(F);
+    uint32_t Cnt = Replay(F);
+    fclose(F);
+    CheckOk(SyncCache(), "SYNC CACHE after replay");
+    StorageRead(0, MSD_BLOCK_CNT, IBuf2);
+    HOST_CHECK(memcmp(Image.data(), IBuf2, DISK_SZ) == 0, "replay image differs");
+    Printf("Record and replay: %u commands, ok\r", Cnt);
+}
+#endif
+
+int main(int argc, char **argv) {
+    HostOs::Init();
+    NorFlash::Init();
+    Printf("SCSI over USB host model, %u KB disk, %S\r", DISK_SZ / 1024, MSD_USE_FTL? "FTL" : "in-place update");
+    UsbMsd.Init();
+    PowerOn();
+    if(argc == 3 and strcmp(argv[1], "replay") == 0) {
+        FILE *F = fopen(argv[2], "rb");
+        HOST_CHECK(F != nullptr, "cannot open %s", argv[2]);
+        Printf("Replayed %u commands\r", Replay(F));
+        fclose(F);
+        StatPrint();
+        return 0;
+    }
+    MountSequence();
+    Printf("Mount sequence: ok\r");
+    TestResidue();
+    TestModeSense();
+    TestRejectedWrite();
+    TestWriteFault();
+    TestDeferredFault();
+    TestEjectFault();
+    TestInTimeout();
+    TestSuspendDisconnect();
+    TestRecordReplay(argc == 2? argv[1] : BUILD_DIR);
+    HOST_CHECK(NorFlash::Stat.Violations == 0, "%u programs over non-erased flash", NorFlash::Stat.Violations);
+    return 0;
+}
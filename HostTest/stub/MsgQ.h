@@ -0,0 +1,34 @@
+/*
+ * MsgQ.h
+ *
+ *  Created on: 19 10 2026
+ *      Author: agent
+ */
+
+#pragma once
+
+#include "ch.h"
+#include "kl_lib.h"
+
+#define MAIN_EVT_Q_LEN      18  // Messages in queue
+
+// Main thread is not modelled: the queue keeps last message and a counter
+struct EvtMsg_t {
+    uint8_t ID;
+    EvtMsg_t() : ID(0) {}
+    EvtMsg_t(uint8_t AID) : ID(AID) {}
+};
+
+template<typename T, uint32_t Sz>
+class EvtMsgQ_t {
+public:
+    T Last;
+    uint32_t Cnt = 0;
+    uint8_t SendNowOrExitI(const T &Msg) {
+        Last = Msg;
+        Cnt++;
+        return retvOk;
+    }
+};
+
+extern EvtMsgQ_t<EvtMsg_t, MAIN_EVT_Q_LEN> EvtQMain;
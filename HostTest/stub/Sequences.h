@@ -0,0 +1,14 @@
+/*
+ * Sequences.h
+ *
+ *  Created on: 19 10 2026
+ *      Author: agent
+ */
+
+#pragma once
+
+#include "led.h"
+
+// Bootloader sequences, see led.h
+const BaseChunk_t lsqWriting[] = {{false}};
+const BaseChunk_t lsqError[] = {{true}};
@@ -0,0 +1,30 @@
+/*
+ * board.h
+ *
+ *  Created on: 19 10 2026
+ *      Author: agent
+ */
+
+#pragma once
+
+#define APP_NAME            "LedTree host"
+#include "stm32_registry.h"
+
+// USB pins are not modelled, see PinSetupAlterFunc in kl_lib.h
+#define USB_DM              GPIOA, 11
+#define USB_DP              GPIOA, 12
+#define USB_AF              AF10
+
+// Bootloader: LED and UART are not modelled, see led.h and uart.h
+#define LED_PIN             0, 0
+#define CMD_UART_PARAMS     0
+#define CRC_DMA             0
+#define CRC_DMA_MODE        0
+
+// Shared by bootloader and app: keep the same as in both board.h
+#define BKPREG_FW_PENDING       0   // FW_PENDING_MAGIC: app has found firmware file on disk
+#define BKPREG_BOOT_US          1   // Time from reset to jump to app, us; written by bootloader
+#define BKPREG_DELTA_ID         2   // Delta being applied in place, see FlashDelta in bootloader
+#define BKPREG_DELTA_DONE       3   // Offset of the first page not written yet by that delta
+#define BKPREG_DISK_PAGE        4   // Disk page held by scratch page, see WriteDiskPage in bootloader
+#define FW_PENDING_MAGIC        0x46575550UL
@@ -0,0 +1,127 @@
+/*
+ * ch.h
+ *
+ *  Created on: 19 10 2026
+ *      Author: agent
+ */
+
+#pragma once
+
+/* Host stand-in for the part of ChibiOS used by MSD, FTL and FatFs glue.
+ * Time is virtual: it runs only when flash or USB model says that operation
+ * takes time, see HostOs.h. Threads are host threads taking turns under one
+ * kernel lock, so system lock itself does nothing. */
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <string.h>
+
+#ifndef FALSE
+#define FALSE   0
+#endif
+#ifndef TRUE
+#define TRUE    1
+#endif
+
+#ifndef __unused
+#define __unused        __attribute__((unused))
+#endif
+#define __noreturn      __attribute__((noreturn))
+
+#define CH_CFG_ST_FREQUENCY     1000000UL   // Virtual tick is 1 us
+#define CH_DBG_TRACE_MASK_DISABLED  0
+#define CH_DBG_TRACE_MASK       CH_DBG_TRACE_MASK_DISABLED
+
+typedef uint32_t systime_t;
+typedef uint32_t sysinterval_t;
+typedef uint32_t eventmask_t;
+typedef int32_t msg_t;
+typedef uint32_t tprio_t;
+typedef void (*tfunc_t)(void *p);
+
+#define TIME_IMMEDIATE      ((sysinterval_t)0)
+#define TIME_INFINITE       ((sysinterval_t)-1)
+#define TIME_MS2I(ms)       ((sysinterval_t)((ms) * 1000UL))
+#define TIME_US2I(us)       ((sysinterval_t)(us))
+#define TIME_I2MS(i)        ((uint32_t)((i) / 1000UL))
+#define TIME_I2US(i)        ((uint32_t)(i))
+#define MS2ST(ms)           TIME_MS2I(ms)
+
+#define EVENT_MASK(eid)     ((eventmask_t)1 << (eventmask_t)(eid))
+#define ALL_EVENTS          ((eventmask_t)-1)
+
+#define MSG_OK              ((msg_t)0)
+#define MSG_TIMEOUT         ((msg_t)-1)
+#define MSG_RESET           ((msg_t)-2)
+
+#define LOWPRIO             2
+#define NORMALPRIO          128
+#define HIGHPRIO            255
+
+#define CH_STATE_READY      0
+#define CH_STATE_CURRENT    1
+#define CH_STATE_SUSPENDED  3
+#define CH_STATE_FINAL      15
+
+#define THD_WORKING_AREA(s, n)  uint8_t s[(n)]
+#define THD_FUNCTION(tname, arg) void tname(void *arg)
+
+typedef struct {
+    uint32_t state;
+    eventmask_t epending;
+    tfunc_t func;
+    void *arg;
+} thread_t;
+
+typedef struct {
+    volatile int32_t cnt;
+} semaphore_t;
+
+typedef struct {
+    semaphore_t sem;
+} binary_semaphore_t;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+// System lock and time
+void chSysLock(void);
+void chSysUnlock(void);
+#define chSysLockFromISR()      chSysLock()
+#define chSysUnlockFromISR()    chSysUnlock()
+void chSchRescheduleS(void);
+systime_t chVTGetSystemTimeX(void);
+#define chVTGetSystemTime()     chVTGetSystemTimeX()
+#define chVTTimeElapsedSinceX(start)    ((sysinterval_t)(chVTGetSystemTimeX() - (start)))
+
+// Threads
+thread_t *chThdCreateStatic(void *wsp, size_t size, tprio_t prio, tfunc_t pf, void *arg);
+thread_t *chThdGetSelfX(void);
+#define chRegSetThreadName(name)    (void)(name)
+void chThdSleep(sysinterval_t time);
+#define chThdSleepMilliseconds(ms)  chThdSleep(TIME_MS2I(ms))
+#define chThdSleepMicroseconds(us)  chThdSleep(TIME_US2I(us))
+void chThdYield(void);
+void chSchReadyI(thread_t *tp);
+
+// Events
+void chEvtSignal(thread_t *tp, eventmask_t events);
+void chEvtSignalI(thread_t *tp, eventmask_t events);
+eventmask_t chEvtWaitAnyTimeout(eventmask_t events, sysinterval_t timeout);
+#define chEvtWaitAny(events)    chEvtWaitAnyTimeout((events), TIME_INFINITE)
+
+// Semaphores
+void chSemObjectInit(semaphore_t *sp, int32_t n);
+msg_t chSemWaitTimeout(semaphore_t *sp, sysinterval_t timeout);
+#define chSemWait(sp)           chSemWaitTimeout((sp), TIME_INFINITE)
+void chSemSignal(semaphore_t *sp);
+void chBSemObjectInit(binary_semaphore_t *bsp, bool taken);
+msg_t chBSemWaitTimeout(binary_semaphore_t *bsp, sysinterval_t timeout);
+#define chBSemWait(bsp)         chBSemWaitTimeout((bsp), TIME_INFINITE)
+void chBSemSignal(binary_semaphore_t *bsp);
+#define chBSemSignalI(bsp)      chBSemSignal(bsp)
+void chBSemReset(binary_semaphore_t *bsp, bool taken);
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,15 @@
+/*
+ * color.h
+ *
+ *  Created on: 19 10 2026
+ *      Author: agent
+ */
+
+#pragma once
+
+#include <stdint.h>
+
+// Only what ini::ReadColor fills
+struct Color_t {
+    uint8_t R, G, B, Brt;
+};
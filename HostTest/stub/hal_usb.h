@@ -0,0 +1,108 @@
+/*
+ * hal_usb.h
+ *
+ *  Created on: 19 10 2026
+ *      Author: agent
+ */
+
+#pragma once
+
+/* Host stand-in for ChibiOS USB driver API used by usb_msd.cpp. Transfers
+ * complete into host-side buffers of UsbMock, which plays the USB host:
+ * see UsbMock.h. Callbacks are called from host thread, as from ISR. */
+
+#include "ch.h"
+
+#define USB_MAX_ENDPOINTS       4
+#define USB_EP_MODE_TYPE_CTRL   0
+#define USB_EP_MODE_TYPE_BULK   2
+
+typedef uint8_t usbep_t;
+
+typedef enum {
+    USB_EVENT_RESET = 0,
+    USB_EVENT_ADDRESS = 1,
+    USB_EVENT_CONFIGURED = 2,
+    USB_EVENT_UNCONFIGURED = 3,
+    USB_EVENT_SUSPEND = 4,
+    USB_EVENT_WAKEUP = 5,
+    USB_EVENT_STALLED = 6
+} usbevent_t;
+
+typedef enum {
+    USB_UNINIT = 0, USB_STOP = 1, USB_READY = 2, USB_SELECTED = 3, USB_ACTIVE = 4, USB_SUSPENDED = 5
+} usbstate_t;
+
+typedef struct USBDriver USBDriver;
+typedef void (*usbcallback_t)(USBDriver *usbp);
+typedef void (*usbepcallback_t)(USBDriver *usbp, usbep_t ep);
+typedef void (*usbeventcb_t)(USBDriver *usbp, usbevent_t event);
+typedef bool (*usbreqhandler_t)(USBDriver *usbp);
+
+typedef struct {
+    size_t ud_size;
+    const uint8_t *ud_string;
+} USBDescriptor;
+typedef const USBDescriptor* (*usbgetdescriptor_t)(USBDriver *usbp, uint8_t dtype, uint8_t dindex, uint16_t lang);
+
+typedef struct {
+    usbeventcb_t event_cb;
+    usbgetdescriptor_t get_descriptor_cb;
+    usbreqhandler_t requests_hook_cb;
+    usbcallback_t sof_cb;
+} USBConfig;
+
+typedef struct {
+    size_t txsize, txcnt;
+} USBInEndpointState;
+typedef struct {
+    size_t rxsize, rxcnt;
+} USBOutEndpointState;
+
+typedef struct {
+    uint32_t ep_mode;
+    usbepcallback_t setup_cb;
+    usbepcallback_t in_cb;
+    usbepcallback_t out_cb;
+    uint16_t in_maxsize;
+    uint16_t out_maxsize;
+    USBInEndpointState *in_state;
+    USBOutEndpointState *out_state;
+    uint16_t in_multiplier;
+    uint8_t *setup_buf;
+} USBEndpointConfig;
+
+struct USBDriver {
+    usbstate_t state;
+    const USBConfig *config;
+    const USBEndpointConfig *epc[USB_MAX_ENDPOINTS];
+    uint16_t transmitting;
+    uint8_t setup[8];
+    uint8_t *ep0next;
+    size_t ep0n;
+    usbcallback_t ep0endcb;
+};
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+extern USBDriver USBD1;
+void usbInit(void);
+void usbStart(USBDriver *usbp, const USBConfig *config);
+void usbStop(USBDriver *usbp);
+void usbConnectBus(USBDriver *usbp);
+void usbDisconnectBus(USBDriver *usbp);
+void usbInitEndpointI(USBDriver *usbp, usbep_t ep, const USBEndpointConfig *epcp);
+void usbStartReceiveI(USBDriver *usbp, usbep_t ep, uint8_t *buf, size_t n);
+void usbStartTransmitI(USBDriver *usbp, usbep_t ep, const uint8_t *buf, size_t n);
+#ifdef __cplusplus
+}
+#endif
+
+#define usbGetDriverStateI(usbp)    ((usbp)->state)
+#define usbGetTransmitStatusI(usbp, ep) (((usbp)->transmitting & (1U << (ep))) != 0)
+#define usbSetupTransfer(usbp, buf, n, endcb) { \
+    (usbp)->ep0next = (buf);                    \
+    (usbp)->ep0n = (n);                         \
+    (usbp)->ep0endcb = (endcb);                 \
+}
@@ -0,0 +1,25 @@
+/*
+ * integer.h
+ *
+ *  Created on: 19 10 2026
+ *      Author: agent
+ */
+
+#pragma once
+
+/* FatFs integer types for LP64 hosts, forced in before Filesys/integer.h:
+ * there long is 64-bit, and FatFs needs DWORD of 32 bits. UINT matches
+ * uint32_t, as it does on target, where both are unsigned long. */
+
+#define _FF_INTEGER
+#include <stdint.h>
+
+typedef int             INT;
+typedef unsigned int    UINT;
+typedef unsigned char   BYTE;
+typedef short           SHORT;
+typedef unsigned short  WORD;
+typedef unsigned short  WCHAR;
+typedef int32_t         LONG;
+typedef uint32_t        DWORD;
+typedef unsigned long long QWORD;
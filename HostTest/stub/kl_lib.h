@@ -0,0 +1,143 @@
+/*
+ * kl_lib.h
+ *
+ *  Created on: 19 10 2026
+ *      Author: agent
+ */
+
+#pragma once
+
+/* Host subset of kl_lib.h: return codes, helpers and Flash interface.
+ * Flash functions are implemented by NOR flash model, see NorFlash.h. */
+
+#include "ch.h"
+#include "hal.h"
+#include "board.h"
+#include "stm32_registry.h"
+#include <stdlib.h>
+
+#define STRINGIFY(x)    # x
+#define XSTRINGIFY(x)   STRINGIFY(x)
+
+// Return values
+#define retvOk              0
+#define retvFail            1
+#define retvTimeout         2
+#define retvBusy            3
+#define retvInProgress      4
+#define retvCmdError        5
+#define retvCmdUnknown      6
+#define retvBadValue        7
+#define retvNew             8
+#define retvSame            9
+#define retvLast            10
+#define retvEmpty           11
+#define retvOverflow        12
+#define retvNotANumber      13
+#define retvWriteProtect    14
+#define retvWriteError      15
+#define retvEndOfFile       16
+#define retvNotFound        17
+#define retvBadState        18
+#define retvDisconnected    19
+#define retvCollision       20
+#define retvCRCError        21
+#define retvNACK            22
+#define retvNoAnswer        23
+#define retvOutOfMemory     24
+#define retvNotAuthorised   25
+#define retvNoChanges       26
+
+#define NOT_TAKEN       false
+#define TAKEN           true
+
+enum PinOutMode_t {omPushPull = 0, omOpenDrain = 1};
+
+// ==== Math ====
+#define MIN_(a, b)   ( ((a)<(b))? (a) : (b) )
+#define MAX_(a, b)   ( ((a)>(b))? (a) : (b) )
+#define ABS(a)      ( ((a) < 0)? -(a) : (a) )
+
+#define __REV(x)    __builtin_bswap32(x)
+#define __REV16(x)  __builtin_bswap16(x)
+
+// Reset ends the run of code under test, see HostExit_t in hal.h
+#define REBOOT()    throw hexReboot
+
+// Pins are not modelled
+#define PinSetupAlterFunc(...)  ((void)0)
+#define PinSetupAnalog(...)     ((void)0)
+
+namespace Convert {
+static inline uint16_t BuildUint16(uint8_t Lo, uint8_t Hi) {
+    return ((uint16_t)Hi << 8) | Lo;
+}
+static inline uint32_t BuildUint32(uint8_t Lo, uint8_t MidLo, uint8_t MidHi, uint8_t Hi) {
+    return ((uint32_t)Hi << 24) | ((uint32_t)MidHi << 16) | ((uint32_t)MidLo << 8) | Lo;
+}
+} // namespace
+
+namespace Random {
+static inline long int Generate(long int LowInclusive, long int HighInclusive) {
+    uint32_t last = random();
+    return (last % (HighInclusive + 1 - LowInclusive)) + LowInclusive;
+}
+static inline void Seed(unsigned int Seed) { srandom(Seed); }
+} // namespace
+
+// =========================== Flash and Option bytes ==========================
+#define FLASH_BASE              0x08000000UL
+namespace Flash {
+
+#define FLASH_PAGE_SZ_BYTES     2048UL
+
+void UnlockFlash();
+void LockFlash();
+
+void ClearPendingFlags();
+uint8_t ErasePage(uint32_t PageAddress);
+
+uint8_t ProgramBuf32(uint32_t Address, uint32_t *PData, int32_t ASzBytes);
+struct UpdateStat_t {
+    uint32_t Skipped, ProgramOnly, FullErase;
+};
+extern UpdateStat_t UpdateStat;
+uint8_t UpdatePage(uint32_t Address, uint32_t *PData, int32_t ASzBytes);
+uint8_t ReadChecked(void *PDst, uint32_t Addr, uint32_t Sz);
+void StartEccCheck();
+uint8_t EndEccCheck();
+bool PageNeedsErase(uint32_t Address, const uint32_t *PData, int32_t ASzBytes);
+
+// Model has single bank
+static inline bool DualbankIsEnabled() { return false; }
+static inline void DisableDualbank() {}
+
+} // namespace
+
+/* Backup registers are kept over power cut, as with VBAT supplied; reset of
+ * the backup domain is up to the test. */
+extern uint32_t *HostBkpReg;
+namespace BackupSpc {
+    static inline void EnableAccess() {}
+    static inline void DisableAccess() {}
+    static inline void Reset() { memset(HostBkpReg, 0, 32 * sizeof(uint32_t)); }
+    static inline uint32_t ReadRegister(uint32_t RegN) { return HostBkpReg[RegN]; }
+    static inline void WriteRegister(uint32_t RegN, uint32_t Data) { HostBkpReg[RegN] = Data; }
+} // namespace
+
+// ================================ Clock ======================================
+enum CoreClk_t {
+    cclk8MHz = 8, cclk12MHz = 12, cclk16MHz = 16,
+    cclk24MHz = 24, cclk48MHz = 48, cclk64MHz = 64,
+    cclk72MHz = 72, cclk80MHz = 80
+};
+
+// Frequencies are reported only
+class Clk_t {
+public:
+    uint32_t AHBFreqHz = 48000000;
+    void SetCoreClk(CoreClk_t CoreClk) { AHBFreqHz = (uint32_t)CoreClk * 1000000UL; }
+    void UpdateFreqValues() {}
+    void PrintFreqs() {}
+};
+extern Clk_t Clk;
@@ -0,0 +1,27 @@
+/*
+ * led.h
+ *
+ *  Created on: 19 10 2026
+ *      Author: agent
+ */
+
+#pragma once
+
+#include "kl_lib.h"
+#include "uart.h"
+
+// Sequences are not played: chunk only tells whether it is an error indication
+struct BaseChunk_t {
+    bool IsError;
+};
+
+// Error indication is followed by endless loop on target, so it ends the run
+class LedBlinker_t {
+public:
+    LedBlinker_t(int APGPIO, uint16_t APin, PinOutMode_t AOutputType) {}
+    void Init() {}
+    void On() {}
+    void Off() {}
+    void Stop() {}
+    void StartOrRestart(const BaseChunk_t *PChunk) { if(PChunk->IsError) throw hexHalt; }
+};
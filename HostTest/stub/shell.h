@@ -0,0 +1,26 @@
+/*
+ * shell.h
+ *
+ *  Created on: 19 10 2026
+ *      Author: agent
+ */
+
+#pragma once
+
+#include <cstring>
+#include <stdarg.h>
+#include "kl_lib.h"
+
+// Shell prints to stdout; it is the harness output, so it is never quiet
+class Shell_t {
+public:
+    void Print(const char *format, ...);
+    void Ack(uint8_t Result) { Print("Ack %u\r", Result); }
+};
+
+void Printf(const char *format, ...);
+void PrintfI(const char *format, ...);
+
+extern "C" {
+void PrintfC(const char *format, ...);
+}
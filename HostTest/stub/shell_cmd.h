@@ -0,0 +1,51 @@
+/*
+ * shell_cmd.h
+ *
+ *  Created on: 19 10 2026
+ *      Author: agent
+ */
+
+#pragma once
+
+#include "shell.h"
+
+/* Host subset of shell_cmd.h: SHELL_CMD registers the handler in a list,
+ * and the harness calls it by name. Arguments are not parsed. */
+
+#define SHELL_ARGS_MAX          6
+
+union ShellArg_t {
+    uint32_t u;
+    int32_t d;
+    const char *s;
+};
+
+struct ShellArgs_t {
+    uint32_t Cnt;
+    ShellArg_t V[SHELL_ARGS_MAX];
+    ShellArg_t& operator[](uint32_t Indx) { return V[Indx]; }
+};
+
+typedef void (*ftShellCmd)(Shell_t *PShell, ShellArgs_t &Args);
+
+struct ShellCmd_t {
+    uint32_t Hash;
+    const char *Name, *Schema;
+    ftShellCmd Handler;
+};
+
+class ShellCmdReg_t {
+public:
+    ShellCmdReg_t(const ShellCmd_t *PCmd);
+};
+
+#define SHELL_CMD(AName, ASchema) \
+    static void ShellCmd_##AName(Shell_t *PShell, ShellArgs_t &Args); \
+    static const ShellCmd_t ShellCmdDesc_##AName = {0, #AName, ASchema, ShellCmd_##AName}; \
+    static ShellCmdReg_t ShellCmdReg_##AName(&ShellCmdDesc_##AName); \
+    static void ShellCmd_##AName(__unused Shell_t *PShell, __unused ShellArgs_t &Args)
+
+namespace ShellCmds {
+// Calls registered command without arguments; retvCmdUnknown if there is none
+uint8_t Run(Shell_t *PShell, const char *Name);
+}
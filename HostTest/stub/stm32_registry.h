@@ -0,0 +1,16 @@
+/*
+ * stm32_registry.h
+ *
+ *  Created on: 19 10 2026
+ *      Author: agent
+ */
+
+#pragma once
+
+// Host build models STM32L476 inner flash
+#ifndef STM32L4XX
+#define STM32L4XX
+#endif
+#ifndef STM32L476xx
+#define STM32L476xx
+#endif
@@ -0,0 +1,22 @@
+/*
+ * uart.h
+ *
+ *  Created on: 19 10 2026
+ *      Author: agent
+ */
+
+#pragma once
+
+// Printf goes to stdout on host
+#include "shell.h"
+
+// Port is not modelled, see CMD_UART_PARAMS in board.h
+struct UartParams_t {
+    UartParams_t(uint32_t ABaudrate, int Params) {}
+};
+
+class CmdUart_t {
+public:
+    CmdUart_t(const UartParams_t *APParams) {}
+    void Init() {}
+};
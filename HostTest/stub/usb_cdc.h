@@ -0,0 +1,22 @@
+/*
+ * usb_cdc.h
+ *
+ *  Created on: 19 10 2026
+ *      Author: agent
+ */
+
+#pragma once
+
+#include "hal.h"
+
+// CDC function of composite device is not modelled: hooks do nothing
+class UsbCdc_t {
+public:
+    void OnConfiguredI(USBDriver *usbp) {}
+    void OnSuspendI() {}
+    void OnWakeupI() {}
+    void OnSofI() {}
+    bool OnSetupPkt(USBDriver *usbp) { return false; }
+};
+
+extern UsbCdc_t UsbCdc;
@@ -37,6 +37,7 @@ DRESULT disk_read (BYTE, BYTE*, DWORD, BYTE);
 DRESULT disk_write (BYTE, const BYTE*, DWORD, BYTE);
 #endif
 DRESULT disk_ioctl (BYTE, BYTE, void*);
+const void* disk_getptr (BYTE, DWORD);
 #ifdef __cplusplus
 }
 #endif
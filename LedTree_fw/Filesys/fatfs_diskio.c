@@ -51,6 +51,16 @@ DRESULT disk_read (
     return RES_OK;
 }
 
+/*-----------------------------------------------------------------------*/
+/* Get address of memory-mapped sector, NULL if not addressable          */
+const void* disk_getptr (
+    BYTE drv,        /* Physical drive nmuber (0..) */
+    DWORD sector     /* Sector address (LBA) */
+)
+{
+    return MSDGetPtr(sector);
+}
+
 /*-----------------------------------------------------------------------*/
 /* Write Sector(s)                                                       */
 static uint32_t IBuf[(FLASH_PAGE_SIZE / sizeof(uint32_t))];
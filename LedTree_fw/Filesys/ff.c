@@ -5203,6 +5203,52 @@ FRESULT f_forward (
 
 
 
+#if _USE_XIP
+/*-----------------------------------------------------------------------*/
+/* Get pointer to memory-mapped file data (execute/read in place)        */
+/*-----------------------------------------------------------------------*/
+
+FRESULT f_getptr (
+	FIL* fp,			/* Pointer to the file object */
+	const void** pptr	/* Pointer to variable to return the data address */
+)
+{
+	FRESULT res;
+	FATFS *fs;
+	DWORD clst, nxt, ncl;
+	const BYTE *ptr;
+
+
+	*pptr = 0;
+	res = validate(&fp->obj, &fs);		/* Check validity of the file object */
+	if (res != FR_OK || (res = (FRESULT)fp->err) != FR_OK) LEAVE_FF(fs, res);
+	if (fp->obj.objsize == 0 || fp->obj.sclust == 0) LEAVE_FF(fs, FR_DENIED);	/* Nothing to map */
+#if !_FS_READONLY && !_FS_TINY
+	if (fp->flag & FA_DIRTY) LEAVE_FF(fs, FR_DENIED);	/* Media contents are not up to date */
+#endif
+
+	/* Walk the cluster chain and check if it is contiguous */
+	ncl = (DWORD)((fp->obj.objsize - 1) / SS(fs) / fs->csize);	/* Number of clusters - 1 */
+	clst = fp->obj.sclust;
+	while (ncl--) {
+		nxt = get_fat(&fp->obj, clst);
+		if (nxt <= 1) ABORT(fs, FR_INT_ERR);
+		if (nxt == 0xFFFFFFFF) ABORT(fs, FR_DISK_ERR);
+		if (nxt != clst + 1) LEAVE_FF(fs, FR_DENIED);	/* Fragmented file */
+		clst = nxt;
+	}
+
+	/* Ask the disk layer where the first data sector is mapped */
+	ptr = (const BYTE*)disk_getptr(fs->drv, clust2sect(fs, fp->obj.sclust));
+	if (!ptr) LEAVE_FF(fs, FR_DENIED);	/* Media is not memory-mapped */
+	*pptr = ptr;
+
+	LEAVE_FF(fs, FR_OK);
+}
+#endif /* _USE_XIP */
+
+
+
 #if _USE_MKFS && !_FS_READONLY
 /*-----------------------------------------------------------------------*/
 /* Create FAT file system on the logical drive                           */
@@ -37,7 +37,7 @@
 /  2: Enable with LF-CRLF conversion. */
 
 
-#define _USE_FIND       0
+#define _USE_FIND       1
 /* This option switches filtered directory read functions, f_findfirst() and
 /  f_findnext(). (0:Disable, 1:Enable 2:Enable with matching altname[] too) */
 
@@ -68,6 +68,12 @@
 /* This option switches f_forward() function. (0:Disable or 1:Enable) */
 
 
+#define _USE_XIP        1
+/* This option switches f_getptr() function. It requires disk_getptr() in the disk
+/  I/O layer and returns the address of contiguous memory-mapped file data.
+/  (0:Disable or 1:Enable) */
+
+
 /*---------------------------------------------------------------------------/
 / Locale and Namespace Configurations
 /---------------------------------------------------------------------------*/
@@ -193,6 +193,35 @@ uint8_t CountDirsStartingWith(const char* Path, const char* DirNameStart, uint32
 }
 #endif
 
+#if 1 // ========================= Line source ===============================
+// File data in place if it is contiguous on memory-mapped media, f_gets otherwise
+static const char *PXipStart = nullptr, *PXip = nullptr, *PXipEnd = nullptr;
+static void IXipInit(FIL *PFile) {
+    PXipStart = nullptr;
+#if _USE_XIP
+    const void *Ptr;
+    if(f_getptr(PFile, &Ptr) == FR_OK) {
+        PXipStart = (const char*)Ptr;
+        PXipEnd = PXipStart + f_size(PFile);
+    }
+#endif
+    PXip = PXipStart;
+}
+
+static char* IGets(char *S, int Len, FIL *PFile) {
+    if(PXip == nullptr) return f_gets(S, Len, PFile);
+    if(PXip >= PXipEnd) return nullptr;
+    int n = 0;
+    while(n < Len-1 and PXip < PXipEnd) {
+        char c = *PXip++;
+        S[n++] = c;
+        if(c == '\n') break;
+    }
+    S[n] = '\0';
+    return S;
+}
+#endif
+
 namespace ini { // =================== ini file operations =====================
 void WriteSection(FIL *PFile, const char *ASection) {
     f_printf(PFile, "[%S]\r\n", ASection);
@@ -239,11 +268,12 @@ uint8_t ReadString(const char *AFileName, const char *ASection, const char *AKey
         Printf("Empty file\r");
         return retvFail;
     }
+    IXipInit(&CommonFile);
     // Move through file one line at a time until a section is matched or EOF.
     char *StartP, *EndP = nullptr;
     int32_t len = strlen(ASection);
     do {
-        if(f_gets(IStr, SD_STRING_SZ, &CommonFile) == nullptr) {
+        if(IGets(IStr, SD_STRING_SZ, &CommonFile) == nullptr) {
             Printf("iniNoSection %S\r", ASection);
             f_close(&CommonFile);
             return retvFail;
@@ -257,7 +287,7 @@ uint8_t ReadString(const char *AFileName, const char *ASection, const char *AKey
     // Section found, find the key
     len = strlen(AKey);
     do {
-        if(!f_gets(IStr, SD_STRING_SZ, &CommonFile) or *(StartP = skipleading(IStr)) == '[') {
+        if(!IGets(IStr, SD_STRING_SZ, &CommonFile) or *(StartP = skipleading(IStr)) == '[') {
             Printf("iniNoKey %S\r", AKey);
             f_close(&CommonFile);
             return retvFail;
@@ -342,10 +372,13 @@ namespace csv { // =================== csv file operations =====================
 __unused static char *csvCurToken;
 
 uint8_t OpenFile(const char *AFileName) {
-    return TryOpenFileRead(AFileName, &CommonFile);
+    uint8_t Rslt = TryOpenFileRead(AFileName, &CommonFile);
+    if(Rslt == retvOk) IXipInit(&CommonFile);
+    return Rslt;
 }
 void RewindFile() {
     f_lseek(&CommonFile, 0);
+    PXip = PXipStart;
 }
 void CloseFile() {
     f_close(&CommonFile);
@@ -357,12 +390,13 @@ void CloseFile() {
 uint8_t ReadNextLine() {
     // Move through file until comments end
     while(true) {
-        if(f_eof(&CommonFile) or f_gets(IStr, SD_STRING_SZ, &CommonFile) == nullptr) {
+        if(IGets(IStr, SD_STRING_SZ, &CommonFile) == nullptr) {
 //            Printf("csvNoMoreData\r");
             return retvEndOfFile;
         }
         csvCurToken = strtok(IStr, CSV_DELIMITERS);
-        if(*csvCurToken == '#' or *csvCurToken == 0) continue; // Skip comments and empty lines
+        // Skip comments and empty lines: no token in these
+        if(csvCurToken == nullptr or *csvCurToken == '#') continue;
         else return retvOk;
     }
 }
@@ -0,0 +1,94 @@
+/*
+ * FsBench.cpp
+ *
+ *  Created on: 19 10 2026
+ *      Author: agent
+ */
+
+#include "FsBench.h"
+#include "kl_lib.h"
+#include "kl_fs_utils.h"
+
+#define BENCH_FNAME         "bench.tmp"
+#define BENCH_INI_FNAME     "config.ini"
+#define BENCH_FILE_SZ       32768UL
+#define BENCH_CHUNK_SZ      2048UL
+#define BENCH_REWRITE_CNT   16
+#define BENCH_REWRITE_SZ    64UL
+
+namespace FsBench {
+
+static uint32_t IBuf[BENCH_CHUNK_SZ / 4];
+static systime_t Start;
+static Flash::UpdateStat_t StatStart;
+
+static void IStart() {
+    StatStart = Flash::UpdateStat;
+    Start = chVTGetSystemTimeX();
+}
+
+static void IReport(Shell_t *PShell, const char *Name, uint32_t Bytes) {
+    uint32_t us = TIME_I2US(chVTTimeElapsedSinceX(Start));
+    if(us == 0) us = 1;
+    PShell->Print("%S: %u us", Name, us);
+    if(Bytes != 0) PShell->Print(", %u KB/s", (uint32_t)(((uint64_t)Bytes * 1000000UL / 1024UL) / us));
+    PShell->Print("; pages skipped %u, programmed %u, erased %u\r",
+            Flash::UpdateStat.Skipped - StatStart.Skipped,
+            Flash::UpdateStat.ProgramOnly - StatStart.ProgramOnly,
+            Flash::UpdateStat.FullErase - StatStart.FullErase);
+}
+
+void Run(Shell_t *PShell) {
+    FRESULT Rslt;
+    uint32_t N;
+    // config.ini parse, as Settings.Load does, but to locals: running settings stay
+    int32_t MinValue = 0, MinPeriod = 0, MaxPeriod = 0;
+    IStart();
+    ini::Read<int32_t>(BENCH_INI_FNAME, "Common", "MinValue", &MinValue);
+    ini::Read<int32_t>(BENCH_INI_FNAME, "Common", "MinPeriod", &MinPeriod);
+    ini::Read<int32_t>(BENCH_INI_FNAME, "Common", "MaxPeriod", &MaxPeriod);
+    IReport(PShell, "config.ini", 0);
+    PShell->Print("  MinValue=%d, MinPeriod=%d, MaxPeriod=%d\r", MinValue, MinPeriod, MaxPeriod);
+
+    // Sequential write
+    for(uint32_t i=0; i<(BENCH_CHUNK_SZ / 4); i++) IBuf[i] = i;
+    IStart();
+    if(TryOpenFileRewrite(BENCH_FNAME, &CommonFile) != retvOk) return;
+    for(uint32_t Sz=0; Sz<BENCH_FILE_SZ; Sz += BENCH_CHUNK_SZ) {
+        Rslt = f_write(&CommonFile, IBuf, BENCH_CHUNK_SZ, &N);
+        if(Rslt != FR_OK or N != BENCH_CHUNK_SZ) {
+            PShell->Print("Write fail %u\r", Rslt);
+            f_close(&CommonFile);
+            f_unlink(BENCH_FNAME);
+            return;
+        }
+    }
+    f_close(&CommonFile);
+    IReport(PShell, "Seq write", BENCH_FILE_SZ);
+
+    // Sequential read
+    IStart();
+    if(TryOpenFileRead(BENCH_FNAME, &CommonFile) != retvOk) return;
+    for(uint32_t Sz=0; Sz<BENCH_FILE_SZ; Sz += BENCH_CHUNK_SZ) {
+        if(TryRead(&CommonFile, IBuf, BENCH_CHUNK_SZ) != retvOk) {
+            PShell->Print("Read fail\r");
+            break;
+        }
+    }
+    f_close(&CommonFile);
+    IReport(PShell, "Seq read", BENCH_FILE_SZ);
+
+    // Small file rewrites
+    IStart();
+    for(uint32_t i=0; i<BENCH_REWRITE_CNT; i++) {
+        if(TryOpenFileRewrite(BENCH_FNAME, &CommonFile) != retvOk) break;
+        IBuf[0] = i;
+        f_write(&CommonFile, IBuf, BENCH_REWRITE_SZ, &N);
+        f_close(&CommonFile);
+    }
+    IReport(PShell, "Small rewrites", BENCH_REWRITE_CNT * BENCH_REWRITE_SZ);
+
+    f_unlink(BENCH_FNAME);
+}
+
+} // namespace
@@ -0,0 +1,18 @@
+/*
+ * FsBench.h
+ *
+ *  Created on: 19 10 2026
+ *      Author: agent
+ */
+
+#pragma once
+
+#include "shell.h"
+
+/* Filesystem and flash benchmark on mounted volume: config.ini parse,
+ * sequential write and read, small file rewrites. Prints time, speed and
+ * flash page operations per step. Uses temporary file, do not run with USB
+ * connected. Mount time and erase counts on emulated flash: see ../HostTest. */
+namespace FsBench {
+void Run(Shell_t *PShell);
+}
@@ -0,0 +1,119 @@
+/*
+ * LedStream.cpp
+ *
+ *  Created on: 19 10 2026
+ *      Author: agent
+ */
+
+#include "LedStream.h"
+#include "kl_cobs.h"
+#include "shell_cmd.h"
+
+namespace LedStream {
+
+LedStreamStat_t Stat;
+static Shell_t *PSrc = nullptr;
+static volatile bool On = false;
+static sysinterval_t Timeout;
+static systime_t LastRx;
+static uint16_t LastSeq;
+static bool SeqValid;
+
+// Encoded frame collected by RX thread
+static uint8_t IRxBuf[COBS_ENCODED_MAX_SZ(sizeof(LedFrame_t))];
+static uint32_t IRxCnt = 0;
+static bool IRxOverflow = false;
+
+// Double buffer: RX thread decodes into back half, renderer copies front one
+static LedFrame_t Frame[2];
+static uint32_t Front = 0;
+static volatile bool Pending = false;
+
+static void OnFrame(const LedFrame_t &Fr) {
+    if(Fr.Type == LED_FRAME_TYPE_STOP) {
+        Stop();
+        return;
+    }
+    if(SeqValid) Stat.Dropped += (uint16_t)(Fr.Seq - LastSeq - 1);
+    LastSeq = Fr.Seq;
+    SeqValid = true;
+    chSysLock();
+    Front ^= 1;
+    if(Pending) Stat.Late++;
+    Pending = true;
+    LastRx = chVTGetSystemTimeX();
+    chSysUnlock();
+}
+
+// Called by RX thread of transport instead of Cmd.PutChar
+static void PutByte(uint8_t b) {
+    if(b != 0) {
+        if(IRxCnt < sizeof(IRxBuf)) IRxBuf[IRxCnt++] = b;
+        else IRxOverflow = true;
+        return;
+    }
+    // End of frame. Empty one is leading delimiter, skip it.
+    if(IRxCnt == 0) return;
+    LedFrame_t &Fr = Frame[Front ^ 1];
+    uint32_t Len = IRxOverflow? 0 : Cobs::Decode(IRxBuf, IRxCnt, (uint8_t*)&Fr);
+    IRxCnt = 0;
+    IRxOverflow = false;
+    if(Len == sizeof(LedFrame_t)
+            and Fr.Crc == Cobs::Crc16((uint8_t*)&Fr, sizeof(LedFrame_t) - 2)
+            and (Fr.Type == LED_FRAME_TYPE_STOP or (Fr.Type == LED_FRAME_TYPE_VALUES and Fr.LedCnt == LEDS_CNT))) {
+        OnFrame(Fr);
+    }
+    else Stat.Bad++;
+}
+
+void Start(Shell_t *PShell, uint32_t Timeout_ms) {
+    Stop();
+    Stat = LedStreamStat_t();
+    IRxCnt = 0;
+    IRxOverflow = false;
+    SeqValid = false;
+    Pending = false;
+    Timeout = TIME_MS2I(Timeout_ms);
+    LastRx = chVTGetSystemTime();
+    PSrc = PShell;
+    On = true;
+    PShell->RawRx = PutByte;
+}
+
+void Stop() {
+    chSysLock();
+    if(PSrc != nullptr) PSrc->RawRx = nullptr; // Back to shell parser
+    PSrc = nullptr;
+    On = false;
+    chSysUnlock();
+}
+
+bool IsOn() { return On; }
+
+bool Fetch(uint8_t *PValues) {
+    chSysLock();
+    if(Pending) {
+        for(uint32_t i=0; i<LEDS_CNT; i++) PValues[i] = Frame[Front].Value[i];
+        Pending = false;
+        Stat.Applied++;
+        chSysUnlock();
+        return true;
+    }
+    bool TimedOut = chVTTimeElapsedSinceX(LastRx) > Timeout;
+    chSysUnlock();
+    if(TimedOut) Stop();
+    return false;
+}
+
+} // namespace
+
+SHELL_CMD(Stream, "|u") { // Stream [Timeout_ms]
+    PShell->Ack(retvOk); // Before switching: reply is text
+    LedStream::Start(PShell, (Args.Cnt != 0)? Args[0].u : LED_STREAM_TIMEOUT_MS);
+}
+
+SHELL_CMD(StreamStat, "") {
+    LedStreamStat_t &Stat = LedStream::Stat;
+    PShell->Print("Stream %S: applied %u, dropped %u, late %u, bad %u\r",
+            LedStream::IsOn()? "on" : "off", Stat.Applied, Stat.Dropped, Stat.Late, Stat.Bad);
+}
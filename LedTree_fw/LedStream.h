@@ -0,0 +1,49 @@
+/*
+ * LedStream.h
+ *
+ *  Created on: 19 10 2026
+ *      Author: agent
+ */
+
+#pragma once
+
+#include <inttypes.h>
+#include "board.h"
+#include "shell.h"
+
+/* Host-driven LED frames. Shell command "Stream" switches its transport
+ * (UART or USB CDC) to binary: received bytes bypass the shell parser and go
+ * to frame decoder. Frames are COBS-encoded and ended by zero byte, as
+ * telemetry ones. Decoded frame goes to back half of double buffer; renderer
+ * takes latest one on its next tick. BigLed_t profiles are suspended while
+ * stream is on and restart after it. Stream ends with stop frame or when no
+ * frames come during timeout. See Tools/ledstream.py.
+ * All fields are little endian. */
+
+#define LED_FRAME_TYPE_VALUES   0x01
+#define LED_FRAME_TYPE_STOP     0x02
+#define LED_STREAM_TIMEOUT_MS   999
+
+struct LedFrame_t {
+    uint8_t Type;
+    uint8_t LedCnt;
+    uint16_t Seq;
+    uint8_t Value[LEDS_CNT];    // Same scale as Set command: [0;255]
+    uint16_t Crc;               // CRC16-CCITT-FALSE of all preceding bytes
+} __attribute__((packed));
+
+struct LedStreamStat_t {
+    uint32_t Applied;
+    uint32_t Dropped;   // Lost on the way: gaps in sequence numbers
+    uint32_t Late;      // Replaced by next one before renderer took it
+    uint32_t Bad;       // Wrong CRC, type or size
+};
+
+namespace LedStream {
+void Start(Shell_t *PShell, uint32_t Timeout_ms);
+void Stop();
+bool IsOn();
+// Called by renderer every tick while stream is on. Returns true if new frame was taken.
+bool Fetch(uint8_t *PValues);
+extern LedStreamStat_t Stat;
+}
@@ -0,0 +1,84 @@
+/*
+ * Telemetry.cpp
+ *
+ *  Created on: 19 10 2026
+ *      Author: agent
+ */
+
+#include "Telemetry.h"
+#include "TreeLeds.h"
+#include "uart.h"
+#include "kl_cobs.h"
+#include "MsgQ.h"
+#include "shell_cmd.h"
+
+extern CmdUart_t Uart;
+
+namespace Telemetry {
+
+volatile int32_t AdcValue = 0;
+uint32_t FramesSent = 0, FramesDropped = 0;
+static volatile sysinterval_t Period = 0;  // 0 means stopped
+static thread_t *PThd;
+static TelemFrame_t Frame;
+static uint8_t Encoded[COBS_ENCODED_MAX_SZ(sizeof(TelemFrame_t)) + 2];
+
+#define EVT_TELEM_RATE  EVENT_MASK(0)
+
+static void ISendFrame() {
+    LedsState_t State;
+    LedsGetState(&State);
+    Frame.Type = TELEM_FRAME_TYPE_LEDS;
+    Frame.LedCnt = LEDS_CNT;
+    Frame.Seq++;
+    Frame.Time_ms = TIME_I2MS(chVTGetSystemTimeX());
+    for(uint32_t i=0; i<LEDS_CNT; i++) Frame.Pwm[i] = State.Pwm[i];
+    Frame.Brt = State.Brt;
+    Frame.Adc = AdcValue;
+    Frame.QMain = EvtQMain.GetFullCnt();
+    Frame.QLeds = State.QDepth;
+    Frame.Crc = Cobs::Crc16((uint8_t*)&Frame, sizeof(TelemFrame_t) - 2);
+    // Delimiter on both sides: frame is not glued to preceding text output
+    Encoded[0] = 0;
+    uint32_t Len = 1 + Cobs::Encode((uint8_t*)&Frame, sizeof(TelemFrame_t), &Encoded[1]);
+    Encoded[Len++] = 0;
+    // Never wait for UART: drop frame if TX buffer is full
+    if(Uart.SendBinary(Encoded, Len) == retvOk) FramesSent++;
+    else FramesDropped++;
+}
+
+static THD_WORKING_AREA(waTelemThd, 256);
+__noreturn
+static void TelemThd(void *arg) {
+    chRegSetThreadName("Telem");
+    systime_t Next = chVTGetSystemTime();
+    while(true) {
+        if(Period == 0) {
+            chEvtWaitAny(EVT_TELEM_RATE);
+            Next = chVTGetSystemTime();
+            continue;
+        }
+        ISendFrame();
+        Next = chThdSleepUntilWindowed(Next, chTimeAddX(Next, Period)); // No drift
+    }
+}
+
+void Init() {
+    PThd = chThdCreateStatic(waTelemThd, sizeof(waTelemThd), LOWPRIO, (tfunc_t)TelemThd, NULL);
+}
+
+void SetRate(uint32_t RateHz) {
+    if(RateHz > TELEM_RATE_MAX_HZ) RateHz = TELEM_RATE_MAX_HZ;
+    Period = (RateHz == 0)? 0 : TIME_US2I(1000000UL / RateHz);
+    chEvtSignal(PThd, EVT_TELEM_RATE);
+}
+
+} // namespace
+
+SHELL_CMD(Telem, "|u") { // Telem [RateHz]: set rate or show counters
+    if(Args.Cnt != 0) {
+        Telemetry::SetRate(Args[0].u);
+        PShell->Ack(retvOk);
+    }
+    else PShell->Print("Telem: sent %u, dropped %u\r", Telemetry::FramesSent, Telemetry::FramesDropped);
+}
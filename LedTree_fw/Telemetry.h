@@ -0,0 +1,39 @@
+/*
+ * Telemetry.h
+ *
+ *  Created on: 19 10 2026
+ *      Author: agent
+ */
+
+#pragma once
+
+#include <inttypes.h>
+#include "board.h"
+
+/* Binary telemetry over command UART. Each frame is COBS-encoded and
+ * enclosed in zero bytes, so text output between frames is skipped by
+ * receiver as a frame with bad CRC. See Tools/telem2csv.py.
+ * All fields are little endian. */
+
+#define TELEM_FRAME_TYPE_LEDS   0x01
+#define TELEM_RATE_MAX_HZ       200
+
+struct TelemFrame_t {
+    uint8_t Type;
+    uint8_t LedCnt;
+    uint16_t Seq;
+    uint32_t Time_ms;
+    uint16_t Pwm[LEDS_CNT];
+    uint16_t Brt;
+    uint16_t Adc;
+    uint8_t QMain, QLeds;
+    uint16_t Crc;           // CRC16-CCITT-FALSE of all preceding bytes
+} __attribute__((packed));
+
+namespace Telemetry {
+void Init();
+// 0 stops the stream
+void SetRate(uint32_t RateHz);
+extern volatile int32_t AdcValue;
+extern uint32_t FramesSent, FramesDropped;
+}
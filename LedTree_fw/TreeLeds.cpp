@@ -8,9 +8,12 @@
 #include "TreeLeds.h"
 #include "board.h"
 #include "kl_lib.h"
-#include <vector>
+#include "StaticVector.h"
 #include "Settings.h"
 #include "shell.h"
+#include "LedStream.h"
+#include "kl_prof.h"
+#include "boot_time.h"
 
 #define LED_FREQ_HZ     450
 
@@ -26,9 +29,12 @@ enum Stage_t {stgPause, stg1, stg2};
 
 float TPeriodLeft[LEDS_CNT];
 float TPeriodGood[LEDS_CNT];
+// Values last set to PWM channels, for telemetry. Plain word writes: readers never block renderer.
+static volatile uint16_t PwmNow[LEDS_CNT];
+static volatile uint16_t BrtNow = LED_SMOOTH_MAX_BRT;
 
 class BigLed_t;
-extern std::vector<BigLed_t> Leds;
+extern StaticVector<BigLed_t, LEDS_CNT> Leds;
 
 /* === Profile ===
            VMax
@@ -42,17 +48,19 @@ extern std::vector<BigLed_t> Leds;
 class BigLed_t {
 private:
     const PinOutputPWM_t IChnl;
-//    const int32_t IIndx;
+    const uint32_t IIndx;
     float ICurrentValue;
     const uint32_t PWMFreq;
     float CurrBrt = LED_SMOOTH_MAX_BRT;
     void SetCurrent() {
+        PROF_ZONE("LedSetCurrent");
         // CurrBrt=[0;LED_SMOOTH_MAX_BRT]; ICurrentValue=[0;255]
         float x = ICurrentValue;
         float y = 0.000012*x*x*x + 0.00097*x*x - 0.035*x + 0.315;
         if(x != 0 and y < 1) y = 1;
         y = y  * CurrBrt;
         IChnl.Set((int32_t)y);
+        PwmNow[IIndx] = (y < 65535)? (uint16_t)y : 65535;
 //        if(ICurrentValue < 19.0) Printf("x: %f; y: %f\r", x, y);
     }
     // Profile
@@ -70,8 +78,8 @@ private:
     }
 public:
     float TPeriod;
-    BigLed_t(const PwmSetup_t APinSetup, const uint32_t AFreq = 0xFFFFFFFF) :
-        IChnl(APinSetup), ICurrentValue(0), PWMFreq(AFreq) {}
+    BigLed_t(const PwmSetup_t APinSetup, const uint32_t AIndx, const uint32_t AFreq = 0xFFFFFFFF) :
+        IChnl(APinSetup), IIndx(AIndx), ICurrentValue(0), PWMFreq(AFreq) {}
     void Init() {
         IChnl.Init();
         IChnl.SetFrequencyHz(PWMFreq);
@@ -142,6 +150,7 @@ public:
     }
 
     void OnTick() {
+        PROF_ZONE("LedOnTick");
         Tick++;
         TPeriod--;
         float VNow;
@@ -179,12 +188,12 @@ public:
     }
 };
 
-std::vector<BigLed_t> Leds = {
-        {LED1_PIN, LED_FREQ_HZ},
-        {LED2_PIN, LED_FREQ_HZ},
-        {LED3_PIN, LED_FREQ_HZ},
-        {LED4_PIN, LED_FREQ_HZ},
-        {LED5_PIN, LED_FREQ_HZ},
+StaticVector<BigLed_t, LEDS_CNT> Leds = {
+        {LED1_PIN, 0, LED_FREQ_HZ},
+        {LED2_PIN, 1, LED_FREQ_HZ},
+        {LED3_PIN, 2, LED_FREQ_HZ},
+        {LED4_PIN, 3, LED_FREQ_HZ},
+        {LED5_PIN, 4, LED_FREQ_HZ},
 };
 #endif
 
@@ -193,12 +202,15 @@ __noreturn
 static void LedsThread(void *arg) {
     chRegSetThreadName("PinSensors");
     EvtMsg_t msg;
+    bool WasStreaming = false;
+    uint8_t StreamValues[LEDS_CNT];
     while(true) {
         chThdSleepMilliseconds(1);
         msg.ID = 0; // Nothing
         EvtMsg_t msg = LedsMsgQ.Fetch(TIME_IMMEDIATE);
         switch(msg.ID) {
             case LEDS_SET_BRT_CMD:
+                BrtNow = msg.Value;
                 for(BigLed_t &Led : Leds) Led.SetBrightness(msg.Value);
                 break;
 
@@ -209,6 +221,18 @@ static void LedsThread(void *arg) {
 
             default: break;
         } // switch
+        // Host frames replace profiles while stream is on
+        if(LedStream::IsOn()) {
+            WasStreaming = true;
+            if(LedStream::Fetch(StreamValues)) {
+                for(uint32_t i=0; i<Leds.size(); i++) Leds[i].Set(StreamValues[i]);
+            }
+            continue;
+        }
+        if(WasStreaming) {
+            WasStreaming = false;
+            for(BigLed_t &Led : Leds) Led.ConstructAndStartFirstProfile();
+        }
         for(uint32_t i=0; i<Leds.size(); i++) {
             Leds[i].OnTick();
             TPeriodLeft[i] = Leds[i].TPeriod; // Save time left from period
@@ -227,6 +251,7 @@ void LedsInit() {
         Led.Init();
         Led.ConstructAndStartFirstProfile();
     }
+    BootTime::Stop(); // PWM is set
     // Create and start thread
     chThdCreateStatic(waLedsThread, sizeof(waLedsThread), NORMALPRIO, (tfunc_t)LedsThread, NULL);
 }
@@ -235,6 +260,12 @@ void LedsSetBrt(int32_t Brt) {
     LedsMsgQ.SendNowOrExit(EvtMsg_t(LEDS_SET_BRT_CMD, Brt));
 }
 
+void LedsGetState(LedsState_t *PState) {
+    for(uint32_t i=0; i<LEDS_CNT; i++) PState->Pwm[i] = PwmNow[i];
+    PState->Brt = BrtNow;
+    PState->QDepth = LedsMsgQ.GetFullCnt();
+}
+
 void LedsSet(uint32_t Indx, uint32_t Value) {
     Leds[Indx].Set(Value);
 }
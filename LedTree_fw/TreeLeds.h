@@ -9,7 +9,16 @@
 
 #include <inttypes.h>
 #include "MsgQ.h"
+#include "board.h"
 
 void LedsInit();
 void LedsSetBrt(int32_t Brt);
 void LedsSet(uint32_t Indx, uint32_t Value);
+
+struct LedsState_t {
+    uint16_t Pwm[LEDS_CNT];
+    uint16_t Brt;
+    uint8_t QDepth;
+};
+// Snapshot for telemetry, does not block renderer
+void LedsGetState(LedsState_t *PState);
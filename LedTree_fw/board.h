@@ -92,6 +92,13 @@
 #define PRINTF_FLOAT_EN TRUE
 #define UART_TXBUF_SZ   4096
 #define UART_RXBUF_SZ   99
+// Mirror Printf to USB virtual COM port
+#define PRINTF_TO_USB_CDC   TRUE
+// DWT profiling zones, see kl_prof.h. Debug only: adds cycles to every instrumented path
+#define PROF_EN             FALSE
+// Kernel trace ring, see kl_trace.h. Debug only: 16 bytes of RAM per record
+#define TRACE_EN            FALSE
+#define TRACE_BUF_SZ        512
 
 #define UARTS_CNT       1
 
@@ -101,3 +108,13 @@
     uartclkHSI // Use independent clock
 
 #endif
+
+#if 1 // ====================== Backup registers ===============================
+// Shared by bootloader and app: keep the same in both board.h
+#define BKPREG_FW_PENDING       0   // FW_PENDING_MAGIC: app has found firmware file on disk
+#define BKPREG_BOOT_US          1   // Time from reset to jump to app, us; written by bootloader
+#define BKPREG_DELTA_ID         2   // Delta being applied in place, see FlashDelta in bootloader
+#define BKPREG_DELTA_DONE       3   // Offset of the first page not written yet by that delta
+#define BKPREG_DISK_PAGE        4   // Disk page held by scratch page, see WriteDiskPage in bootloader
+#define FW_PENDING_MAGIC        0x46575550UL
+#endif
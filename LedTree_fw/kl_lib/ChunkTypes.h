@@ -10,6 +10,7 @@
 #include "color.h"
 #include "ch.h"
 #include "MsgQ.h"
+#include "kl_prof.h"
 
 enum ChunkSort_t {csSetup, csWait, csGoto, csEnd, csRepeat};
 
@@ -70,6 +71,7 @@ protected:
 
     // Process sequence
     void IIrqHandler() {
+        PROF_ZONE("SeqIrq");
         if(chVTIsArmedI(&ITmr)) chVTResetI(&ITmr);  // Reset timer
         while(true) {   // Process the sequence
             switch(IPCurrentChunk->ChunkSort) {
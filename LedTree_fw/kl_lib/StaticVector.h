@@ -0,0 +1,60 @@
+/*
+ * StaticVector.h
+ *
+ *  Created on: 19 10 2026
+ *      Author: agent
+ */
+
+#pragma once
+
+#include <inttypes.h>
+#include <new>
+#include <initializer_list>
+
+/* Fixed-capacity replacement of std::vector: storage is inside the object,
+ * so no heap is involved. Elements are constructed in place, so types
+ * without default constructor are fine. Size never exceeds N: push_back and
+ * resize beyond capacity are ignored. */
+template <typename T, uint32_t N>
+class StaticVector {
+private:
+    alignas(T) uint8_t IStorage[N * sizeof(T)];
+    uint32_t ICnt = 0;
+    T* IPtr() { return reinterpret_cast<T*>(IStorage); }
+    const T* IPtr() const { return reinterpret_cast<const T*>(IStorage); }
+public:
+    StaticVector() {}
+    StaticVector(std::initializer_list<T> Items) {
+        for(const T &Item : Items) push_back(Item);
+    }
+    StaticVector(const StaticVector &Other) {
+        for(const T &Item : Other) push_back(Item);
+    }
+    StaticVector& operator=(const StaticVector&) = delete;
+    ~StaticVector() { clear(); }
+
+    uint32_t size() const { return ICnt; }
+    static constexpr uint32_t capacity() { return N; }
+    bool empty() const { return ICnt == 0; }
+    T* data() { return IPtr(); }
+    const T* data() const { return IPtr(); }
+    T& operator[](uint32_t Indx) { return IPtr()[Indx]; }
+    const T& operator[](uint32_t Indx) const { return IPtr()[Indx]; }
+    T* begin() { return IPtr(); }
+    T* end() { return IPtr() + ICnt; }
+    const T* begin() const { return IPtr(); }
+    const T* end() const { return IPtr() + ICnt; }
+
+    bool push_back(const T &Item) {
+        if(ICnt >= N) return false;
+        new (&IPtr()[ICnt]) T(Item);
+        ICnt++;
+        return true;
+    }
+    void resize(uint32_t NewCnt) {
+        if(NewCnt > N) NewCnt = N;
+        while(ICnt > NewCnt) IPtr()[--ICnt].~T();
+        while(ICnt < NewCnt) new (&IPtr()[ICnt++]) T();
+    }
+    void clear() { while(ICnt > 0) IPtr()[--ICnt].~T(); }
+};
@@ -9,6 +9,7 @@
 #include "MsgQ.h"
 #include "shell.h"
 #include "adcL476.h"
+#include "kl_prof.h"
 
 #if ADC_REQUIRED
 
@@ -25,6 +26,7 @@ void AdcTxIrq(void *p, uint32_t flags) {
 }
 
 void Adc_t::IOnDmaIrq() {
+    PROF_ZONE("AdcDmaIrq");
     dmaStreamDisable(PDma);
     // Switch buffers
     if(PBufW == &IBuf1) { PBufW = &IBuf2; PBufR = &IBuf1; }
@@ -9,7 +9,7 @@
 
 #include "kl_lib.h"
 #include "board.h"
-#include <vector>
+#include "StaticVector.h"
 
 #if ADC_REQUIRED
 
@@ -55,10 +55,10 @@ struct AdcSetup_t {
         oversmp256 = ((0b1000UL << 5) | (0b111UL << 2) | ADC_CFGR2_ROVSE)
     } Oversampling;
     ftVoidVoid DoneCallback;
-    std::vector<AdcChannel_t> Channels;
+    StaticVector<AdcChannel_t, ADC_MAX_SEQ_LEN> Channels;
 };
 
-typedef std::vector<uint16_t> AdcBuf_t;
+typedef StaticVector<uint16_t, ADC_MAX_SEQ_LEN> AdcBuf_t;
 
 class Adc_t {
 private:
@@ -0,0 +1,48 @@
+/*
+ * boot_time.cpp
+ *
+ *  Created on: 19 10 2026
+ *      Author: agent
+ */
+
+#include "boot_time.h"
+#include "kl_lib.h"
+#include "shell_cmd.h"
+
+namespace BootTime {
+
+uint32_t Bootloader_us = 0, App_us = 0;
+static uint32_t IFreqMHz;
+static bool IStopped = false;
+
+void Start() {
+    Bootloader_us = BackupSpc::ReadRegister(BKPREG_BOOT_US);
+    // Value is stale after reset which bypasses bootloader, as debugger one
+    BackupSpc::EnableAccess();
+    BackupSpc::WriteRegister(BKPREG_BOOT_US, 0);
+    BackupSpc::DisableAccess();
+    Clk.UpdateFreqValues();
+    IFreqMHz = Clk.AHBFreqHz / 1000000UL;
+    CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+    DWT->CYCCNT = 0;
+    DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+}
+
+void OnClkChange() {
+    App_us += DWT->CYCCNT / IFreqMHz;
+    DWT->CYCCNT = 0;
+    IFreqMHz = Clk.AHBFreqHz / 1000000UL;
+}
+
+void Stop() {
+    if(IStopped) return;
+    App_us += DWT->CYCCNT / IFreqMHz;
+    IStopped = true;
+}
+
+} // namespace
+
+SHELL_CMD(Boot, "") {
+    PShell->Print("Boot: %u us to first LED update; bootloader %u us, app %u us\r",
+            BootTime::Bootloader_us + BootTime::App_us, BootTime::Bootloader_us, BootTime::App_us);
+}
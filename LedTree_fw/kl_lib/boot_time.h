@@ -0,0 +1,25 @@
+/*
+ * boot_time.h
+ *
+ *  Created on: 19 10 2026
+ *      Author: agent
+ */
+
+#pragma once
+
+#include <inttypes.h>
+
+/* Time from reset to some point of app, first LED update here.
+ * Bootloader part is taken from backup register BKPREG_BOOT_US. App part is
+ * counted by DWT cycles: call Start() first thing in main() and OnClkChange()
+ * after Clk.UpdateFreqValues() which follows clock setup; cycles before it are
+ * taken at the clock app was started with, so PLL lock wait after the switch
+ * is counted approximately. Code before main() (crt0) is not counted.
+ */
+
+namespace BootTime {
+void Start();
+void OnClkChange();
+void Stop();
+extern uint32_t Bootloader_us, App_us;
+}
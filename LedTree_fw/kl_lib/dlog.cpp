@@ -0,0 +1,73 @@
+/*
+ * dlog.cpp
+ *
+ *  Created on: 19 10 2026
+ *      Author: agent
+ */
+
+#include "dlog.h"
+#include "shell_cmd.h"
+
+namespace DeferredLog {
+
+DLogStat_t Stat;
+static DLogRec_t IBuf[DLOG_REC_CNT];
+// Free-running indices; only writer moves IW, only reader moves IR
+static volatile uint32_t IW = 0, IR = 0;
+static thread_t *PThd = nullptr;
+
+#define EVT_DLOG_NEW    EVENT_MASK(0)
+
+/* I-class: producers are serialized by the lock, reader is lock-free.
+ * The only cost in hot path is copying of few words. */
+void PutI(const char *Fmt, uint32_t ArgCnt, const uint32_t *PArgs) {
+    uint32_t Fill = IW - IR;
+    if(Fill >= DLOG_REC_CNT) {
+        Stat.Dropped++;
+        return;
+    }
+    DLogRec_t &Rec = IBuf[IW & (DLOG_REC_CNT - 1)];
+    Rec.Fmt = Fmt;
+    Rec.Time = chVTGetSystemTimeX();
+    for(uint32_t i=0; i<ArgCnt; i++) Rec.Args[i] = PArgs[i];
+    __DMB(); // Record is complete before it becomes visible to reader
+    IW++;
+    Stat.Logged++;
+    if(Fill + 1 > Stat.MaxFill) Stat.MaxFill = Fill + 1;
+    if(Fill == 0 and PThd != nullptr) chEvtSignalI(PThd, EVT_DLOG_NEW); // Wake reader once per batch
+}
+
+static THD_WORKING_AREA(waDLogThd, 768);
+__noreturn
+static void DLogThd(void *arg) {
+    chRegSetThreadName("DLog");
+    uint32_t DroppedReported = 0;
+    char S[DLOG_LINE_SZ];
+    while(true) {
+        chEvtWaitAny(EVT_DLOG_NEW);
+        while(IR != IW) {
+            __DMB();
+            DLogRec_t Rec = IBuf[IR & (DLOG_REC_CNT - 1)]; // Copy: slot may be reused after IR++
+            IR++;
+            // Format whole record first: one Printf keeps it from being split by other output
+            char *P = PrintfToBuf(S, DLOG_LINE_SZ, "[%u] ", TIME_I2MS(Rec.Time));
+            PrintfToBuf(P, DLOG_LINE_SZ - (P - S), Rec.Fmt, Rec.Args[0], Rec.Args[1], Rec.Args[2], Rec.Args[3]);
+            Printf("%S", S);
+        }
+        if(Stat.Dropped != DroppedReported) {
+            Printf("DLog: %u dropped\r", Stat.Dropped - DroppedReported);
+            DroppedReported = Stat.Dropped;
+        }
+    }
+}
+
+void Init() {
+    PThd = chThdCreateStatic(waDLogThd, sizeof(waDLogThd), LOWPRIO, (tfunc_t)DLogThd, NULL);
+}
+
+} // namespace
+
+SHELL_CMD(DLog, "") {
+    PShell->Print("DLog: logged %u, dropped %u, max fill %u of %u\r",
+            DeferredLog::Stat.Logged, DeferredLog::Stat.Dropped, DeferredLog::Stat.MaxFill, DLOG_REC_CNT);
+}
@@ -0,0 +1,54 @@
+/*
+ * dlog.h
+ *
+ *  Created on: 19 10 2026
+ *      Author: agent
+ */
+
+#pragma once
+
+#include "ch.h"
+#include <stdint.h>
+
+/* Deferred log: ISR or hot path stores format pointer, timestamp and raw
+ * arguments; low priority thread formats and prints them later.
+ * Arguments are taken as 32-bit words: use %u %d %X, and %S for strings
+ * that outlive the record (literals). Floats are not supported.
+ *   DLogI("Rx %u, st %X\r", Len, Status);   // from ISR or locked
+ *   DLog("Tick %u\r", Tick);                // from thread            */
+
+#define DLOG_REC_CNT        64  // Power of 2
+#define DLOG_ARGS_MAX       4
+#define DLOG_LINE_SZ        100 // Longer records are truncated
+
+struct DLogRec_t {
+    const char *Fmt;
+    systime_t Time;
+    uint32_t Args[DLOG_ARGS_MAX];
+};
+
+struct DLogStat_t {
+    uint32_t Logged, Dropped, MaxFill;
+};
+
+namespace DeferredLog {
+
+void Init();
+void PutI(const char *Fmt, uint32_t ArgCnt, const uint32_t *PArgs);
+extern DLogStat_t Stat;
+
+} // namespace
+
+template<typename... Args>
+static inline void DLogI(const char *Fmt, Args... args) {
+    static_assert(sizeof...(args) <= DLOG_ARGS_MAX, "DLog: too many args");
+    const uint32_t A[sizeof...(args) + 1] = {(uint32_t)args...};
+    DeferredLog::PutI(Fmt, sizeof...(args), A);
+}
+
+template<typename... Args>
+static inline void DLog(const char *Fmt, Args... args) {
+    chSysLock();
+    DLogI(Fmt, args...);
+    chSysUnlock();
+}
@@ -0,0 +1,51 @@
+/*
+ * kl_cobs.cpp
+ *
+ *  Created on: 19 10 2026
+ *      Author: agent
+ */
+
+#include "kl_cobs.h"
+
+namespace Cobs {
+
+uint32_t Encode(const uint8_t *PSrc, uint32_t Len, uint8_t *PDst) {
+    uint8_t *PCode = PDst, *p = PDst + 1;
+    uint8_t Code = 1;
+    while(Len--) {
+        uint8_t b = *PSrc++;
+        if(b != 0) {
+            *p++ = b;
+            Code++;
+        }
+        if(b == 0 or Code == 0xFF) { // Close current block
+            *PCode = Code;
+            PCode = p++;
+            Code = 1;
+        }
+    }
+    *PCode = Code;
+    return p - PDst;
+}
+
+uint32_t Decode(const uint8_t *PSrc, uint32_t Len, uint8_t *PDst) {
+    const uint8_t *PEnd = PSrc + Len;
+    uint8_t *p = PDst;
+    while(PSrc < PEnd) {
+        uint8_t Code = *PSrc++;
+        if(Code == 0 or (PSrc + Code - 1) > PEnd) return 0;
+        for(uint32_t i=1; i<Code; i++) *p++ = *PSrc++;
+        if(Code != 0xFF and PSrc < PEnd) *p++ = 0;
+    }
+    return p - PDst;
+}
+
+uint16_t Crc16(const uint8_t *PData, uint32_t Len, uint16_t Crc) {
+    while(Len--) {
+        Crc ^= (uint16_t)(*PData++) << 8;
+        for(uint32_t i=0; i<8; i++) Crc = (Crc & 0x8000)? ((Crc << 1) ^ 0x1021) : (Crc << 1);
+    }
+    return Crc;
+}
+
+} // namespace
@@ -0,0 +1,24 @@
+/*
+ * kl_cobs.h
+ *
+ *  Created on: 19 10 2026
+ *      Author: agent
+ */
+
+#pragma once
+
+#include <inttypes.h>
+
+/* Consistent Overhead Byte Stuffing: frame contains no zero bytes, so zero
+ * is used as frame delimiter and receiver resyncs on it after any garbage.
+ * Encoded size is at most Len + Len/254 + 1. */
+#define COBS_ENCODED_MAX_SZ(Len)    ((Len) + ((Len) / 254) + 1)
+
+namespace Cobs {
+// Returns encoded length, delimiter is not added
+uint32_t Encode(const uint8_t *PSrc, uint32_t Len, uint8_t *PDst);
+// Returns decoded length or 0 if frame is malformed
+uint32_t Decode(const uint8_t *PSrc, uint32_t Len, uint8_t *PDst);
+// CRC-16/CCITT-FALSE: poly 0x1021, init 0xFFFF
+uint16_t Crc16(const uint8_t *PData, uint32_t Len, uint16_t Crc = 0xFFFF);
+} // namespace
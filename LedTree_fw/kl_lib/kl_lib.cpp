@@ -9,7 +9,9 @@
 #include <stdarg.h>
 #include <string.h>
 #include "MsgQ.h"
-#include <malloc.h>
+#include <unistd.h>
+#include "kl_prof.h"
+#include "kl_trace.h"
 
 #if 0 // ============================ General ==================================
 // To replace standard error handler in case of virtual methods implementation
@@ -47,27 +49,15 @@ void PrintThdFreeStack(void *wsp, uint32_t size) {
 
 #endif
 
-/********************************************
-arena;     total space allocated from system
-ordblks;   number of non-inuse chunks
-hblks;     number of mmapped regions
-hblkhd;    total space in mmapped regions
-uordblks;  total allocated space
-fordblks;  total non-inuse space
-keepcost;  top-most, releasable (via malloc_trim) space
-**********************************************/
+// Static RAM and heap use. Firmware is meant to link without heap: newlib
+// heap grows from "end" by sbrk, so its size is 0 until someone mallocs.
+extern uint8_t _data_start, _bss_end, end, __heap_end__;
 void PrintMemoryInfo() {
-    struct mallinfo info = mallinfo();
-    Printf(
-            "total space allocated from system: %u\r"
-            "number of non-inuse chunks: %u\r"
-            "number of mmapped regions: %u\r"
-            "total space in mmapped regions: %u\r"
-            "total allocated space: %u\r"
-            "total non-inuse space: %u\r"
-            "top-most, releasable: %u\r",
-            info.arena, info.ordblks, info.hblks, info.hblkhd,
-            info.uordblks, info.fordblks, info.keepcost);
+    uint8_t *PHeapTop = (uint8_t*)sbrk(0);
+    Printf("Static data+bss: %u\r"
+            "Heap used: %u\r"
+            "Free: %u\r",
+            &_bss_end - &_data_start, PHeapTop - &end, &__heap_end__ - PHeapTop);
 }
 
 #if 1 // ============================ kl_string ================================
@@ -461,6 +451,10 @@ void TmrKL_t::IIrqHandler() {    // Call it inside callback
 #endif
 
 #if 1 // ============================= DEBUG ===================================
+#if defined STM32L4XX
+namespace Flash { extern volatile bool IEccProbe, IEccFault; }
+#endif
+
 extern "C" {
 
 void chDbgPanic(const char *msg1) {
@@ -492,6 +486,23 @@ void HardFault_Handler(void) {
     while(true);
 }
 
+#if defined STM32L4XX
+// Double ECC error in flash: expected in Flash::ReadChecked, fatal elsewhere
+void NMI_Handler(void) {
+    if(FLASH->ECCR & FLASH_ECCR_ECCD) {
+        FLASH->ECCR |= FLASH_ECCR_ECCD; // Clear flag
+        if(Flash::IEccProbe) {
+            Flash::IEccFault = true;
+            return;
+        }
+        PrintErrMsg("\rFlash ECC error\r");
+    }
+    else PrintErrMsg("\rNMI\r");
+    __ASM volatile("BKPT #01");
+    while(true);
+}
+#endif
+
 } // extern C
 #endif
 
@@ -648,10 +659,12 @@ uint8_t ErasePage(uint32_t PageAddress) {
 
 #if defined STM32L4XX
 uint8_t ProgramBuf32(uint32_t Address, uint32_t *PData, int32_t ASzBytes) {
+    PROF_ZONE("ProgramBuf32");
 //    Printf("PrgBuf %X  %u\r", Address, ASzBytes); chThdSleepMilliseconds(45);
     uint8_t status = WaitForLastOperation(FLASH_ProgramTimeout);
     if(status == retvOk) {
         chSysLock();
+        TRACE_USER_I(trcFlashPrg, Address);
         ClearErrFlags();
         FLASH->ACR &= ~FLASH_ACR_DCEN;      // Deactivate the data cache to avoid data misbehavior
         FLASH->CR |= FLASH_CR_PG;           // Enable flash writing
@@ -673,10 +686,24 @@ uint8_t ProgramBuf32(uint32_t Address, uint32_t *PData, int32_t ASzBytes) {
         FLASH->ACR |= FLASH_ACR_DCRST;      // }
         FLASH->ACR &= ~FLASH_ACR_DCRST;     // } Reset data cache
         FLASH->ACR |= FLASH_ACR_DCEN;       // Enable data cache
+        TRACE_USER_I(trcFlashPrgEnd, Address);
         chSysUnlock();
     }
     return status;
 }
+
+// NMI handler reports double ECC error here while reading
+volatile bool IEccProbe = false, IEccFault = false;
+
+uint8_t ReadChecked(void *PDst, uint32_t Addr, uint32_t Sz) {
+    IEccFault = false;
+    IEccProbe = true;
+    memcpy(PDst, (const void*)Addr, Sz);
+    __DSB();
+    __ISB();
+    IEccProbe = false;
+    return IEccFault? retvFail : retvOk;
+}
 #else
 uint8_t ProgramWord(uint32_t Address, uint32_t Data) {
     uint8_t status = WaitForLastOperation(FLASH_ProgramTimeout);
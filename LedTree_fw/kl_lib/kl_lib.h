@@ -1416,6 +1416,10 @@ public:
 // =========================== Flash and Option bytes ==========================
 namespace Flash {
 
+#if defined STM32L4XX
+#define FLASH_PAGE_SZ_BYTES     2048UL
+#endif
+
 void UnlockFlash();
 void LockFlash();
 
@@ -1424,6 +1428,16 @@ uint8_t ErasePage(uint32_t PageAddress);
 
 #if defined STM32L4XX
 uint8_t ProgramBuf32(uint32_t Address, uint32_t *PData, int32_t ASzBytes);
+// Compares data with page contents: skips identical page, programs changed
+// double words if they are erased, erases and programs otherwise
+struct UpdateStat_t {
+    uint32_t Skipped, ProgramOnly, FullErase;
+};
+extern UpdateStat_t UpdateStat;
+uint8_t UpdatePage(uint32_t Address, uint32_t *PData, int32_t ASzBytes);
+// Double word torn by power loss may fail ECC check and raise NMI when read.
+// Copies data and returns retvFail instead, if ECC error occurred.
+uint8_t ReadChecked(void *PDst, uint32_t Addr, uint32_t Sz);
 #else
 uint8_t ProgramWord(uint32_t Address, uint32_t Data);
 uint8_t ProgramBuf(void *PData, uint32_t ByteSz, uint32_t Addr);
@@ -0,0 +1,77 @@
+/*
+ * kl_prof.cpp
+ *
+ *  Created on: 19 10 2026
+ *      Author: agent
+ */
+
+#include "kl_prof.h"
+
+#if PROF_EN
+#if defined(__arm__)
+#define PROF_LOCK()     syssts_t sts = chSysGetStatusAndLockX()
+#define PROF_UNLOCK()   chSysRestoreStatusX(sts)
+#else
+#define PROF_LOCK()
+#define PROF_UNLOCK()
+#endif
+
+namespace Prof {
+ProfZone_t *PFirst = nullptr;
+
+void ResetAll() {
+    for(ProfZone_t *PZone = PFirst; PZone != nullptr; PZone = PZone->Next) PZone->Reset();
+}
+} // namespace
+
+void ProfZone_t::Add(uint32_t Ticks) {
+    PROF_LOCK();
+    if(!Linked) {
+        Linked = true;
+        Next = Prof::PFirst;
+        Prof::PFirst = this;
+    }
+    Cnt++;
+    Sum += Ticks;
+    if(Ticks < Min) Min = Ticks;
+    if(Ticks > Max) Max = Ticks;
+    uint32_t Bin = (Ticks == 0)? 0 : (31 - __builtin_clz(Ticks));
+    if(Bin >= PROF_HIST_BINS) Bin = PROF_HIST_BINS - 1;
+    Hist[Bin]++;
+    PROF_UNLOCK();
+}
+
+void ProfZone_t::Reset() {
+    PROF_LOCK();
+    Cnt = 0;
+    Min = 0xFFFFFFFF;
+    Max = 0;
+    Sum = 0;
+    for(uint32_t &H : Hist) H = 0;
+    PROF_UNLOCK();
+}
+
+#include "shell_cmd.h"
+
+// Host harness calls it too, see HostTest/fs_bench.cpp
+SHELL_CMD(prof, "|s") { // prof [r]: dump zones, or reset them
+    if(Args.Cnt != 0) {
+        Prof::ResetAll();
+        PShell->Ack(retvOk);
+        return;
+    }
+    PShell->Print("Zone: cnt, min/avg/max %S; log2 hist\r", PROF_TICK_NAME);
+    for(ProfZone_t *PZone = Prof::PFirst; PZone != nullptr; PZone = PZone->Next) {
+        // Copy to print consistent values, zone may be updated in IRQ
+        chSysLock();
+        ProfZone_t Z = *PZone;
+        chSysUnlock();
+        if(Z.Cnt == 0) continue;
+        PShell->Print("%S: %u, %u/%u/%u;", Z.Name, Z.Cnt, Z.Min, (uint32_t)(Z.Sum / Z.Cnt), Z.Max);
+        for(uint32_t i=0; i<PROF_HIST_BINS; i++) {
+            if(Z.Hist[i] != 0) PShell->Print(" %u:%u", i, Z.Hist[i]);
+        }
+        PShell->Print("\r");
+    }
+}
+#endif
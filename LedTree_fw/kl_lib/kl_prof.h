@@ -0,0 +1,82 @@
+/*
+ * kl_prof.h
+ *
+ *  Created on: 19 10 2026
+ *      Author: agent
+ */
+
+#pragma once
+
+#include <inttypes.h>
+#include "board.h"
+
+/* Scoped profiling zones:
+ *
+ *  void Foo() {
+ *      PROF_ZONE("Foo");   // Measures till end of scope
+ *      ...
+ *  }
+ *
+ * Target counts DWT cycles, host counts clock_gettime nanoseconds, so
+ * the same instrumented code runs in both. Zone descriptor is constant-
+ * initialized static, it is linked into zone list on first use; no guard
+ * variables, usable in IRQ. Compiled out unless PROF_EN is TRUE (board.h).
+ * Cost per zone pass is about 40 cycles. "prof" command dumps min/avg/max
+ * and log2 histogram: bin N counts passes of [2^N; 2^(N+1)) ticks.
+ */
+
+#ifndef PROF_EN
+#define PROF_EN     FALSE
+#endif
+
+#define PROF_HIST_BINS  24
+
+#if PROF_EN
+#if defined(__arm__)
+#include "ch.h"
+#define PROF_TICK_NAME  "cyc"
+static inline uint32_t ProfNow() { return DWT->CYCCNT; }
+#else
+#include <time.h>
+#define PROF_TICK_NAME  "ns"
+static inline uint32_t ProfNow() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint32_t)(ts.tv_sec * 1000000000ULL + ts.tv_nsec);
+}
+#endif
+
+struct ProfZone_t {
+    const char *Name;
+    ProfZone_t *Next;
+    bool Linked;
+    uint32_t Cnt, Min, Max;
+    uint64_t Sum;
+    uint32_t Hist[PROF_HIST_BINS];
+    constexpr ProfZone_t(const char *AName) : Name(AName), Next(nullptr), Linked(false),
+            Cnt(0), Min(0xFFFFFFFF), Max(0), Sum(0), Hist{} {}
+    void Add(uint32_t Ticks);
+    void Reset();
+};
+
+class ProfScope_t {
+private:
+    ProfZone_t &IZone;
+    uint32_t IStart;
+public:
+    ProfScope_t(ProfZone_t &AZone) : IZone(AZone), IStart(ProfNow()) {}
+    ~ProfScope_t() { IZone.Add(ProfNow() - IStart); }
+};
+
+#define PROF_ZONE(AName) \
+    static ProfZone_t ProfZone_(AName); \
+    ProfScope_t ProfScope_(ProfZone_)
+
+namespace Prof {
+extern ProfZone_t *PFirst;
+void ResetAll();
+}
+
+#else
+#define PROF_ZONE(AName)
+#endif
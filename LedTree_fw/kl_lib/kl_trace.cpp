@@ -0,0 +1,148 @@
+/*
+ * kl_trace.cpp
+ *
+ *  Created on: 19 10 2026
+ *      Author: agent
+ */
+
+#include "kl_trace.h"
+#include "kl_lib.h"
+#include "kl_cobs.h"
+#include "shell_cmd.h"
+
+#if CH_DBG_TRACE_MASK != CH_DBG_TRACE_MASK_DISABLED
+#define TRACE_THD_MAX       16
+#define TRACE_STR_MAX       32
+#define TRACE_FRAME_MAX_SZ  24
+
+static const void *Thds[TRACE_THD_MAX], *Strs[TRACE_STR_MAX];
+static uint32_t ThdCnt, StrCnt;
+static uint8_t Frame[TRACE_FRAME_MAX_SZ + 2];
+static uint8_t Encoded[COBS_ENCODED_MAX_SZ(TRACE_FRAME_MAX_SZ + 2) + 2];
+
+static uint8_t ISend(Shell_t *PShell, uint32_t Len) {
+    uint16_t Crc = Cobs::Crc16(Frame, Len);
+    Frame[Len++] = Crc & 0xFF;
+    Frame[Len++] = Crc >> 8;
+    Encoded[0] = 0;
+    uint32_t N = 1 + Cobs::Encode(Frame, Len, &Encoded[1]);
+    Encoded[N++] = 0;
+    // Transport buffer may be full: give it time to drain
+    for(uint32_t i=0; i<99; i++) {
+        if(PShell->SendBinary(Encoded, N) == retvOk) return retvOk;
+        chThdSleepMilliseconds(2);
+    }
+    return retvTimeout;
+}
+
+static uint32_t IPutU16(uint32_t Indx, uint16_t v) {
+    Frame[Indx++] = v & 0xFF;
+    Frame[Indx++] = v >> 8;
+    return Indx;
+}
+static uint32_t IPutU32(uint32_t Indx, uint32_t v) {
+    Indx = IPutU16(Indx, v & 0xFFFF);
+    return IPutU16(Indx, v >> 16);
+}
+
+static uint8_t ISendName(Shell_t *PShell, uint8_t Kind, uint8_t Id, const char *S) {
+    Frame[0] = TRACE_FRAME_NAME;
+    Frame[1] = Kind;
+    Frame[2] = Id;
+    uint32_t Len = 3;
+    if(S == nullptr) S = "?";
+    while(*S != '\0' and Len < TRACE_FRAME_MAX_SZ) Frame[Len++] = *S++;
+    return ISend(PShell, Len);
+}
+
+// Id of string, sending its name when met first time
+static uint8_t IStrId(Shell_t *PShell, const char *S) {
+    for(uint32_t i=0; i<StrCnt; i++) if(Strs[i] == S) return i;
+    if(StrCnt >= TRACE_STR_MAX) return TRACE_NO_ID;
+    Strs[StrCnt] = S;
+    ISendName(PShell, 1, StrCnt, S);
+    return StrCnt++;
+}
+
+static uint8_t IThdId(const void *tp) {
+    for(uint32_t i=0; i<ThdCnt; i++) if(Thds[i] == tp) return i;
+    return TRACE_NO_ID;
+}
+
+static void IDump(Shell_t *PShell) {
+    ch_trace_buffer_t &TB = ch.dbg.trace_buffer;
+    // Count records, oldest one is at ptr when ring is full
+    uint32_t Cnt = 0;
+    for(ch_trace_event_t &E : TB.buffer) if(E.type != CH_TRACE_TYPE_UNUSED) Cnt++;
+    Frame[0] = TRACE_FRAME_HEADER;
+    Frame[1] = 1;
+    uint32_t Len = IPutU16(2, Cnt);
+    Len = IPutU32(Len, Clk.AHBFreqHz);
+    Len = IPutU32(Len, CH_CFG_ST_FREQUENCY);
+    if(ISend(PShell, Len) != retvOk) return;
+    // Threads
+    ThdCnt = 0;
+    StrCnt = 0;
+    thread_t *tp = chRegFirstThread();
+    while(tp != nullptr) {
+        if(ThdCnt < TRACE_THD_MAX) {
+            Thds[ThdCnt] = tp;
+            ISendName(PShell, 0, ThdCnt, tp->name);
+            ThdCnt++;
+        }
+        tp = chRegNextThread(tp);
+    }
+    // Events
+    ch_trace_event_t *PE = TB.ptr;
+    for(uint32_t i=0; i<CH_DBG_TRACE_BUFFER_SIZE; i++) {
+        ch_trace_event_t &E = *PE;
+        if(++PE >= &TB.buffer[CH_DBG_TRACE_BUFFER_SIZE]) PE = &TB.buffer[0];
+        if(E.type == CH_TRACE_TYPE_UNUSED) continue;
+        uint8_t Id = TRACE_NO_ID;
+        switch(E.type) {
+            case CH_TRACE_TYPE_SWITCH: Id = IThdId(E.u.sw.ntp); break;
+            case CH_TRACE_TYPE_ISR_ENTER:
+            case CH_TRACE_TYPE_ISR_LEAVE: Id = IStrId(PShell, E.u.isr.name); break;
+            case CH_TRACE_TYPE_HALT: Id = IStrId(PShell, E.u.halt.reason); break;
+            default: break;
+        }
+        Frame[0] = TRACE_FRAME_EVENT;
+        Frame[1] = E.type;
+        Frame[2] = E.state;
+        Frame[3] = Id;
+        Len = IPutU32(4, E.rtstamp);
+        Len = IPutU32(Len, E.time);
+        if(E.type == CH_TRACE_TYPE_USER) {
+            Len = IPutU32(Len, (uint32_t)E.u.user.up1);
+            Len = IPutU32(Len, (uint32_t)E.u.user.up2);
+        }
+        if(ISend(PShell, Len) != retvOk) return;
+    }
+    Frame[0] = TRACE_FRAME_END;
+    ISend(PShell, IPutU16(1, Cnt));
+}
+
+SHELL_CMD(Trace, "|s") { // Trace [c]: dump ring, or clear it
+    bool Clear = false;
+    if(Args.Cnt != 0) {
+        if(kl_strcasecmp(Args[0].s, "c") != 0) {
+            PShell->Ack(retvCmdError);
+            return;
+        }
+        Clear = true;
+    }
+    chSysLock();
+    uint16_t WasSuspended = ch.dbg.trace_buffer.suspended;
+    chDbgSuspendTraceI(CH_DBG_TRACE_MASK_ALL);   // Ring is frozen while dumping
+    chSysUnlock();
+    if(Clear) {
+        for(ch_trace_event_t &E : ch.dbg.trace_buffer.buffer) E.type = CH_TRACE_TYPE_UNUSED;
+        ch.dbg.trace_buffer.ptr = &ch.dbg.trace_buffer.buffer[0];
+        PShell->Ack(retvOk);
+    }
+    else IDump(PShell);
+    chSysLock();
+    chDbgResumeTraceI(CH_DBG_TRACE_MASK_ALL & ~WasSuspended);
+    chSysUnlock();
+}
+#endif
@@ -0,0 +1,44 @@
+/*
+ * kl_trace.h
+ *
+ *  Created on: 19 10 2026
+ *      Author: agent
+ */
+
+#pragma once
+
+#include "ch.h"
+
+/* Export of kernel trace ring (TRACE_EN in board.h): context
+ * switches, ISR enter/leave, halt and user events. "Trace" command stops
+ * recording, sends the ring as COBS frames over the shell it came from and
+ * resumes recording; "Trace c" clears the ring. Tools/trace2json.py makes
+ * Chrome/Perfetto timeline of it.
+ * With ISR tracing, 512 records cover some tens of ms of USB traffic.
+ *
+ * Frames, little endian, each ended by CRC16-CCITT-FALSE of preceding bytes:
+ *  Header: 0x10, Ver, Cnt:u16, CoreHz:u32, StFreq:u32
+ *  Name:   0x11, Kind (0 thread, 1 string), Id, chars
+ *  Event:  0x12, EvType, State, Id, RtStamp:u32 (24 bits), Time:u32[, Up1:u32, Up2:u32]
+ *  End:    0x13, Cnt:u16
+ */
+
+#define TRACE_FRAME_HEADER  0x10
+#define TRACE_FRAME_NAME    0x11
+#define TRACE_FRAME_EVENT   0x12
+#define TRACE_FRAME_END     0x13
+#define TRACE_NO_ID         0xFF
+
+// User event tags, Up1 of user event
+enum TraceTag_t {
+    trcMsdCmd = 1, trcMsdCmdEnd,    // Value: SCSI opcode
+    trcFlashPrg, trcFlashPrgEnd,    // Value: address
+};
+
+#if CH_DBG_TRACE_MASK != CH_DBG_TRACE_MASK_DISABLED
+#define TRACE_USER_I(Tag, Value)    chDbgWriteTraceI((void*)(Tag), (void*)(Value))
+#define TRACE_USER(Tag, Value)      chDbgWriteTrace((void*)(Tag), (void*)(Value))
+#else
+#define TRACE_USER_I(Tag, Value)
+#define TRACE_USER(Tag, Value)
+#endif
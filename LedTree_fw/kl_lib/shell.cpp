@@ -7,16 +7,28 @@
 
 #include "shell.h"
 #include "uart.h"
+#include "kl_prof.h"
+#if PRINTF_TO_USB_CDC
+#include "usb_cdc.h"
+#endif
 
 extern CmdUart_t Uart;
 
 void Printf(const char *format, ...) {
     va_list args;
     va_start(args, format);
+#if PRINTF_TO_USB_CDC
+    va_list args2;
+    va_copy(args2, args);
+#endif
     chSysLock();
     Uart.IVsPrintf(format, args);
     chSysUnlock();
     va_end(args);
+#if PRINTF_TO_USB_CDC
+    UsbCdc.IPrint(format, args2); // Does nothing if port is not open
+    va_end(args2);
+#endif
 }
 
 void Printf(CmdUart_t &AUart, const char *format, ...) {
@@ -51,11 +63,22 @@ void PrintfC(const char *format, ...) {
 
 class PrintToBuf_t : public PrintfHelper_t {
 public:
-    char *S;
+    char *S, *End = nullptr; // End == nullptr: no limit
     uint8_t IPutChar(char c) {
+        if(End and S >= End) return retvOverflow;
         *S++ = c;
         return retvOk;
     }
+    uint8_t IPutStr(const char *PStr, uint32_t Len) {
+        uint8_t Rslt = retvOk;
+        if(End and Len > (uint32_t)(End - S)) {
+            Len = End - S;
+            Rslt = retvOverflow;
+        }
+        memcpy(S, PStr, Len);
+        S += Len;
+        return Rslt;
+    }
     void IStartTransmissionIfNotYet() {}
 };
 
@@ -70,6 +93,54 @@ char* PrintfToBuf(char* PBuf, const char *format, ...) {
     return PtB.S;
 }
 
+// Output is truncated to BufSz-1 chars; returns pointer to terminating zero
+char* PrintfToBuf(char* PBuf, uint32_t BufSz, const char *format, ...) {
+    if(BufSz == 0) return PBuf;
+    PrintToBuf_t PtB;
+    PtB.S = PBuf;
+    PtB.End = PBuf + BufSz - 1;
+    va_list args;
+    va_start(args, format);
+    PtB.IVsPrintf(format, args);
+    va_end(args);
+    *PtB.S = 0;
+    return PtB.S;
+}
+
+#if 1 // ============================ Cmd parsing ==============================
+uint8_t Cmd_t::ParseUint(const char *S, uint32_t *POut) {
+    uint32_t Base = 10, N = 0;
+    if(S[0] == '0' and (S[1] == 'x' or S[1] == 'X')) {
+        Base = 16;
+        S += 2;
+    }
+    if(*S == '\0') return retvNotANumber;
+    for(; *S != '\0'; S++) {
+        uint32_t Digit;
+        char c = *S;
+        if(c >= '0' and c <= '9') Digit = c - '0';
+        else if(Base == 16 and c >= 'a' and c <= 'f') Digit = c - 'a' + 10;
+        else if(Base == 16 and c >= 'A' and c <= 'F') Digit = c - 'A' + 10;
+        else return retvNotANumber;
+        if(N > (0xFFFFFFFFUL - Digit) / Base) return retvOverflow;
+        N = N * Base + Digit;
+    }
+    *POut = N;
+    return retvOk;
+}
+
+uint8_t Cmd_t::ParseInt(const char *S, int32_t *POut) {
+    bool Neg = (*S == '-');
+    if(Neg or *S == '+') S++;
+    uint32_t N;
+    uint8_t Rslt = ParseUint(S, &N);
+    if(Rslt != retvOk) return Rslt;
+    if(N > (Neg? 0x80000000UL : 0x7FFFFFFFUL)) return retvOverflow;
+    *POut = Neg? (int32_t)(0U - N) : (int32_t)N;
+    return retvOk;
+}
+#endif
+
 #if 0
 void ByteShell_t::Reply(uint8_t CmdCode, uint32_t Len, uint8_t *PData) {
 //    Printf("BSendCmd %X; %u; %A\r", CmdCode, Len, PData, Len, ' ');
@@ -98,20 +169,22 @@ static const long power10Table[FLOAT_PRECISION] = {
 #endif
 
 void PrintfHelper_t::PrintEOL() {
-    IPutChar('\r');
-    IPutChar('\n');
+    IPutStr("\r\n", 2);
     IStartTransmissionIfNotYet();
 }
 
 void PrintfHelper_t::IVsPrintf(const char *format, va_list args) {
+    PROF_ZONE("IVsPrintf");
     const char *fmt = format;
     uint32_t width = 0, precision;
     char c, filler;
     while(true) {
         c = *fmt++;
         if(c == 0) goto End;
-        if(c != '%') {  // Not %
-            if(IPutChar(c) != retvOk) goto End;
+        if(c != '%') {  // Not %: put the whole literal run at once
+            const char *PStart = fmt - 1;
+            while(*fmt != 0 and *fmt != '%') fmt++;
+            if(IPutStr(PStart, fmt - PStart) != retvOk) goto End;
             else continue;
         }
 
@@ -152,9 +225,7 @@ void PrintfHelper_t::IVsPrintf(const char *format, va_list args) {
             case 's':
             case 'S': {
                 char *s = va_arg(args, char*);
-                while(*s != 0) {
-                    if(IPutChar(*s++) != retvOk) goto End;
-                }
+                if(IPutStr(s, strlen(s)) != retvOk) goto End;
             }
             break;
 
@@ -219,22 +290,40 @@ void PrintfHelper_t::IVsPrintf(const char *format, va_list args) {
     IStartTransmissionIfNotYet();
 }
 
+static const char DigitPairs[] =
+        "00010203040506070809" "10111213141516171819" "20212223242526272829"
+        "30313233343536373839" "40414243444546474849" "50515253545556575859"
+        "60616263646566676869" "70717273747576777879" "80818283848586878889"
+        "90919293949596979899";
+
+// Number is formatted right to left into local buffer and put at once
 uint8_t PrintfHelper_t::IPutUint(uint32_t n, uint32_t base, uint32_t width, char filler) {
-    char digits[10];
-    uint32_t len = 0;
-    // Place digits to buffer
-    do {
-        uint32_t digit = n % base;
-        n /= base;
-        digits[len++] = (digit < 10)? '0'+digit : 'A'+digit-10;
-    } while(n > 0);
-    // Add padding
-    for(uint32_t i = len; i < width; i++) {
-        if(IPutChar(filler) != retvOk) return retvOverflow;
+    char Buf[PRINTF_NUM_BUF_SZ];
+    char *PEnd = &Buf[PRINTF_NUM_BUF_SZ], *p = PEnd;
+    if(base == 10) { // Two digits per division
+        while(n >= 100) {
+            uint32_t q = n / 100;
+            uint32_t r = n - q * 100;
+            n = q;
+            p -= 2;
+            p[0] = DigitPairs[r * 2];
+            p[1] = DigitPairs[r * 2 + 1];
+        }
+        if(n >= 10) {
+            p -= 2;
+            p[0] = DigitPairs[n * 2];
+            p[1] = DigitPairs[n * 2 + 1];
+        }
+        else *--p = '0' + n;
     }
-    // Print digits
-    while(len > 0) {
-        if(IPutChar(digits[--len]) != retvOk) return retvOverflow;
+    else {
+        do {
+            uint32_t digit = n % base;
+            n /= base;
+            *--p = (digit < 10)? '0'+digit : 'A'+digit-10;
+        } while(n > 0);
     }
-    return retvOk;
+    // Add padding
+    while((uint32_t)(PEnd - p) < width and p > Buf) *--p = filler;
+    return IPutStr(p, PEnd - p);
 } // IPutUint
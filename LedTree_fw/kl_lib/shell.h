@@ -9,6 +9,7 @@
 
 #include <cstring>
 #include <stdarg.h>
+#include <type_traits>
 #include "kl_lib.h"
 
 #define CMD_BUF_SZ		99
@@ -19,10 +20,25 @@ enum ProcessDataResult_t {pdrProceed, pdrNewCmd};
 class Cmd_t {
 private:
     char IString[CMD_BUF_SZ];
+    char *IPtr; // Tokenizer cursor: the rest of string, not split yet
     uint32_t Cnt;
     bool Completed;
 public:
     char *Name, *Token;
+    /* Splits next token in place and moves cursor past it; nullptr if no more.
+     * Cursor is per command, so unlike strtok it shares no state with parsers
+     * running in other threads. */
+    char* NextToken() {
+        while(*IPtr != '\0' and strchr(DELIMITERS, *IPtr) != nullptr) IPtr++;
+        if(*IPtr == '\0') return nullptr;
+        char *S = IPtr;
+        while(*IPtr != '\0' and strchr(DELIMITERS, *IPtr) == nullptr) IPtr++;
+        if(*IPtr != '\0') *IPtr++ = '\0';
+        return S;
+    }
+    // Decimal or 0x-prefixed hex, whole token must be a number
+    static uint8_t ParseUint(const char *S, uint32_t *POut);
+    static uint8_t ParseInt(const char *S, int32_t *POut);
     ProcessDataResult_t PutChar(char c) {
         // Reset cmd if it was completed, and after that new char arrived
         if(Completed) {
@@ -34,7 +50,8 @@ public:
         else if((c == '\r') or (c == '\n')) {   // end of line, check if cmd completed
             if(Cnt != 0) {  // if cmd is not empty
                 IString[Cnt] = 0; // End of string
-                Name = strtok(IString, DELIMITERS);
+                IPtr = IString;
+                Name = NextToken();
                 Completed = true;
                 return pdrNewCmd;
             }
@@ -43,19 +60,24 @@ public:
         return pdrProceed;
     }
     uint8_t GetNextString(char **PStr = nullptr) {
-        Token = strtok(NULL, DELIMITERS);
+        Token = NextToken();
         if(PStr != nullptr) *PStr = Token;
-        return (*Token == '\0')? retvEmpty : retvOk;
+        return (Token == nullptr)? retvEmpty : retvOk;
     }
 
     template <typename T>
     uint8_t GetNext(T *POutput) {
         uint8_t r = GetNextString();
-        if(r == retvOk) {
-            char *p;
-            int32_t dw32 = strtol(Token, &p, 0);
-            if(*p == '\0') *POutput = (T)dw32;
-            else r = retvNotANumber;
+        if(r != retvOk) return r;
+        if(std::is_signed<T>::value) {
+            int32_t dw32;
+            r = ParseInt(Token, &dw32);
+            if(r == retvOk) *POutput = (T)dw32;
+        }
+        else {
+            uint32_t dw32;
+            r = ParseUint(Token, &dw32);
+            if(r == retvOk) *POutput = (T)dw32;
         }
         return r;
     }
@@ -90,6 +112,8 @@ public:
 
     bool NameIs(const char *SCmd) { return (kl_strcasecmp(Name, SCmd) == 0); }
     Cmd_t() {
+        IString[0] = '\0';
+        IPtr = IString;
         Cnt = 0;
         Completed = false;
         Name = nullptr;
@@ -97,22 +121,37 @@ public:
     }
 };
 
+typedef void (*ftShellRawRx)(uint8_t b);
+
 class Shell_t {
 public:
 	Cmd_t Cmd;
+	// When set, received bytes go here instead of Cmd: binary streams bypass parser
+	volatile ftShellRawRx RawRx = nullptr;
 	virtual void SignalCmdProcessed() = 0;
 	virtual void Print(const char *format, ...) = 0;
 	void Reply(const char* CmdCode, int32_t Data) { Print("%S,%d\r\n", CmdCode, Data); }
 	void Ack(int32_t Result) { Print("Ack %d\r\n", Result); }
+	// Raw bytes for binary dumps; transports able to do it override this
+	virtual uint8_t SendBinary(const uint8_t *PData, uint32_t Len) { return retvFail; }
 };
 
 
 // Parent class for everything that prints
+#define PRINTF_NUM_BUF_SZ   16  // Max width of formatted number
 class PrintfHelper_t {
 private:
     uint8_t IPutUint(uint32_t n, uint32_t base, uint32_t width, char filler);
 protected:
     virtual uint8_t IPutChar(char c) = 0;
+    // Literal runs and formatted fields come here as a whole. Override it
+    // with block copy where possible: default one puts chars one by one.
+    virtual uint8_t IPutStr(const char *S, uint32_t Len) {
+        while(Len--) {
+            if(IPutChar(*S++) != retvOk) return retvOverflow;
+        }
+        return retvOk;
+    }
     virtual void IStartTransmissionIfNotYet() = 0;
 public:
     void IVsPrintf(const char *format, va_list args);
@@ -208,6 +247,7 @@ void PrintfEOL();
 //void PrintfNow(const char *format, ...);
 
 char* PrintfToBuf(char* PBuf, const char *format, ...);
+char* PrintfToBuf(char* PBuf, uint32_t BufSz, const char *format, ...);
 
 extern "C" {
 void PrintfC(const char *format, ...);
@@ -0,0 +1,81 @@
+/*
+ * shell_cmd.cpp
+ *
+ *  Created on: 19 10 2026
+ *      Author: agent
+ */
+
+#include "shell_cmd.h"
+
+// Zeroed before static constructors run
+static const ShellCmd_t *Table[SHELL_CMD_TABLE_SZ];
+
+namespace ShellCmds {
+
+uint32_t RegCnt = 0, RegFails = 0, MaxProbe = 0;
+
+static const ShellCmd_t* IFind(const char *Name) {
+    uint32_t Hash = ShellHash(Name);
+    for(uint32_t i=0; i<SHELL_CMD_TABLE_SZ; i++) {
+        const ShellCmd_t *PCmd = Table[(Hash + i) & (SHELL_CMD_TABLE_SZ - 1)];
+        if(PCmd == nullptr) return nullptr;
+        if(PCmd->Hash == Hash and kl_strcasecmp(PCmd->Name, Name) == 0) return PCmd;
+    }
+    return nullptr;
+}
+
+// Tokens follow Name, taken from cursor of the same Cmd
+static uint8_t IParseArgs(Cmd_t &Cmd, const char *Schema, ShellArgs_t &Args) {
+    bool Optional = false;
+    Args.Cnt = 0;
+    for(; *Schema != '\0'; Schema++) {
+        if(*Schema == '|') { Optional = true; continue; }
+        char *S = Cmd.NextToken();
+        if(S == nullptr) return Optional? retvOk : retvCmdError;
+        ShellArg_t &Arg = Args[Args.Cnt++];
+        uint8_t Rslt = retvOk;
+        if(*Schema == 's') Arg.s = S;
+        else if(*Schema == 'u') Rslt = Cmd_t::ParseUint(S, &Arg.u);
+        else Rslt = Cmd_t::ParseInt(S, &Arg.d);
+        if(Rslt != retvOk) return retvCmdError;
+    }
+    // Extra arguments are error too
+    return (Cmd.NextToken() == nullptr)? retvOk : retvCmdError;
+}
+
+uint8_t Dispatch(Shell_t *PShell) {
+    const ShellCmd_t *PCmd = IFind(PShell->Cmd.Name);
+    if(PCmd == nullptr) return retvCmdUnknown;
+    ShellArgs_t Args;
+    if(IParseArgs(PShell->Cmd, PCmd->Schema, Args) != retvOk) {
+        PShell->Ack(retvCmdError);
+        return retvCmdError;
+    }
+    PCmd->Handler(PShell, Args);
+    return retvOk;
+}
+
+} // namespace
+
+ShellCmdReg_t::ShellCmdReg_t(const ShellCmd_t *PCmd) {
+    using namespace ShellCmds;
+    for(uint32_t i=0; i<SHELL_CMD_TABLE_SZ; i++) {
+        const ShellCmd_t **PSlot = &Table[(PCmd->Hash + i) & (SHELL_CMD_TABLE_SZ - 1)];
+        if(*PSlot == nullptr) {
+            *PSlot = PCmd;
+            RegCnt++;
+            if(i > MaxProbe) MaxProbe = i;
+            return;
+        }
+        if((*PSlot)->Hash == PCmd->Hash and kl_strcasecmp((*PSlot)->Name, PCmd->Name) == 0) break; // Duplicate
+    }
+    RegFails++;
+}
+
+// ==== Commands of table itself ====
+SHELL_CMD(Help, "") {
+    for(const ShellCmd_t *PCmd : Table) {
+        if(PCmd != nullptr) PShell->Print("%S %S\r", PCmd->Name, PCmd->Schema);
+    }
+    PShell->Print("Cmds: %u, fails %u, max probe %u\r", ShellCmds::RegCnt, ShellCmds::RegFails, ShellCmds::MaxProbe);
+}
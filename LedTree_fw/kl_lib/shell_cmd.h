@@ -0,0 +1,93 @@
+/*
+ * shell_cmd.h
+ *
+ *  Created on: 19 10 2026
+ *      Author: agent
+ */
+
+#pragma once
+
+#include "shell.h"
+
+/* Hashed command table. Any module may contribute a command:
+ *
+ *  SHELL_CMD(Set, "uu") {   // Set <indx> <value>
+ *      LedsSet(Args[0].u, Args[1].u);
+ *      PShell->Ack(retvOk);
+ *  }
+ *
+ * Schema: one char per argument, 'u' uint32, 'd' int32, 's' string; args after
+ * '|' are optional, Args.Cnt tells how many were given. Arguments are parsed and
+ * checked before handler is called, so handler is not called with bad ones;
+ * strings point right into command buffer, nothing is copied.
+ * Name hash is computed at compile time; descriptors are registered into
+ * open-addressed table by static constructors, before main() starts.
+ */
+
+#define SHELL_ARGS_MAX          6
+#define SHELL_CMD_TABLE_SZ      64  // Power of 2, keep at least twice the command count
+
+union ShellArg_t {
+    uint32_t u;
+    int32_t d;
+    const char *s;
+};
+
+struct ShellArgs_t {
+    uint32_t Cnt;
+    ShellArg_t V[SHELL_ARGS_MAX];
+    ShellArg_t& operator[](uint32_t Indx) { return V[Indx]; }
+};
+
+typedef void (*ftShellCmd)(Shell_t *PShell, ShellArgs_t &Args);
+
+struct ShellCmd_t {
+    uint32_t Hash;
+    const char *Name, *Schema;
+    ftShellCmd Handler;
+};
+
+// Case-insensitive FNV-1a: same one is used for command lookup
+static constexpr uint32_t ShellHash(const char *S) {
+    uint32_t Hash = 2166136261UL;
+    while(*S != '\0') {
+        char c = *S++;
+        if(c >= 'A' and c <= 'Z') c += 'a' - 'A';
+        Hash = (Hash ^ (uint8_t)c) * 16777619UL;
+    }
+    return Hash;
+}
+
+static constexpr bool ShellSchemaIsValid(const char *S) {
+    uint32_t Cnt = 0;
+    bool OptionalStarted = false;
+    while(*S != '\0') {
+        char c = *S++;
+        if(c == '|') {
+            if(OptionalStarted) return false;
+            OptionalStarted = true;
+        }
+        else if(c == 'u' or c == 'd' or c == 's') Cnt++;
+        else return false;
+    }
+    return Cnt <= SHELL_ARGS_MAX;
+}
+
+class ShellCmdReg_t {
+public:
+    ShellCmdReg_t(const ShellCmd_t *PCmd);
+};
+
+#define SHELL_CMD(AName, ASchema) \
+    static_assert(ShellSchemaIsValid(ASchema), "Bad schema of " #AName); \
+    static void ShellCmd_##AName(Shell_t *PShell, ShellArgs_t &Args); \
+    static constexpr ShellCmd_t ShellCmdDesc_##AName = {ShellHash(#AName), #AName, ASchema, ShellCmd_##AName}; \
+    static ShellCmdReg_t ShellCmdReg_##AName(&ShellCmdDesc_##AName); \
+    static void ShellCmd_##AName(__unused Shell_t *PShell, __unused ShellArgs_t &Args)
+
+namespace ShellCmds {
+// retvCmdUnknown if command is not in table; otherwise command is processed or Ack'ed with error
+uint8_t Dispatch(Shell_t *PShell);
+// Commands with same name or table overflow: checked at startup, as table is built in runtime
+extern uint32_t RegCnt, RegFails, MaxProbe;
+} // namespace
@@ -0,0 +1,76 @@
+/*
+ * top.cpp
+ *
+ *  Created on: 19 10 2026
+ *      Author: agent
+ */
+
+#include "top.h"
+#include "shell_cmd.h"
+#include "kl_lib.h"
+
+#if CH_DBG_STATISTICS && CH_CFG_USE_REGISTRY
+extern stkalign_t __main_thread_stack_base__, __main_thread_stack_end__;
+
+namespace Top {
+
+uint32_t StackFree(thread_t *tp) {
+    uint8_t *PStart = (uint8_t*)tp->wabase;
+    // Thread descriptor lies on top of working area; main thread has its own stack
+    uint8_t *PEnd = (tp == &ch.mainthread)? (uint8_t*)&__main_thread_stack_end__ : (uint8_t*)tp;
+    uint8_t *p = PStart;
+    while(p < PEnd and *p == CH_DBG_STACK_FILL_VALUE) p++;
+    return p - PStart;
+}
+
+static uint32_t ToUs(rttime_t Cycles) { return Cycles / (Clk.AHBFreqHz / 1000000UL); }
+
+void Print(Shell_t *PShell) {
+    // Take snapshot and restart counting; current thread measurement goes on
+    rttime_t Total = 0, Irq;
+    ucnt_t NIrq, NCtxSw;
+    rtcnt_t CritThd, CritIsr;
+    thread_t *tp = chRegFirstThread();
+    while(tp != nullptr) {
+        chSysLock();
+        Total += tp->stats.cumulative;
+        chSysUnlock();
+        tp = chRegNextThread(tp);
+    }
+    chSysLock();
+    Irq = ch.irq_cumulative;
+    ch.irq_cumulative = 0;
+    NIrq = ch.kernel_stats.n_irq;
+    NCtxSw = ch.kernel_stats.n_ctxswc;
+    ch.kernel_stats.n_irq = 0;
+    ch.kernel_stats.n_ctxswc = 0;
+    CritThd = ch.kernel_stats.m_crit_thd.worst;
+    CritIsr = ch.kernel_stats.m_crit_isr.worst;
+    chTMObjectInit(&ch.kernel_stats.m_crit_thd);
+    chTMObjectInit(&ch.kernel_stats.m_crit_isr);
+    chSysUnlock();
+    if(Total == 0) Total = 1;
+    PShell->Print("Prio   CPU%%  Switches  StkFree  Name\r");
+    tp = chRegFirstThread();
+    while(tp != nullptr) {
+        chSysLock();
+        rttime_t Cum = tp->stats.cumulative;
+        ucnt_t N = tp->stats.n;
+        tp->stats.cumulative = 0;
+        tp->stats.n = 0;
+        chSysUnlock();
+        uint32_t Permille = (uint32_t)((Cum * 1000ULL) / Total);
+        PShell->Print("%4u  %3u.%u  %8u  %7u  %S\r", tp->prio, Permille / 10, Permille % 10,
+                N, StackFree(tp), (tp->name != nullptr)? tp->name : "?");
+        tp = chRegNextThread(tp);
+    }
+    uint32_t IrqPermille = (uint32_t)((Irq * 1000ULL) / Total);
+    PShell->Print("IRQ: %u, %u.%u%%; ctx switches: %u; period %u ms\r",
+            NIrq, IrqPermille / 10, IrqPermille % 10, NCtxSw, ToUs(Total) / 1000UL);
+    PShell->Print("Worst critical zone: thd %u us, isr %u us\r", ToUs(CritThd), ToUs(CritIsr));
+}
+
+} // namespace
+
+SHELL_CMD(top, "") { Top::Print(PShell); }
+#endif
@@ -0,0 +1,32 @@
+/*
+ * top.h
+ *
+ *  Created on: 19 10 2026
+ *      Author: agent
+ */
+
+#pragma once
+
+#include "shell.h"
+
+/* Per-thread CPU load and stack high-water mark, "top" command.
+ * Built on kernel statistics: CH_CFG_USE_REGISTRY, CH_CFG_USE_TM and
+ * CH_DBG_STATISTICS must be TRUE; stacks are painted by CH_DBG_FILL_THREADS
+ * (main one by crt0). Time is measured by DWT cycle counter.
+ * Thread time includes IRQs that preempted it; IRQ time is shown separately.
+ * Load is shown for the period since previous "top" call.
+ *
+ * Accounting cost at 64 MHz, roughly:
+ *  - context switch: one chTMChainMeasurementToX, about 30 cycles;
+ *  - every chSysLock/Unlock pair: start/stop of critical zone measurement,
+ *    about 40 cycles: this is the main cost, as locks are everywhere;
+ *  - every IRQ: two counter reads in prologue/epilogue hooks, about 15 cycles;
+ *  - RAM: 32 bytes per thread, registry links and name.
+ * Set CH_DBG_STATISTICS to FALSE in chconf.h to get rid of it.
+ */
+
+namespace Top {
+void Print(Shell_t *PShell);
+// Free bytes that were never touched by stack
+uint32_t StackFree(thread_t *tp);
+}
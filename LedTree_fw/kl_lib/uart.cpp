@@ -202,6 +202,28 @@ uint8_t BaseUart_t::IPutByte(uint8_t b) {
     return retvOk;
 }
 
+// Copy as much as fits, in one or two segments
+uint8_t BaseUart_t::IPutBytes(const uint8_t *PData, uint32_t Len) {
+    uint32_t FreeCnt = UART_TXBUF_SZ - IFullSlotsCount;
+    uint8_t Rslt = retvOk;
+    if(Len > FreeCnt) {
+        Len = FreeCnt;
+        Rslt = retvOverflow;
+    }
+    uint32_t PartSz = (TXBuf + UART_TXBUF_SZ) - PWrite; // Cnt from PWrite to end of buf
+    if(Len < PartSz) {
+        memcpy(PWrite, PData, Len);
+        PWrite += Len;
+    }
+    else {
+        memcpy(PWrite, PData, PartSz);
+        memcpy(TXBuf, PData + PartSz, Len - PartSz);
+        PWrite = TXBuf + (Len - PartSz);
+    }
+    IFullSlotsCount += Len;
+    return Rslt;
+}
+
 void BaseUart_t::IStartTransmissionIfNotYet() {
     if(IDmaIsIdle) ISendViaDMA();
 }
@@ -227,6 +249,10 @@ uint8_t BaseUart_t::IPutByteNow(uint8_t b) {
 #endif // TX
 
 #if 1 // ==== RX ====
+/* Thread sleeps until bytes arrive: woken by USART IDLE line IRQ (end of
+ * burst), by DMA half and full transfer IRQs (long stream, before circular
+ * buffer wraps) and when previous command is processed. */
+#define EVT_UART_RX     EVENT_MASK(0)
 static thread_reference_t RXThread = nullptr;
 static THD_WORKING_AREA(waUartRxThread, 128);
 
@@ -234,7 +260,7 @@ __noreturn
 static void UartRxThread(void *arg) {
     chRegSetThreadName("UartRx");
     while(true) {
-        chThdSleepMilliseconds(UART_RX_POLLING_MS);
+        chEvtWaitAny(EVT_UART_RX);
         // Iterate UARTs
         for(BaseUart_t* ptr : PUarts) {
             if(ptr != nullptr) ptr->ProcessByteIfReceived();
@@ -242,6 +268,88 @@ static void UartRxThread(void *arg) {
     } // while true
 }
 
+static inline void WakeRxThreadI() {
+    if(RXThread != nullptr) chEvtSignalI(RXThread, EVT_UART_RX);
+}
+
+// Wrapper for RX DMA IRQ: half or full transfer
+extern "C"
+void DmaUartRxIrq(void *p, uint32_t flags) {
+    chSysLockFromISR();
+    WakeRxThreadI();
+    chSysUnlockFromISR();
+}
+
+// ==== IDLE line IRQ ====
+static void OnUartIrq(USART_TypeDef *Uart) {
+    chSysLockFromISR();
+#if defined STM32L4XX || defined STM32F0XX || defined STM32F7XX
+    if(Uart->ISR & USART_ISR_IDLE) {
+        Uart->ICR = USART_ICR_IDLECF;
+        WakeRxThreadI();
+    }
+#else
+    if(Uart->SR & USART_SR_IDLE) {
+        (void)Uart->DR; // Reading SR then DR clears IDLE
+        WakeRxThreadI();
+    }
+#endif
+    chSysUnlockFromISR();
+}
+
+#if UART_USE_TXE_IRQ
+#error "UART TC IRQ and RX IDLE IRQ share vectors"
+#endif
+
+extern "C" {
+void STM32_USART1_HANDLER() {
+    CH_IRQ_PROLOGUE();
+    OnUartIrq(USART1);
+    CH_IRQ_EPILOGUE();
+}
+void STM32_USART2_HANDLER() {
+    CH_IRQ_PROLOGUE();
+    OnUartIrq(USART2);
+    CH_IRQ_EPILOGUE();
+}
+#if defined USART3
+void STM32_USART3_HANDLER() {
+    CH_IRQ_PROLOGUE();
+    OnUartIrq(USART3);
+    CH_IRQ_EPILOGUE();
+}
+#endif
+#if defined UART4
+void STM32_UART4_HANDLER() {
+    CH_IRQ_PROLOGUE();
+    OnUartIrq(UART4);
+    CH_IRQ_EPILOGUE();
+}
+#endif
+#if defined UART5
+void STM32_UART5_HANDLER() {
+    CH_IRQ_PROLOGUE();
+    OnUartIrq(UART5);
+    CH_IRQ_EPILOGUE();
+}
+#endif
+} // extern C
+
+static void EnableIdleIrq(USART_TypeDef *Uart) {
+    if     (Uart == USART1) nvicEnableVector(USART1_IRQn, IRQ_PRIO_MEDIUM);
+    else if(Uart == USART2) nvicEnableVector(USART2_IRQn, IRQ_PRIO_MEDIUM);
+#if defined USART3
+    else if(Uart == USART3) nvicEnableVector(USART3_IRQn, IRQ_PRIO_MEDIUM);
+#endif
+#if defined UART4
+    else if(Uart == UART4) nvicEnableVector(UART4_IRQn, IRQ_PRIO_MEDIUM);
+#endif
+#if defined UART5
+    else if(Uart == UART5) nvicEnableVector(UART5_IRQn, IRQ_PRIO_MEDIUM);
+#endif
+    Uart->CR1 |= USART_CR1_IDLEIE;
+}
+
 uint8_t BaseUart_t::GetByte(uint8_t *b) {
 #if defined STM32F2XX || defined STM32F4XX || defined STM32F7XX
     int32_t WIndx = UART_RXBUF_SZ - PDmaRx->stream->NDTR;
@@ -426,14 +534,13 @@ void BaseUart_t::Init() {
 #if defined STM32F0XX
     if(Params->PDmaRx == STM32_DMA1_STREAM5) SYSCFG->CFGR1 |= SYSCFG_CFGR1_USART1RX_DMA_RMP;
 #endif
-    // DMA
-    PDmaRx = dmaStreamAlloc(Params->DmaRxID, IRQ_PRIO_MEDIUM, nullptr, NULL);
+    // DMA: half and full transfer IRQs wake RX thread
+    PDmaRx = dmaStreamAlloc(Params->DmaRxID, IRQ_PRIO_MEDIUM, DmaUartRxIrq, this);
     dmaStreamSetPeripheral(PDmaRx, &Params->Uart->UART_RX_REG);
     dmaStreamSetMemory0   (PDmaRx, IRxBuf);
     dmaStreamSetTransactionSize(PDmaRx, UART_RXBUF_SZ);
-    dmaStreamSetMode      (PDmaRx, Params->DmaModeRx);
+    dmaStreamSetMode      (PDmaRx, Params->DmaModeRx | STM32_DMA_CR_HTIE | STM32_DMA_CR_TCIE);
     dmaStreamEnable       (PDmaRx);
-    Params->Uart->CR1 |= USART_CR1_UE;    // Enable USART
 
     // Prepare and start RX
     for(int i=0; i<UARTS_CNT; i++) {
@@ -445,6 +552,8 @@ void BaseUart_t::Init() {
     if(RXThread == nullptr) {
         RXThread = chThdCreateStatic(waUartRxThread, sizeof(waUartRxThread), NORMALPRIO, (tfunc_t)UartRxThread, NULL);
     }
+    EnableIdleIrq(Params->Uart);
+    Params->Uart->CR1 |= USART_CR1_UE;    // Enable USART
 }
 
 void BaseUart_t::Shutdown() {
@@ -525,6 +634,8 @@ void BaseUart_t::OnClkChange() {
 void BaseUart_t::SignalRxProcessed() {
     chSysLock();
     RxProcessed = true;
+    WakeRxThreadI(); // Bytes may have arrived while cmd was processed
+    chSchRescheduleS();
     chSysUnlock();
 }
 
@@ -535,7 +646,9 @@ void CmdUart_t::ProcessByteIfReceived() {
     if(!RxProcessed) return;
     uint8_t b;
     while(GetByte(&b) == retvOk) {
-        if(Cmd.PutChar(b) == pdrNewCmd) {
+        ftShellRawRx PRawRx = RawRx;
+        if(PRawRx != nullptr) PRawRx(b);
+        else if(Cmd.PutChar(b) == pdrNewCmd) {
             RxProcessed = false;
             EvtQMain.SendNowOrExit(EvtMsg_t(evtIdShellCmd, (Shell_t*)this));
         } // if new cmd
@@ -662,17 +775,6 @@ static const UartParams_t ByteUartParams = {
 };
 
 ByteUart_t ByteUart(&ByteUartParams);
-thread_reference_t IByteRxThd = nullptr;
-
-static THD_WORKING_AREA(waByteUartRxThread, 128);
-__noreturn
-static void ByteUartRxThread(void *arg) {
-    chRegSetThreadName("ByteUartRx");
-    while(true) {
-        chThdSleepMilliseconds(UART_RX_POLLING_MS);
-        ByteUart.IRxTask();
-    }
-}
 
 void ByteUart_t::IRxTask() {
     if(CmdProcessInProgress) return;    // Busy processing cmd
@@ -687,14 +789,8 @@ void ByteUart_t::IRxTask() {
     }
 }
 
+// RX is served by common UartRx thread, see ProcessByteIfReceived
 void ByteUart_t::Init(uint32_t ABaudrate) {
     BaseUart_t::Init(ABaudrate);
-#if UART_RX_ENABLED
-    // Create RX Thread if not created
-    if(IByteRxThd == nullptr) {
-        IByteRxThd = chThdCreateStatic(waByteUartRxThread, sizeof(waByteUartRxThread),
-                NORMALPRIO, ByteUartRxThread, NULL);
-    }
-#endif
 }
 #endif
@@ -12,8 +12,10 @@
 #include "shell.h"
 #include "board.h"
 
-extern "C"
+extern "C" {
 void DmaUartTxIrq(void *p, uint32_t flags);
+void DmaUartRxIrq(void *p, uint32_t flags);
+}
 
 struct UartParams_t {
     uint32_t Baudrate;
@@ -51,7 +53,6 @@ struct UartParams_t {
 #define UART_USE_TXE_IRQ    FALSE
 
 #define UART_CMD_BUF_SZ     54 // payload bytes
-#define UART_RX_POLLING_MS  99
 
 // ==== Base class ====
 class BaseUart_t {
@@ -72,6 +73,7 @@ protected:
     bool RxProcessed = true;
     void SignalRxProcessed();
     uint8_t IPutByte(uint8_t b);
+    uint8_t IPutBytes(const uint8_t *PData, uint32_t Len);
     uint8_t IPutByteNow(uint8_t b);
     void IStartTransmissionIfNotYet();
     virtual void IOnTxEnd() = 0;
@@ -107,6 +109,7 @@ class CmdUart_t : public BaseUart_t, public PrintfHelper_t, public Shell_t {
 private:
     void IOnTxEnd() {} // Dummy
     uint8_t IPutChar(char c) { return IPutByte(c);  }
+    uint8_t IPutStr(const char *S, uint32_t Len) { return IPutBytes((const uint8_t*)S, Len); }
     void IStartTransmissionIfNotYet() { BaseUart_t::IStartTransmissionIfNotYet(); }
     void Print(const char *format, ...) {
         va_list args;
@@ -116,6 +119,14 @@ private:
     }
 public:
     CmdUart_t(const UartParams_t *APParams) : BaseUart_t(APParams) {}
+    // Raw bytes, goes to the same TX buffer as text. Returns retvOverflow if it does not fit.
+    uint8_t SendBinary(const uint8_t *PData, uint32_t Len) {
+        chSysLock();
+        uint8_t Rslt = (Len <= (UART_TXBUF_SZ - IFullSlotsCount))? IPutBytes(PData, Len) : retvOverflow;
+        if(Rslt == retvOk) IStartTransmissionIfNotYet();
+        chSysUnlock();
+        return Rslt;
+    }
     void ProcessByteIfReceived();
     void SignalCmdProcessed() { BaseUart_t::SignalRxProcessed(); }
 };
@@ -174,6 +185,7 @@ class ModbusUart485_t : public BaseUart_t, public PrintfHelper_t {
 private:
     PinOutput_t PinTxRx;
     uint8_t IPutChar(char c) { return IPutByte(c);  }
+    uint8_t IPutStr(const char *S, uint32_t Len) { return IPutBytes((const uint8_t*)S, Len); }
     void IStartTransmissionIfNotYet() {
         PinTxRx.SetHi();
         BaseUart_t::IStartTransmissionIfNotYet();
@@ -215,6 +227,7 @@ public:
     void Init(uint32_t ABaudrate);
     uint8_t IPutChar(char c) { return IPutByte(c); }
     void IStartTransmissionIfNotYet() { BaseUart_t::IStartTransmissionIfNotYet(); }
+    void ProcessByteIfReceived() { IRxTask(); }
     void IRxTask();
 };
 #endif
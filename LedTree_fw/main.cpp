@@ -2,16 +2,22 @@
 #include "hal.h"
 #include "MsgQ.h"
 #include "shell.h"
+#include "shell_cmd.h"
 #include "uart.h"
 #include "usb_msd.h"
+#include "usb_cdc.h"
 #include "SimpleSensors.h"
 #include "led.h"
 #include "Sequences.h"
-#include <vector>
 #include "adcL476.h"
 #include "kl_fs_utils.h"
 #include "TreeLeds.h"
 #include "Settings.h"
+#include "mem_msd_glue.h"
+#include "FsBench.h"
+#include "dlog.h"
+#include "Telemetry.h"
+#include "boot_time.h"
 
 #if 1 // ======================== Variables & prototypes =======================
 // Forever
@@ -27,6 +33,15 @@ bool UsbIsConnected = false;
 FATFS FlashFS;
 LedBlinker_t LedInd{LED_INDICATION};
 
+// ==== Firmware update ====
+// Bootloader mounts FS and looks for these only if marker is set
+static const char* const FwPatterns[] = {"Fw*.bin", "Fw*.fwz", "Fw*.dlt"};
+static bool FwFileIsOnDisk();
+static inline bool FwUpdateIsPending() {
+    return (BackupSpc::ReadRegister(BKPREG_FW_PENDING) == FW_PENDING_MAGIC);
+}
+static void SetFwUpdatePending();
+
 // ==== ADC ====
 void OnAdcDoneI();
 const AdcSetup_t AdcSetup = {
@@ -41,6 +56,7 @@ const AdcSetup_t AdcSetup = {
 
 
 int main(void) {
+    BootTime::Start();
     // Start Watchdog. Will reset in main thread by periodic 1 sec events.
     Iwdg::InitAndStart(4500);
     Iwdg::DisableInDebug();
@@ -74,6 +90,7 @@ int main(void) {
         }
     }
     Clk.UpdateFreqValues();
+    BootTime::OnClkChange();
     // Init OS
     halInit();
     chSysInit();
@@ -82,8 +99,10 @@ int main(void) {
     // ==== Init hardware ====
     EvtQMain.Init();
     Uart.Init();
+    DeferredLog::Init();
     Printf("\r%S %S\r", APP_NAME, XSTRINGIFY(BUILD_TIME));
     Clk.PrintFreqs();
+    if(ShellCmds::RegFails != 0) Printf("Cmd table: %u registration fails\r", ShellCmds::RegFails);
 
     // Disable dualbank if enabled. Otherwise USB MSD will not be able to write flash.
     if(Flash::DualbankIsEnabled()) {
@@ -101,6 +120,7 @@ int main(void) {
     LedInd.StartOrRestart(lsqIdle);
 
     // Init filesystem
+    MSDInit();
     FRESULT err;
     err = f_mount(&FlashFS, "", 0);
     if(err == FR_OK) {
@@ -109,7 +129,18 @@ int main(void) {
     else Printf("FS error\r");
 
     LedsInit();
+    Printf("Boot: %u us to first LED update\r", BootTime::Bootloader_us + BootTime::App_us);
+    /* Marker is lost if backup domain was not powered. If it is set, the
+     * bootloader has tried the file already: do not restart again. */
+    if(err == FR_OK and !FwUpdateIsPending() and FwFileIsOnDisk()) {
+        Printf("Firmware file found, restarting to update\r");
+        SetFwUpdatePending();
+        chThdSleepMilliseconds(99);
+        REBOOT();
+    }
+    Telemetry::Init();
     UsbMsd.Init();
+    UsbCdc.Init();
     SimpleSensors::Init();
     // Inner ADC
     Adc.Init(AdcSetup);
@@ -134,9 +165,10 @@ void ITask() {
 
             case evtIdADC:
                 Iwdg::Reload();
+                Telemetry::AdcValue = Msg.Value;
                 if(abs(Msg.Value - AdcOld) > 9) {
                     AdcOld = Msg.Value;
-//                    PrintfI("ADC: %u\r", Msg.Value);
+//                    DLog("ADC: %u\r", Msg.Value);
                     // Convert [0;4095] to [0; 255]
                     LedsSetBrt((Msg.Value * LED_SMOOTH_MAX_BRT) / 4096UL);
                 }
@@ -151,6 +183,11 @@ void ITask() {
                 UsbMsd.Disconnect();
                 Printf("USB disconnect\r");
                 if(Settings.Load() != retvOk) LedInd.StartOrRestart(lsqError);
+                // Bootloader will take it at next reset
+                if(FwFileIsOnDisk()) {
+                    SetFwUpdatePending();
+                    Printf("Firmware update pending\r");
+                }
                 break;
             case evtIdUsbReady:
                 Printf("USB ready\r");
@@ -172,6 +209,19 @@ void ProcessUsbDetect(PinSnsState_t *PState, uint32_t Len) {
     }
 }
 
+static bool FwFileIsOnDisk() {
+    for(const char *Pattern : FwPatterns) {
+        if(f_findfirst(&Dir, &FileInfo, "", Pattern) == FR_OK and FileInfo.fname[0] != 0) return true;
+    }
+    return false;
+}
+
+static void SetFwUpdatePending() {
+    BackupSpc::EnableAccess();
+    BackupSpc::WriteRegister(BKPREG_FW_PENDING, FW_PENDING_MAGIC);
+    BackupSpc::DisableAccess();
+}
+
 void OnAdcDoneI() {
     AdcBuf_t &FBuf = Adc.GetBuf();
     EvtQMain.SendNowOrExitI(EvtMsg_t(evtIdADC, FBuf[0]));
@@ -179,27 +229,45 @@ void OnAdcDoneI() {
 
 #if 1 // ======================= Command processing ============================
 void OnCmd(Shell_t *PShell) {
-	Cmd_t *PCmd = &PShell->Cmd;
-    // Handle command
-    if(PCmd->NameIs("Ping")) PShell->Ack(retvOk);
-    else if(PCmd->NameIs("Version")) PShell->Print("%S %S\r", APP_NAME, XSTRINGIFY(BUILD_TIME));
-    else if(PCmd->NameIs("mem")) PrintMemoryInfo();
-
-    else if(PCmd->NameIs("Set")) {
-        uint32_t indx, value;
-        if(PCmd->GetNext<uint32_t>(&indx)  != retvOk or indx >= LEDS_CNT) { PShell->Ack(retvCmdError); return; }
-        if(PCmd->GetNext<uint32_t>(&value) != retvOk) { PShell->Ack(retvCmdError); return; }
-        LedsSet(indx, value);
-        PShell->Ack(retvOk);
-    }
+    // Commands are registered with SHELL_CMD by their modules
+    if(ShellCmds::Dispatch(PShell) == retvCmdUnknown) PShell->Ack(retvCmdUnknown);
+}
+
+SHELL_CMD(Ping, "") { PShell->Ack(retvOk); }
+SHELL_CMD(Version, "") { PShell->Print("%S %S\r", APP_NAME, XSTRINGIFY(BUILD_TIME)); }
+SHELL_CMD(mem, "") { PrintMemoryInfo(); }
 
-    else if(PCmd->NameIs("Brt")) {
-        uint32_t brt;
-        if(PCmd->GetNext<uint32_t>(&brt) != retvOk) { PShell->Ack(retvCmdError); return; }
-        LedsSetBrt(brt);
-        PShell->Ack(retvOk);
+SHELL_CMD(FsBench, "") {
+    if(UsbIsConnected) PShell->Ack(retvBusy); // Host owns the disk
+    else FsBench::Run(PShell);
+}
+
+SHELL_CMD(PrintfBench, "") {
+    // Formatting cost only: output goes to buffer, not to transport
+    char Buf[99];
+    uint32_t Bytes = 0, N = 10000;
+    systime_t Start = chVTGetSystemTimeX();
+    for(uint32_t i=0; i<N; i++) {
+        Bytes += PrintfToBuf(Buf, "Rd: %u bytes, %u ms, %X %S\r", i * 997, i, i, "KB/s") - Buf;
     }
+    uint32_t Us = TIME_I2US(chVTTimeElapsedSinceX(Start));
+    PShell->Print("%u calls, %u bytes, %u us; %u ns/call, %u KB/s\r", N, Bytes, Us,
+            (Us * 1000UL) / N, Us? (Bytes * 1000UL / Us) : 0);
+}
+
+SHELL_CMD(FlashStat, "") {
+    PShell->Print("Pages: skipped %u, programmed %u, erased %u\r",
+            Flash::UpdateStat.Skipped, Flash::UpdateStat.ProgramOnly, Flash::UpdateStat.FullErase);
+}
+
+SHELL_CMD(Set, "uu") { // Set <indx> <value>
+    if(Args[0].u >= LEDS_CNT) { PShell->Ack(retvCmdError); return; }
+    LedsSet(Args[0].u, Args[1].u);
+    PShell->Ack(retvOk);
+}
 
-    else PShell->Ack(retvCmdUnknown);
+SHELL_CMD(Brt, "u") {
+    LedsSetBrt(Args[0].u);
+    PShell->Ack(retvOk);
 }
 #endif
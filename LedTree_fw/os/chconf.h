@@ -31,6 +31,8 @@
 #define _CHIBIOS_RT_CONF_
 #define _CHIBIOS_RT_CONF_VER_6_0_
 
+#include "board.h"  // Debug switches
+
 /*===========================================================================*/
 /**
  * @name System timers settings
@@ -172,7 +174,7 @@
  * @note    The default is @p TRUE.
  */
 #if !defined(CH_CFG_USE_TM)
-#define CH_CFG_USE_TM                       FALSE
+#define CH_CFG_USE_TM                       TRUE
 #endif
 
 /**
@@ -182,7 +184,7 @@
  * @note    The default is @p TRUE.
  */
 #if !defined(CH_CFG_USE_REGISTRY)
-#define CH_CFG_USE_REGISTRY                 FALSE
+#define CH_CFG_USE_REGISTRY                 TRUE
 #endif
 
 /**
@@ -480,7 +482,7 @@
  * @note    The default is @p FALSE.
  */
 #if !defined(CH_DBG_STATISTICS)
-#define CH_DBG_STATISTICS                   FALSE
+#define CH_DBG_STATISTICS                   TRUE
 #endif
 
 /**
@@ -524,8 +526,12 @@
  * @note    The default is @p CH_DBG_TRACE_MASK_DISABLED.
  */
 #if !defined(CH_DBG_TRACE_MASK)
+#if TRACE_EN
+#define CH_DBG_TRACE_MASK                   CH_DBG_TRACE_MASK_ALL
+#else
 #define CH_DBG_TRACE_MASK                   CH_DBG_TRACE_MASK_DISABLED
 #endif
+#endif
 
 /**
  * @brief   Trace buffer entries.
@@ -533,8 +539,12 @@
  *          different from @p CH_DBG_TRACE_MASK_DISABLED.
  */
 #if !defined(CH_DBG_TRACE_BUFFER_SIZE)
+#if TRACE_EN
+#define CH_DBG_TRACE_BUFFER_SIZE            TRACE_BUF_SZ
+#else
 #define CH_DBG_TRACE_BUFFER_SIZE            128
 #endif
+#endif
 
 /**
  * @brief   Debug option, stack checks.
@@ -589,7 +599,10 @@
  * @details User fields added to the end of the @p ch_system_t structure.
  */
 #define CH_CFG_SYSTEM_EXTRA_FIELDS                                          \
-  /* Add threads custom fields here.*/
+  /* IRQ time accounting for "top" command, see top.h */                    \
+  volatile uint32_t     irq_depth;                                          \
+  rtcnt_t               irq_start;                                          \
+  rttime_t              irq_cumulative;
 
 /**
  * @brief   System initialization hook.
@@ -637,16 +650,33 @@
 /**
  * @brief   ISR enter hook.
  */
+#if CH_DBG_STATISTICS == TRUE
+#define CH_CFG_IRQ_PROLOGUE_HOOK() {                                        \
+  if (ch.irq_depth++ == 0U) {                                               \
+    ch.irq_start = chSysGetRealtimeCounterX();                              \
+  }                                                                         \
+}
+#else
 #define CH_CFG_IRQ_PROLOGUE_HOOK() {                                        \
   /* IRQ prologue code here.*/                                              \
 }
+#endif
 
 /**
  * @brief   ISR exit hook.
  */
+#if CH_DBG_STATISTICS == TRUE
+#define CH_CFG_IRQ_EPILOGUE_HOOK() {                                        \
+  if (--ch.irq_depth == 0U) {                                               \
+    ch.irq_cumulative += (rttime_t)(chSysGetRealtimeCounterX() -            \
+                                    ch.irq_start);                          \
+  }                                                                         \
+}
+#else
 #define CH_CFG_IRQ_EPILOGUE_HOOK() {                                        \
   /* IRQ epilogue code here.*/                                              \
 }
+#endif
 
 /**
  * @brief   Idle thread enter hook.
@@ -22,14 +22,14 @@
 
 #if 1 // ==== USB Device Descriptor ====
 static const uint8_t device_descriptor_data[18] = {
-  USB_DESC_DEVICE       (0x0110,        /* bcdUSB (1.1).                    */
-                         0x00,          /* bDeviceClass                     */
-                         0x00,          /* bDeviceSubClass.                 */
-                         0x00,          /* bDeviceProtocol.                 */
+  USB_DESC_DEVICE       (0x0200,        /* bcdUSB (2.0), required for IAD.  */
+                         0xEF,          /* bDeviceClass: Miscellaneous      */
+                         0x02,          /* bDeviceSubClass: Common Class    */
+                         0x01,          /* bDeviceProtocol: IAD             */
                          64,            /* bMaxPacketSize.                  */
                          0x21BB,        /* idVendor (WWPass)                */
                          18    ,        /* idProduct.                       */
-                         0x0001,        /* bcdDevice.                       */
+                         0x0002,        /* bcdDevice: composite MSD + CDC   */
                          1,             /* iManufacturer.                   */
                          2,             /* iProduct.                        */
                          3,             /* iSerialNumber.                   */
@@ -49,8 +49,8 @@ static const USBDescriptor device_descriptor = {
 
 static const uint8_t configuration_descriptor_data[] = {
   // ==== Header ====
-  USB_DESC_CONFIGURATION(32,            /* wTotalLength.                    */
-                         1,             /* bNumInterfaces.                  */
+  USB_DESC_CONFIGURATION(98,            /* wTotalLength.                    */
+                         3,             /* bNumInterfaces.                  */
                          1,             /* bConfigurationValue.             */
                          0,             /* iConfiguration.                  */
                          0x80,          /* bmAttributes (bus powered).     */
@@ -59,7 +59,7 @@ static const uint8_t configuration_descriptor_data[] = {
   // ==== Mass Storage Interface ====
   USB_DESC_BYTE         (9),    // bLength
   USB_DESC_BYTE         (0x04), // bDescriptorType = interface descriptor
-  USB_DESC_BYTE         (0),    // bInterfaceNumber
+  USB_DESC_BYTE         (IFACE_MSD), // bInterfaceNumber
   USB_DESC_BYTE         (0),    // bAlternateSetting
   USB_DESC_BYTE         (2),    // bNumEndpoints
   USB_DESC_BYTE         (0x08), // bInterfaceClass = Mass Storage class
@@ -80,6 +80,79 @@ static const uint8_t configuration_descriptor_data[] = {
   USB_DESC_BYTE        (EP_TYPE_BULK), // bmAttributes
   USB_DESC_WORD        (EP_BULK_SZ), // wMaxPacketSize
   USB_DESC_BYTE        (0),     // bInterval
+
+  // ==== Interface Association: groups two CDC interfaces into one function ====
+  USB_DESC_BYTE         (8),    // bLength
+  USB_DESC_BYTE         (0x0B), // bDescriptorType = interface association
+  USB_DESC_BYTE         (IFACE_CDC_CMD), // bFirstInterface
+  USB_DESC_BYTE         (2),    // bInterfaceCount
+  USB_DESC_BYTE         (0x02), // bFunctionClass = CDC
+  USB_DESC_BYTE         (0x02), // bFunctionSubClass = ACM
+  USB_DESC_BYTE         (0x01), // bFunctionProtocol = AT commands
+  USB_DESC_BYTE         (0),    // iFunction
+  // ==== CDC Communication Interface ====
+  USB_DESC_BYTE         (9),    // bLength
+  USB_DESC_BYTE         (0x04), // bDescriptorType = interface descriptor
+  USB_DESC_BYTE         (IFACE_CDC_CMD), // bInterfaceNumber
+  USB_DESC_BYTE         (0),    // bAlternateSetting
+  USB_DESC_BYTE         (1),    // bNumEndpoints
+  USB_DESC_BYTE         (0x02), // bInterfaceClass = Communication Interface Class
+  USB_DESC_BYTE         (0x02), // bInterfaceSubClass = Abstract Control Model
+  USB_DESC_BYTE         (0x01), // bInterfaceProtocol = AT commands
+  USB_DESC_BYTE         (0),    // iInterface = No descriptor
+  // Header Functional Descriptor
+  USB_DESC_BYTE         (5),    // bLength
+  USB_DESC_BYTE         (CS_INTERFACE), // bDescriptorType
+  USB_DESC_BYTE         (0x00), // bDescriptorSubtype = Header
+  USB_DESC_BCD          (0x0110), // bcdCDC
+  // Call Management Functional Descriptor
+  USB_DESC_BYTE         (5),    // bLength
+  USB_DESC_BYTE         (CS_INTERFACE), // bDescriptorType
+  USB_DESC_BYTE         (0x01), // bDescriptorSubtype = Call Management
+  USB_DESC_BYTE         (0x00), // bmCapabilities: no call management
+  USB_DESC_BYTE         (IFACE_CDC_DATA), // bDataInterface
+  // ACM Functional Descriptor
+  USB_DESC_BYTE         (4),    // bLength
+  USB_DESC_BYTE         (CS_INTERFACE), // bDescriptorType
+  USB_DESC_BYTE         (0x02), // bDescriptorSubtype = Abstract Control Management
+  USB_DESC_BYTE         (0x02), // bmCapabilities: line coding and line state
+  // Union Functional Descriptor
+  USB_DESC_BYTE         (5),    // bLength
+  USB_DESC_BYTE         (CS_INTERFACE), // bDescriptorType
+  USB_DESC_BYTE         (0x06), // bDescriptorSubtype = Union
+  USB_DESC_BYTE         (IFACE_CDC_CMD),  // bMasterInterface
+  USB_DESC_BYTE         (IFACE_CDC_DATA), // bSlaveInterface0
+  // Notification Endpoint
+  USB_DESC_BYTE        (0x07),  // bLength
+  USB_DESC_BYTE        (0x05),  // bDescriptorType
+  USB_DESC_BYTE        (EP_DIR_IN | EP_CDC_INTERRUPT_ID), // bEndpointAddress
+  USB_DESC_BYTE        (EP_TYPE_INTERRUPT), // bmAttributes
+  USB_DESC_WORD        (EP_INTERRUPT_SZ), // wMaxPacketSize
+  USB_DESC_BYTE        (0xFF),  // bInterval
+  // ==== CDC Data Interface ====
+  USB_DESC_BYTE         (9),    // bLength
+  USB_DESC_BYTE         (0x04), // bDescriptorType = interface descriptor
+  USB_DESC_BYTE         (IFACE_CDC_DATA), // bInterfaceNumber
+  USB_DESC_BYTE         (0),    // bAlternateSetting
+  USB_DESC_BYTE         (2),    // bNumEndpoints
+  USB_DESC_BYTE         (0x0A), // bInterfaceClass = Data Interface Class
+  USB_DESC_BYTE         (0x00), // bInterfaceSubClass
+  USB_DESC_BYTE         (0x00), // bInterfaceProtocol
+  USB_DESC_BYTE         (0),    // iInterface = No descriptor
+  // CDC_DataOutEndpoint
+  USB_DESC_BYTE        (0x07),  // bLength
+  USB_DESC_BYTE        (0x05),  // bDescriptorType
+  USB_DESC_BYTE        (EP_DIR_OUT | EP_CDC_DATA_OUT_ID), // bEndpointAddress
+  USB_DESC_BYTE        (EP_TYPE_BULK), // bmAttributes
+  USB_DESC_WORD        (EP_BULK_SZ), // wMaxPacketSize
+  USB_DESC_BYTE        (0),     // bInterval
+  // CDC_DataInEndpoint
+  USB_DESC_BYTE        (0x07),  // bLength
+  USB_DESC_BYTE        (0x05),  // bDescriptorType
+  USB_DESC_BYTE        (EP_DIR_IN | EP_CDC_DATA_IN_ID), // bEndpointAddress
+  USB_DESC_BYTE        (EP_TYPE_BULK), // bmAttributes
+  USB_DESC_WORD        (EP_BULK_SZ), // wMaxPacketSize
+  USB_DESC_BYTE        (0),     // bInterval
 };
 
 // Configuration Descriptor wrapper.
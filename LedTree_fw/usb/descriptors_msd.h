@@ -14,6 +14,14 @@
 // Endpoints to be used for USBD2
 #define EP_MSD_IN_ID        1
 #define EP_MSD_OUT_ID       1
+#define EP_CDC_DATA_IN_ID   2
+#define EP_CDC_DATA_OUT_ID  2
+#define EP_CDC_INTERRUPT_ID 3
+
+// Interfaces of composite device
+#define IFACE_MSD           0
+#define IFACE_CDC_CMD       1
+#define IFACE_CDC_DATA      2
 
 // Endpoint Sizes for Full-Speed devices
 #define EP0_SZ              64  // Control Endpoint must have a packet size of 64 bytes
@@ -8,15 +8,27 @@
 #include "mem_msd_glue.h"
 #include "uart.h"
 #include "kl_lib.h"
+#include "msd_ftl.h"
+#include "kl_prof.h"
+
+extern "C"
+void MSDInit() {
+#if MSD_USE_INNER_FLASH && MSD_USE_FTL
+    if(Ftl.Init() != retvOk) Printf("FTL init fail\r");
+#endif
+}
 
 extern "C"
 uint8_t MSDRead(uint32_t BlockAddress, uint32_t *Ptr, uint32_t BlocksCnt) {
+    PROF_ZONE("MSDRead");
 //    Printf("RD %u; %u\r", BlockAddress, BlocksCnt);
 #if MSD_USE_SD
     if(disk_read(0, Ptr, BlockAddress, BlocksCnt) == RES_OK) return retvOk;
     else return retvFail;
 #elif MSD_USE_EXT_SPI_FLASH
     Mem.Read(BlockAddress * MSD_BLOCK_SZ, Ptr, BlocksCnt * MSD_BLOCK_SZ);
+#elif MSD_USE_INNER_FLASH && MSD_USE_FTL
+    return Ftl.Read(BlockAddress, Ptr, BlocksCnt);
 #elif MSD_USE_INNER_FLASH
     uint32_t Addr = MSD_STORAGE_ADDR + (BlockAddress * MSD_BLOCK_SZ);
     memcpy(Ptr, (const void*)Addr, BlocksCnt * MSD_BLOCK_SZ);
@@ -28,8 +40,20 @@ uint8_t MSDRead(uint32_t BlockAddress, uint32_t *Ptr, uint32_t BlocksCnt) {
 #endif
 }
 
+// Returns address of memory-mapped block, or nullptr if storage is not addressable
+extern "C"
+const void* MSDGetPtr(uint32_t BlockAddress) {
+#if MSD_USE_INNER_FLASH && !MSD_USE_FTL
+    if(BlockAddress >= MSD_BLOCK_CNT) return nullptr;
+    return (const void*)(MSD_STORAGE_ADDR + (BlockAddress * MSD_BLOCK_SZ));
+#else
+    return nullptr;
+#endif
+}
+
 extern "C"
 uint8_t MSDWrite(uint32_t BlockAddress, uint32_t *Ptr, uint32_t BlocksCnt) {
+    PROF_ZONE("MSDWrite");
 //    Printf("WR %u; %u\r", BlockAddress, BlocksCnt);
 #if MSD_USE_SD
     if(disk_write(0, Ptr, BlockAddress, BlocksCnt) == RES_OK) return retvOk;
@@ -44,6 +68,8 @@ uint8_t MSDWrite(uint32_t BlockAddress, uint32_t *Ptr, uint32_t BlocksCnt) {
         BlockAddress += MSD_BLOCK_SZ;
         BlocksCnt--;
     }
+#elif MSD_USE_INNER_FLASH && MSD_USE_FTL
+    return Ftl.Write(BlockAddress, Ptr, BlocksCnt);
 #elif MSD_USE_INNER_FLASH
     uint8_t Rslt = retvOk;
     uint32_t Addr = MSD_STORAGE_ADDR + (BlockAddress * MSD_BLOCK_SZ);
@@ -91,24 +117,17 @@ uint8_t MSDWrite(uint32_t BlockAddress, uint32_t *Ptr, uint32_t BlocksCnt) {
     Flash::UnlockFlash();
     chSysUnlock();
     Flash::ClearPendingFlags();
-    // Erase flash
+    // Erase and write only what differs from current contents
     for(uint32_t i=0; i<BlocksCnt; i++) {
-        uint32_t PageAddr = i + (Addr - FLASH_START_ADDR) / FLASH_PAGE_SIZE;
-//        Printf("Page %u\r", PageAddr);
-        if(Flash::ErasePage(PageAddr) != retvOk) {
-            Printf("\rPage %u Erase fail\r", PageAddr);
+        Rslt = Flash::UpdatePage(Addr, Ptr, FLASH_PAGE_SIZE);
+        if(Rslt != retvOk) {
+            Printf("\rPage %X write fail\r", Addr);
             chThdSleepMilliseconds(45);
-            Rslt = retvFail;
-            goto End;
+            break;
         }
+        Addr += FLASH_PAGE_SIZE;
+        Ptr += FLASH_PAGE_SIZE / sizeof(uint32_t);
     }
-    // Write flash
-    Rslt = Flash::ProgramBuf32(Addr, Ptr, BlocksCnt * FLASH_PAGE_SIZE);
-    if(Rslt != retvOk) {
-        Printf("Write Fail\r");
-        chThdSleepMilliseconds(45);
-    }
-    End:
     chSysLock();
     Flash::LockFlash();
     chSysUnlock();
@@ -39,17 +39,37 @@ extern SDCDriver SDCD1;
 #define MSD_STORAGE_SZ_KBYTES   128UL
 #define MSD_FW_RESERVED_SZ_KBYTES   128UL
 #define MSD_STORAGE_ADDR        (FLASH_START_ADDR + MSD_FW_RESERVED_SZ_KBYTES * 1024UL)
+/* EXPERIMENTAL, breaks firmware update: keep it FALSE in release builds.
+ * Log-structured translation layer with wear levelling, see msd_ftl.h.
+ * Bootloader reads the disk as plain FAT without translation, so with FTL on
+ * it finds no update file and the device cannot be updated from disk.
+ * It also takes meta and spare pages off the disk, so the disk must be
+ * reformatted after switching. */
+#ifndef MSD_USE_FTL
+#define MSD_USE_FTL             FALSE
+#endif
+#define FTL_META_PAGE_CNT       2
+#define FTL_SPARE_PAGE_CNT      6
 // Do not touch this
 #define MSD_STORAGE_SZ_BYTES    (1024 * MSD_STORAGE_SZ_KBYTES)
+#if MSD_USE_FTL
+#define MSD_BLOCK_CNT           ((MSD_STORAGE_SZ_BYTES / FLASH_PAGE_SIZE) - FTL_META_PAGE_CNT - FTL_SPARE_PAGE_CNT)
+#else
 #define MSD_BLOCK_CNT           (MSD_STORAGE_SZ_BYTES / FLASH_PAGE_SIZE)
+#endif
 #define MSD_BLOCK_SZ            FLASH_PAGE_SIZE
 #endif
 
+// Storage is addressable: MSDGetPtr returns valid pointer for any block
+#define MSD_STORAGE_IS_MAPPED   (MSD_USE_INNER_FLASH && !MSD_USE_FTL)
+
 #ifdef __cplusplus
 extern "C" {
 #endif
+void MSDInit();
 uint8_t MSDRead(uint32_t BlockAddress, uint32_t *Ptr, uint32_t BlocksCnt);
 uint8_t MSDWrite(uint32_t BlockAddress, uint32_t *Ptr, uint32_t BlocksCnt);
+const void* MSDGetPtr(uint32_t BlockAddress);
 #ifdef __cplusplus
 }
 #endif
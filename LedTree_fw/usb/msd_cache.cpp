@@ -0,0 +1,90 @@
+/*
+ * msd_cache.cpp
+ *
+ *  Created on: 19 10 2026
+ *      Author: agent
+ */
+
+#include "msd_cache.h"
+#include "kl_lib.h"
+#include "shell.h"
+
+MsdCache_t MsdCache;
+
+MsdCacheLine_t* MsdCache_t::IFind(uint32_t Block) {
+    for(MsdCacheLine_t &Line : Lines) {
+        if(Line.IsDirty and Line.Block == Block) return &Line;
+    }
+    return nullptr;
+}
+
+uint8_t MsdCache_t::IWriteOut(MsdCacheLine_t *PLine) {
+    if(MSDWrite(PLine->Block, PLine->Data, 1) != retvOk) {
+        Printf("Cache wr fail %u\r", PLine->Block);
+        return retvFail;
+    }
+    PLine->IsDirty = false;
+    return retvOk;
+}
+
+uint8_t MsdCache_t::Write(uint32_t BlockAddress, uint32_t *Ptr, uint32_t BlocksCnt) {
+    while(BlocksCnt--) {
+        MsdCacheLine_t *PLine = IFind(BlockAddress);
+        if(PLine) Hits++;
+        else {
+            // Get free line or the least recently used one
+            PLine = &Lines[0];
+            for(MsdCacheLine_t &Line : Lines) {
+                if(!Line.IsDirty) { PLine = &Line; break; }
+                if(Line.LastUse < PLine->LastUse) PLine = &Line;
+            }
+            if(PLine->IsDirty) {
+                Evictions++;
+                if(IWriteOut(PLine) != retvOk) return retvFail;
+            }
+            PLine->Block = BlockAddress;
+        }
+        memcpy(PLine->Data, Ptr, MSD_BLOCK_SZ);
+        PLine->LastUse = ++UseCnt;
+        PLine->IsDirty = true;
+        BlockAddress++;
+        Ptr += MSD_BLOCK_SZ / sizeof(uint32_t);
+    }
+    return retvOk;
+}
+
+const uint32_t* MsdCache_t::Get(uint32_t Block) {
+    MsdCacheLine_t *PLine = IFind(Block);
+    return PLine? PLine->Data : nullptr;
+}
+
+void MsdCache_t::Overlay(uint32_t BlockAddress, uint32_t *Ptr, uint32_t BlocksCnt) {
+    while(BlocksCnt--) {
+        MsdCacheLine_t *PLine = IFind(BlockAddress++);
+        if(PLine) memcpy(Ptr, PLine->Data, MSD_BLOCK_SZ);
+        Ptr += MSD_BLOCK_SZ / sizeof(uint32_t);
+    }
+}
+
+// Write dirty lines in ascending block order. Line that failed stays dirty:
+// its data is not lost, and next Flush retries it.
+uint8_t MsdCache_t::Flush() {
+    uint8_t Rslt = retvOk;
+    if(IsDirty()) Flushes++;
+    uint32_t MinBlock = 0;
+    while(true) {
+        MsdCacheLine_t *PLine = nullptr;
+        for(MsdCacheLine_t &Line : Lines) {
+            if(Line.IsDirty and Line.Block >= MinBlock and (PLine == nullptr or Line.Block < PLine->Block)) PLine = &Line;
+        }
+        if(PLine == nullptr) break;
+        if(IWriteOut(PLine) != retvOk) Rslt = retvFail;
+        MinBlock = PLine->Block + 1;
+    }
+    return Rslt;
+}
+
+bool MsdCache_t::IsDirty() {
+    for(MsdCacheLine_t &Line : Lines) if(Line.IsDirty) return true;
+    return false;
+}
@@ -0,0 +1,45 @@
+/*
+ * msd_cache.h
+ *
+ *  Created on: 19 10 2026
+ *      Author: agent
+ */
+
+#pragma once
+
+#include "mem_msd_glue.h"
+
+/* Write-back cache of MSD blocks. Absorbs repeated FAT and directory
+ * rewrites from the host; least recently used dirty block is written out
+ * when cache is full. Owner must Flush() on SYNCHRONIZE CACHE, eject,
+ * suspend, disconnect and idle. Not thread-safe: used by USB MSD thread only. */
+
+#define MSD_CACHE_LINE_CNT      8   // 2k each
+#define MSD_CACHE_IDLE_FLUSH_MS 999
+
+struct MsdCacheLine_t {
+    uint32_t Data[MSD_BLOCK_SZ / sizeof(uint32_t)];
+    uint32_t Block;
+    uint32_t LastUse;
+    bool IsDirty;
+};
+
+class MsdCache_t {
+private:
+    MsdCacheLine_t Lines[MSD_CACHE_LINE_CNT];
+    uint32_t UseCnt = 0;
+    MsdCacheLine_t* IFind(uint32_t Block);
+    uint8_t IWriteOut(MsdCacheLine_t *PLine);
+public:
+    // Statistics
+    uint32_t Hits = 0, Evictions = 0, Flushes = 0;
+    uint8_t Write(uint32_t BlockAddress, uint32_t *Ptr, uint32_t BlocksCnt);
+    // Returns cached block data or nullptr
+    const uint32_t* Get(uint32_t Block);
+    // Put cached blocks over data read from memory
+    void Overlay(uint32_t BlockAddress, uint32_t *Ptr, uint32_t BlocksCnt);
+    uint8_t Flush();
+    bool IsDirty();
+};
+
+extern MsdCache_t MsdCache;
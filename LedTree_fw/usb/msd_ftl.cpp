@@ -0,0 +1,321 @@
+/*
+ * msd_ftl.cpp
+ *
+ *  Created on: 19 10 2026
+ *      Author: agent
+ */
+
+#include "msd_ftl.h"
+
+#if MSD_USE_INNER_FLASH && MSD_USE_FTL
+#include "kl_lib.h"
+#include "shell.h"
+
+#define FTL_MAGIC           0x4C544621UL    // "!FTL"
+#define FTL_COMMIT_MAGIC    0x4B4F2146UL
+#define FTL_REC_TAG         0x5A
+#define FTL_REC_START       sizeof(FtlSnapshot_t)
+
+static_assert(sizeof(FtlSnapshot_t) % 8 == 0, "Flash is programmed by double words");
+static_assert(sizeof(FtlRecord_t) == 8, "Flash is programmed by double words");
+static_assert(FTL_DATA_PAGE_CNT < FTL_NO_PAGE, "Page index must fit uint8_t");
+
+Ftl_t Ftl;
+
+#if 1 // ============================ Flash access ==============================
+// The only place touching flash, replace these to run on other memory
+static inline uint32_t MetaAddr(uint32_t Indx) { return MSD_STORAGE_ADDR + Indx * FLASH_PAGE_SIZE; }
+static inline uint32_t DataAddr(uint32_t Page) { return MSD_STORAGE_ADDR + (FTL_META_PAGE_CNT + Page) * FLASH_PAGE_SIZE; }
+
+static uint8_t IFlashErase(uint32_t Addr) {
+    chSysLock();
+    Flash::LockFlash();
+    Flash::UnlockFlash();
+    chSysUnlock();
+    Flash::ClearPendingFlags();
+    uint8_t Rslt = Flash::ErasePage((Addr - FLASH_START_ADDR) / FLASH_PAGE_SIZE);
+    chSysLock();
+    Flash::LockFlash();
+    chSysUnlock();
+    return Rslt;
+}
+
+static uint8_t IFlashProgram(uint32_t Addr, const uint32_t *Ptr, uint32_t Sz) {
+    chSysLock();
+    Flash::LockFlash();
+    Flash::UnlockFlash();
+    chSysUnlock();
+    Flash::ClearPendingFlags();
+    uint8_t Rslt = Flash::ProgramBuf32(Addr, (uint32_t*)Ptr, Sz);
+    chSysLock();
+    Flash::LockFlash();
+    chSysUnlock();
+    return Rslt;
+}
+
+static inline uint8_t IFlashRead(void *PDst, uint32_t Addr, uint32_t Sz) {
+    return Flash::ReadChecked(PDst, Addr, Sz);
+}
+
+// Unreadable page is not erased: it will be erased as stale
+static bool PageIsErased(uint32_t Addr) {
+    uint32_t Buf[16];
+    for(uint32_t Offset=0; Offset<FLASH_PAGE_SIZE; Offset += sizeof(Buf)) {
+        if(IFlashRead(Buf, Addr + Offset, sizeof(Buf)) != retvOk) return false;
+        for(uint32_t Word : Buf) if(Word != 0xFFFFFFFF) return false;
+    }
+    return true;
+}
+#endif
+
+#if 1 // ============================= GC thread ================================
+#define EVT_FTL_GC      EVENT_MASK(0)
+static thread_t *PGcThd = nullptr;
+static THD_WORKING_AREA(waFtlGcThread, 256);
+__noreturn
+static void FtlGcThread(void *arg) {
+    chRegSetThreadName("FtlGc");
+    while(true) {
+        chEvtWaitAny(EVT_FTL_GC);
+        while(Ftl.CollectGarbage()) chThdYield();
+    }
+}
+#endif
+
+static FtlSnapshot_t Snap;
+
+// Load snapshot of current meta page and replay records after it
+uint8_t Ftl_t::ILoad() {
+    if(IFlashRead(&Snap, MetaAddr(MetaIndx), sizeof(Snap)) != retvOk) return retvFail;
+    for(uint32_t i=0; i<MSD_BLOCK_CNT; i++) Map[i] = Snap.Map[i];
+    for(uint32_t i=0; i<FTL_DATA_PAGE_CNT; i++) {
+        EraseCnt[i] = Snap.EraseCnt[i];
+        if(EraseCnt[i] == 0xFFFF) EraseCnt[i] = 0; // Never written
+    }
+    RecOffset = FTL_REC_START;
+    while(RecOffset + sizeof(FtlRecord_t) <= FLASH_PAGE_SIZE) {
+        uint32_t Rec[2];
+        if(IFlashRead(Rec, MetaAddr(MetaIndx) + RecOffset, sizeof(Rec)) == retvOk) {
+            if(Rec[0] == 0xFFFFFFFF and Rec[1] == 0xFFFFFFFF) break; // End of log
+            FtlRecord_t *PRec = (FtlRecord_t*)Rec;
+            if(PRec->Tag == FTL_REC_TAG and Rec[1] == ~Rec[0] and
+                    PRec->Block < MSD_BLOCK_CNT and PRec->Page < FTL_DATA_PAGE_CNT) {
+                Map[PRec->Block] = PRec->Page;
+            } // else torn record, skip it
+        } // else torn record failed ECC check, skip it
+        RecOffset += sizeof(FtlRecord_t);
+    }
+    return retvOk;
+}
+
+// Write current map to the other meta page. Records start right after it.
+uint8_t Ftl_t::ICompact() {
+    uint32_t NewIndx = (MetaIndx + 1) % FTL_META_PAGE_CNT;
+    uint32_t Addr = MetaAddr(NewIndx);
+    if(IFlashErase(Addr) != retvOk) return retvFail;
+    memset(&Snap, 0xFF, sizeof(Snap));
+    Snap.Magic = FTL_MAGIC;
+    Snap.Gen = Gen + 1;
+    for(uint32_t i=0; i<MSD_BLOCK_CNT; i++) Snap.Map[i] = Map[i];
+    for(uint32_t i=0; i<FTL_DATA_PAGE_CNT; i++) Snap.EraseCnt[i] = EraseCnt[i];
+    // Body first, commit last
+    if(IFlashProgram(Addr, (uint32_t*)&Snap, sizeof(Snap) - 8) != retvOk) return retvFail;
+    Snap.CommitMagic = FTL_COMMIT_MAGIC;
+    Snap.CommitGen = Snap.Gen;
+    if(IFlashProgram(Addr + sizeof(Snap) - 8, &Snap.CommitMagic, 8) != retvOk) return retvFail;
+    MetaIndx = NewIndx;
+    Gen = Snap.Gen;
+    RecOffset = FTL_REC_START;
+    return retvOk;
+}
+
+uint8_t Ftl_t::IAppendRecord(uint8_t Block, uint8_t Page) {
+    if(RecOffset + sizeof(FtlRecord_t) > FLASH_PAGE_SIZE) {
+        if(ICompact() != retvOk) return retvFail;
+    }
+    uint32_t Rec[2];
+    FtlRecord_t *PRec = (FtlRecord_t*)Rec;
+    PRec->Tag = FTL_REC_TAG;
+    PRec->Block = Block;
+    PRec->Page = Page;
+    PRec->Rsv = 0;
+    Rec[1] = ~Rec[0];
+    uint32_t Addr = MetaAddr(MetaIndx) + RecOffset;
+    RecOffset += sizeof(FtlRecord_t); // Skip the slot even if programming failed
+    return IFlashProgram(Addr, Rec, sizeof(Rec));
+}
+
+uint8_t Ftl_t::IEraseData(uint8_t Page) {
+    if(IFlashErase(DataAddr(Page)) != retvOk) return retvFail;
+    if(EraseCnt[Page] < 0xFFFE) EraseCnt[Page]++;
+    PState[Page] = fpsFree;
+    return retvOk;
+}
+
+// Get least worn free page. Erase stale one in place if nothing is pre-erased.
+uint8_t Ftl_t::IAllocPage(uint8_t *PPage) {
+    uint32_t Best = FTL_NO_PAGE, BestStale = FTL_NO_PAGE;
+    for(uint32_t i=0; i<FTL_DATA_PAGE_CNT; i++) {
+        if(PState[i] == fpsFree) {
+            if(Best == FTL_NO_PAGE or EraseCnt[i] < EraseCnt[Best]) Best = i;
+        }
+        else if(PState[i] == fpsStale) {
+            if(BestStale == FTL_NO_PAGE or EraseCnt[i] < EraseCnt[BestStale]) BestStale = i;
+        }
+    }
+    if(Best == FTL_NO_PAGE) {
+        if(BestStale == FTL_NO_PAGE) return retvOutOfMemory;
+        if(IEraseData(BestStale) != retvOk) return retvFail;
+        Best = BestStale;
+    }
+    *PPage = Best;
+    return retvOk;
+}
+
+uint8_t Ftl_t::IPlace(uint8_t Block, const uint32_t *Ptr) {
+    uint8_t Page;
+    uint8_t Rslt = IAllocPage(&Page);
+    if(Rslt != retvOk) return Rslt;
+    if(IFlashProgram(DataAddr(Page), Ptr, FLASH_PAGE_SIZE) != retvOk) {
+        PState[Page] = fpsStale;
+        return retvFail;
+    }
+    if(IAppendRecord(Block, Page) != retvOk) {
+        PState[Page] = fpsStale;
+        return retvFail;
+    }
+    uint8_t OldPage = Map[Block];
+    Map[Block] = Page;
+    PState[Page] = fpsUsed;
+    if(OldPage != FTL_NO_PAGE) PState[OldPage] = fpsStale;
+    return retvOk;
+}
+
+// Static wear levelling: move block sitting on least worn page to most worn free page
+bool Ftl_t::IWearLevel() {
+    uint32_t Cold = FTL_NO_PAGE, Worn = FTL_NO_PAGE;
+    for(uint32_t i=0; i<FTL_DATA_PAGE_CNT; i++) {
+        if(PState[i] == fpsUsed) {
+            if(Cold == FTL_NO_PAGE or EraseCnt[i] < EraseCnt[Cold]) Cold = i;
+        }
+        else if(PState[i] == fpsFree) {
+            if(Worn == FTL_NO_PAGE or EraseCnt[i] > EraseCnt[Worn]) Worn = i;
+        }
+    }
+    if(Cold == FTL_NO_PAGE or Worn == FTL_NO_PAGE) return false;
+    if((EraseCnt[Worn] - EraseCnt[Cold]) <= FTL_WL_THRESHOLD) return false;
+    uint32_t Block;
+    for(Block=0; Block<MSD_BLOCK_CNT; Block++) if(Map[Block] == Cold) break;
+    if(Block >= MSD_BLOCK_CNT) return false;
+    if(IFlashProgram(DataAddr(Worn), (const uint32_t*)DataAddr(Cold), FLASH_PAGE_SIZE) != retvOk) {
+        PState[Worn] = fpsStale;
+        return true;
+    }
+    if(IAppendRecord(Block, Worn) != retvOk) {
+        PState[Worn] = fpsStale;
+        return true;
+    }
+    Map[Block] = Worn;
+    PState[Worn] = fpsUsed;
+    PState[Cold] = fpsStale;
+    return true;
+}
+
+#if 1 // =============================== Public ================================
+uint8_t Ftl_t::Init() {
+    chSemObjectInit(&Lock, 1);
+    // Find latest committed meta page. Header or commit may be torn, or be
+    // left from interrupted erase: such page is not committed.
+    bool Found = false;
+    for(uint32_t i=0; i<FTL_META_PAGE_CNT; i++) {
+        uint32_t Hdr[2], Commit[2]; // Magic, Gen; CommitMagic, CommitGen
+        if(IFlashRead(Hdr, MetaAddr(i), sizeof(Hdr)) != retvOk) continue;
+        if(IFlashRead(Commit, MetaAddr(i) + offsetof(FtlSnapshot_t, CommitMagic), sizeof(Commit)) != retvOk) continue;
+        if(Hdr[0] == FTL_MAGIC and Commit[0] == FTL_COMMIT_MAGIC and Commit[1] == Hdr[1]) {
+            if(!Found or Hdr[1] > Gen) {
+                Found = true;
+                Gen = Hdr[1];
+                MetaIndx = i;
+            }
+        }
+    }
+    if(!Found) { // Not formatted: start with empty map
+        Printf("FTL: new map\r");
+        memset(Map, FTL_NO_PAGE, sizeof(Map));
+        memset(EraseCnt, 0, sizeof(EraseCnt));
+        MetaIndx = 0;
+        Gen = 0;
+        if(ICompact() != retvOk) return retvFail;
+    }
+    else if(ILoad() != retvOk) return retvFail;
+    // Classify data pages
+    for(uint32_t i=0; i<FTL_DATA_PAGE_CNT; i++) PState[i] = PageIsErased(DataAddr(i))? fpsFree : fpsStale;
+    for(uint32_t i=0; i<MSD_BLOCK_CNT; i++) {
+        if(Map[i] >= FTL_DATA_PAGE_CNT) Map[i] = FTL_NO_PAGE;
+        else PState[Map[i]] = fpsUsed;
+    }
+    Printf("FTL: gen %u, free %u, stale %u\r", Gen, FreeCnt(), StaleCnt());
+    // Background erasing
+    if(PGcThd == nullptr) PGcThd = chThdCreateStatic(waFtlGcThread, sizeof(waFtlGcThread), LOWPRIO, (tfunc_t)FtlGcThread, NULL);
+    chEvtSignal(PGcThd, EVT_FTL_GC);
+    return retvOk;
+}
+
+uint8_t Ftl_t::Read(uint32_t BlockAddress, uint32_t *Ptr, uint32_t BlocksCnt) {
+    if((BlockAddress + BlocksCnt) > MSD_BLOCK_CNT) return retvFail;
+    chSemWait(&Lock);
+    while(BlocksCnt--) {
+        uint8_t Page = Map[BlockAddress++];
+        if(Page == FTL_NO_PAGE) memset(Ptr, 0xFF, FLASH_PAGE_SIZE);
+        else memcpy(Ptr, (const void*)DataAddr(Page), FLASH_PAGE_SIZE);
+        Ptr += FLASH_PAGE_SIZE / sizeof(uint32_t);
+    }
+    chSemSignal(&Lock);
+    return retvOk;
+}
+
+uint8_t Ftl_t::Write(uint32_t BlockAddress, uint32_t *Ptr, uint32_t BlocksCnt) {
+    if((BlockAddress + BlocksCnt) > MSD_BLOCK_CNT) return retvFail;
+    uint8_t Rslt = retvOk;
+    chSemWait(&Lock);
+    while(BlocksCnt--) {
+        Rslt = IPlace(BlockAddress++, Ptr);
+        if(Rslt != retvOk) {
+            Printf("FTL: wr fail %u\r", Rslt);
+            break;
+        }
+        Ptr += FLASH_PAGE_SIZE / sizeof(uint32_t);
+    }
+    chSemSignal(&Lock);
+    if(PGcThd) chEvtSignal(PGcThd, EVT_FTL_GC);
+    return Rslt;
+}
+
+bool Ftl_t::CollectGarbage() {
+    bool WorkDone = false;
+    chSemWait(&Lock);
+    for(uint32_t i=0; i<FTL_DATA_PAGE_CNT; i++) {
+        if(PState[i] == fpsStale) {
+            WorkDone = (IEraseData(i) == retvOk);
+            break;
+        }
+    }
+    if(!WorkDone) WorkDone = IWearLevel();
+    chSemSignal(&Lock);
+    return WorkDone;
+}
+
+uint32_t Ftl_t::FreeCnt() {
+    uint32_t N = 0;
+    for(uint32_t i=0; i<FTL_DATA_PAGE_CNT; i++) if(PState[i] == fpsFree) N++;
+    return N;
+}
+
+uint32_t Ftl_t::StaleCnt() {
+    uint32_t N = 0;
+    for(uint32_t i=0; i<FTL_DATA_PAGE_CNT; i++) if(PState[i] == fpsStale) N++;
+    return N;
+}
+#endif
+
+#endif // MSD_USE_FTL
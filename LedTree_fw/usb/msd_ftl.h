@@ -0,0 +1,77 @@
+/*
+ * msd_ftl.h
+ *
+ *  Created on: 19 10 2026
+ *      Author: agent
+ */
+
+#pragma once
+
+#include "mem_msd_glue.h"
+
+#if MSD_USE_INNER_FLASH && MSD_USE_FTL
+/* EXPERIMENTAL: BootL476 reads the disk as plain FAT without translation,
+ * so firmware update from disk does not work with FTL on. Not for release
+ * builds until the bootloader reads the disk through the FTL.
+ *
+ * Page-mapped log-structured translation layer over inner flash.
+ * Every logical block may live in any data page. Write programs the block to
+ * a pre-erased page with the lowest erase count and appends a map record to
+ * the meta page; superseded page becomes stale and is erased later by
+ * low-priority thread. So write costs program time only.
+ *
+ * Meta page: Header | Map snapshot | Erase counters | Commit | Records...
+ * Snapshot is valid only when its Commit is written, so a power loss during
+ * compaction leaves previous meta page in charge. Torn records are skipped.
+ * Torn double word may fail ECC check, so meta page and pages being
+ * classified are read with Flash::ReadChecked.
+ * Data page programmed but not yet recorded is unreferenced and will be
+ * erased as stale on next mount.
+ */
+
+#define FTL_PAGE_CNT        (MSD_STORAGE_SZ_BYTES / FLASH_PAGE_SIZE)
+#define FTL_DATA_PAGE_CNT   (FTL_PAGE_CNT - FTL_META_PAGE_CNT)
+#define FTL_NO_PAGE         0xFF
+// Move cold block to worn page when erase counts differ more than this
+#define FTL_WL_THRESHOLD    99
+
+struct FtlSnapshot_t {
+    uint32_t Magic, Gen;
+    uint8_t Map[((MSD_BLOCK_CNT + 7) / 8) * 8];
+    uint16_t EraseCnt[((FTL_DATA_PAGE_CNT + 3) / 4) * 4];
+    uint32_t CommitMagic, CommitGen;
+} __attribute__((aligned(8)));
+
+struct FtlRecord_t {
+    uint8_t Tag, Block, Page, Rsv;
+    uint32_t Check; // Inverted first word
+} __attribute__((packed));
+
+enum FtlPageState_t {fpsFree, fpsUsed, fpsStale};
+
+class Ftl_t {
+private:
+    uint8_t Map[MSD_BLOCK_CNT];
+    uint8_t PState[FTL_DATA_PAGE_CNT];
+    uint16_t EraseCnt[FTL_DATA_PAGE_CNT];
+    uint32_t MetaIndx = 0, Gen = 0, RecOffset = 0;
+    semaphore_t Lock;
+    uint8_t ILoad();
+    uint8_t ICompact();
+    uint8_t IAppendRecord(uint8_t Block, uint8_t Page);
+    uint8_t IEraseData(uint8_t Page);
+    uint8_t IAllocPage(uint8_t *PPage);
+    uint8_t IPlace(uint8_t Block, const uint32_t *Ptr);
+    bool IWearLevel();
+public:
+    uint8_t Init();
+    uint8_t Read(uint32_t BlockAddress, uint32_t *Ptr, uint32_t BlocksCnt);
+    uint8_t Write(uint32_t BlockAddress, uint32_t *Ptr, uint32_t BlocksCnt);
+    // Erase one stale page or move one cold block. Returns false if nothing to do.
+    bool CollectGarbage();
+    uint32_t FreeCnt();
+    uint32_t StaleCnt();
+};
+
+extern Ftl_t Ftl;
+#endif
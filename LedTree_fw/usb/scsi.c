@@ -43,3 +43,13 @@ const uint8_t Mode_Sense6_data[MODE_SENSE6_DATA_SZ] = {
     0x00,
     0x00
 };
+
+// Caching mode page; WCE bit is set at runtime if write cache is enabled
+const uint8_t Mode_Sense6_CachingPage[MODE_SENSE6_CACHING_PAGE_SZ] = {
+    0x08,   // Page code
+    0x12,   // Page length
+    0x00,   // WCE, RCD etc.
+    0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00
+};
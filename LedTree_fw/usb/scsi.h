@@ -75,7 +75,12 @@ extern const SCSI_InquiryResponse_t InquiryData;
 #define PAGE0_INQUIRY_DATA_SZ   7
 extern const uint8_t Page00InquiryData[PAGE0_INQUIRY_DATA_SZ];
 #define MODE_SENSE6_DATA_SZ     8
+#define MODE_SENSE6_HDR_SZ      4
 extern const uint8_t Mode_Sense6_data[MODE_SENSE6_DATA_SZ];
+#define MODE_SENSE6_CACHING_PAGE_SZ 20
+extern const uint8_t Mode_Sense6_CachingPage[MODE_SENSE6_CACHING_PAGE_SZ];
+#define SCSI_MODE_PAGE_CACHING  0x08
+#define SCSI_MODE_PAGE_ALL      0x3F
 /** Magic signature for a Command Status Wrapper used in the Mass Storage Bulk-Only transport protocol. */
 #define MS_CSW_SIGNATURE                               0x53425355UL
 
@@ -138,6 +143,8 @@ extern const uint8_t Mode_Sense6_data[MODE_SENSE6_DATA_SZ];
 #if 1 // ==== SCSI Additional Sense Codes ====
 /** SCSI Additional Sense Code to indicate no additional sense information is available. */
 #define SCSI_ASENSE_NO_ADDITIONAL_INFORMATION          0x00
+/** SCSI Additional Sense Code to indicate that a write to the medium has failed. */
+#define SCSI_ASENSE_WRITE_FAULT                        0x03
 /** SCSI Additional Sense Code to indicate that the logical unit (LUN) addressed is not ready. */
 #define SCSI_ASENSE_LOGICAL_UNIT_NOT_READY             0x04
 /** SCSI Additional Sense Code to indicate an invalid field was encountered while processing the issued command. */
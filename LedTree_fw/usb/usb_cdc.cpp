@@ -0,0 +1,175 @@
+/*
+ * usb_cdc.cpp
+ *
+ *  Created on: 19 10 2026
+ *      Author: agent
+ */
+
+#include "usb_cdc.h"
+#include "descriptors_msd.h"
+#include "hal_usb_cdc.h"
+#include "kl_usb_defins.h"
+#include "MsgQ.h"
+#include "EvtMsgIDs.h"
+
+UsbCdc_t UsbCdc;
+static SerialUSBDriver SDU1;
+
+static const SerialUSBConfig SerUsbCfg = {
+    &USBD1,                 // USB driver, same as MSD one
+    EP_CDC_DATA_IN_ID,
+    EP_CDC_DATA_OUT_ID,
+    EP_CDC_INTERRUPT_ID
+};
+
+#if 1 // ========================== Endpoints ==================================
+// ==== EP2: data ====
+static USBInEndpointState ep2instate;
+static USBOutEndpointState ep2outstate;
+
+static const USBEndpointConfig ep2config = {
+    USB_EP_MODE_TYPE_BULK,
+    NULL,                   // setup_cb
+    sduDataTransmitted,     // in_cb
+    sduDataReceived,        // out_cb
+    EP_BULK_SZ,             // in_maxsize
+    EP_BULK_SZ,             // out_maxsize
+    &ep2instate,            // in_state
+    &ep2outstate,           // out_state
+    2,                      // in_multiplier
+    NULL                    // setup_buf
+};
+
+// ==== EP3: notifications ====
+static USBInEndpointState ep3instate;
+
+static const USBEndpointConfig ep3config = {
+    USB_EP_MODE_TYPE_INTR,
+    NULL,                   // setup_cb
+    sduInterruptTransmitted,// in_cb
+    NULL,                   // out_cb
+    EP_INTERRUPT_SZ,        // in_maxsize
+    0,                      // out_maxsize
+    &ep3instate,            // in_state
+    NULL,                   // out_state
+    1,                      // in_multiplier
+    NULL                    // setup_buf
+};
+#endif
+
+#if 1 // ============================ Hooks ====================================
+void UsbCdc_t::OnConfiguredI(USBDriver *usbp) {
+    usbInitEndpointI(usbp, EP_CDC_DATA_IN_ID, &ep2config);
+    usbInitEndpointI(usbp, EP_CDC_INTERRUPT_ID, &ep3config);
+    sduConfigureHookI(&SDU1);
+    IsConfigured = true;
+}
+
+void UsbCdc_t::OnSuspendI() {
+    IsConfigured = false;
+    DtrIsOn = false;
+    sduSuspendHookI(&SDU1);
+}
+
+void UsbCdc_t::OnWakeupI() {
+    sduWakeupHookI(&SDU1);
+}
+
+void UsbCdc_t::OnSofI() {
+    sduSOFHookI(&SDU1);
+}
+
+// Terminal sets DTR when it opens the port
+bool UsbCdc_t::OnSetupPkt(USBDriver *usbp) {
+    SetupPkt_t *Setup = (SetupPkt_t*)usbp->setup;
+    if(Setup->ReqType.Type == TYPE_CLASS and
+       Setup->ReqType.Recipient == RCPT_INTERFACE and
+       Setup->bRequest == CDC_SET_CONTROL_LINE_STATE)
+    {
+        DtrIsOn = Setup->wValue & 0x01;
+    }
+    return sduRequestsHook(usbp);
+}
+#endif
+
+#if 1 // ============================ Output ===================================
+uint8_t UsbCdc_t::IPutChar(char c) {
+    if(TxStalled) return retvFail;
+    if(chnPutTimeout(&SDU1, c, TIME_MS2I(CDC_TX_TIMEOUT_MS)) != MSG_OK) {
+        TxStalled = true;
+        return retvFail;
+    }
+    return retvOk;
+}
+
+uint8_t UsbCdc_t::IPutStr(const char *S, uint32_t Len) {
+    if(TxStalled) return retvFail;
+    if(chnWriteTimeout(&SDU1, (const uint8_t*)S, Len, TIME_MS2I(CDC_TX_TIMEOUT_MS)) != Len) {
+        TxStalled = true;
+        return retvFail;
+    }
+    return retvOk;
+}
+
+void UsbCdc_t::Print(const char *format, ...) {
+    va_list args;
+    va_start(args, format);
+    IPrint(format, args);
+    va_end(args);
+}
+
+// Thread context only: Printf may be called from any thread, so output is serialized
+void UsbCdc_t::IPrint(const char *format, va_list args) {
+    if(!IsActive()) return;
+    chBSemWait(&TxLock);
+    TxStalled = false;
+    IVsPrintf(format, args);
+    chBSemSignal(&TxLock);
+}
+
+uint8_t UsbCdc_t::SendBinary(const uint8_t *PData, uint32_t Len) {
+    if(!IsActive()) return retvFail;
+    chBSemWait(&TxLock);
+    uint8_t Rslt = (chnWriteTimeout(&SDU1, PData, Len, TIME_MS2I(CDC_TX_TIMEOUT_MS)) == Len)? retvOk : retvTimeout;
+    chBSemSignal(&TxLock);
+    return Rslt;
+}
+#endif
+
+#if 1 // ============================ Input ====================================
+static THD_WORKING_AREA(waCdcThd, 256);
+static THD_FUNCTION(CdcThd, arg) {
+    chRegSetThreadName("Cdc");
+    UsbCdc.ITask();
+}
+
+__noreturn
+void UsbCdc_t::ITask() {
+    while(true) {
+        // Wait for first byte, then take all that already arrived
+        msg_t b = chnGetTimeout(&SDU1, TIME_INFINITE);
+        if(b < MSG_OK) { // Queue is suspended: not connected
+            chThdSleepMilliseconds(99);
+            continue;
+        }
+        IRxBuf[0] = (uint8_t)b;
+        uint32_t Cnt = 1 + chnReadTimeout(&SDU1, &IRxBuf[1], CDC_RXBUF_SZ - 1, TIME_IMMEDIATE);
+        for(uint32_t i=0; i<Cnt; i++) {
+            ftShellRawRx PRawRx = RawRx;
+            if(PRawRx != nullptr) PRawRx(IRxBuf[i]);
+            else if(Cmd.PutChar(IRxBuf[i]) == pdrNewCmd) {
+                EvtQMain.SendNowOrExit(EvtMsg_t(evtIdShellCmd, (Shell_t*)this));
+                chBSemWait(&CmdProcessed); // Cmd is in use until main thread is done with it
+            }
+        }
+    } // while true
+}
+#endif
+
+void UsbCdc_t::Init() {
+    chBSemObjectInit(&TxLock, false);
+    chBSemObjectInit(&CmdProcessed, true);
+    sduObjectInit(&SDU1);
+    sduStart(&SDU1, &SerUsbCfg);
+    chThdCreateStatic(waCdcThd, sizeof(waCdcThd), NORMALPRIO, (tfunc_t)CdcThd, NULL);
+}
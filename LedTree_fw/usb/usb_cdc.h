@@ -0,0 +1,46 @@
+/*
+ * usb_cdc.h
+ *
+ *  Created on: 19 10 2026
+ *      Author: agent
+ */
+
+#pragma once
+
+#include "hal.h"
+#include "shell.h"
+
+/* Virtual COM port: second function of composite USB device, see usb_msd.cpp.
+ * Commands are dispatched to OnCmd the same way as Uart ones; Printf output is
+ * mirrored here while terminal is open (DTR set). */
+
+#define CDC_TX_TIMEOUT_MS   9   // Drop rest of output if host does not read
+#define CDC_RXBUF_SZ        64
+
+class UsbCdc_t : public PrintfHelper_t, public Shell_t {
+private:
+    volatile bool IsConfigured = false, DtrIsOn = false;
+    bool TxStalled = false;
+    binary_semaphore_t TxLock, CmdProcessed;
+    uint8_t IRxBuf[CDC_RXBUF_SZ];
+    uint8_t IPutChar(char c);
+    uint8_t IPutStr(const char *S, uint32_t Len);
+    void IStartTransmissionIfNotYet() {} // SOF hook flushes partially filled buffer
+public:
+    void Init();
+    bool IsActive() { return IsConfigured and DtrIsOn; }
+    void Print(const char *format, ...);
+    void IPrint(const char *format, va_list args);
+    uint8_t SendBinary(const uint8_t *PData, uint32_t Len);
+    void SignalCmdProcessed() { chBSemSignal(&CmdProcessed); }
+    // Hooks of USB driver, called from usb_msd.cpp
+    void OnConfiguredI(USBDriver *usbp);
+    void OnSuspendI();
+    void OnWakeupI();
+    void OnSofI();
+    bool OnSetupPkt(USBDriver *usbp);
+    // Inner use
+    void ITask();
+};
+
+extern UsbCdc_t UsbCdc;
@@ -15,6 +15,11 @@
 #include "MsgQ.h"
 #include "EvtMsgIDs.h"
 #include "shell.h"
+#include "shell_cmd.h"
+#include "msd_cache.h"
+#include "usb_cdc.h"
+#include "dlog.h"
+#include "kl_trace.h"
 
 UsbMsd_t UsbMsd;
 #define USBDrv          USBD1   // USB driver to use
@@ -30,6 +35,11 @@ UsbMsd_t UsbMsd;
 static uint8_t SByte;
 static bool ISayIsReady = true;
 static thread_t *PMsdThd;
+#if MSD_WRITE_CACHE_EN
+static binary_semaphore_t FlushedSem; // Signaled when cache is flushed on disconnect
+static systime_t LastWrite;            // Idle flush is timed from last WRITE(10)
+static bool DeferredWrFault = false;   // Background flush failed, not reported yet
+#endif
 
 static bool OnSetupPkt(USBDriver *usbp);
 static void OnDataInCompleted(USBDriver *usbp, usbep_t ep);
@@ -59,10 +69,15 @@ static const USBEndpointConfig ep1config = {
 static void usb_event(USBDriver *usbp, usbevent_t event) {
     switch (event) {
         case USB_EVENT_RESET:
-            PrintfI("UsbRst\r");
+            chSysLockFromISR();
+            DLogI("UsbRst\r");
+            UsbCdc.OnSuspendI();
+            chSysUnlockFromISR();
             return;
         case USB_EVENT_ADDRESS:
-            PrintfI("UsbAddr\r");
+            chSysLockFromISR();
+            DLogI("UsbAddr\r");
+            chSysUnlockFromISR();
             return;
         case USB_EVENT_CONFIGURED: {
             chSysLockFromISR();
@@ -70,6 +85,7 @@ static void usb_event(USBDriver *usbp, usbevent_t event) {
             Note, this callback is invoked from an ISR so I-Class functions must be used.*/
             usbInitEndpointI(usbp, EP_MSD_IN_ID,  &ep1config);
             usbInitEndpointI(usbp, EP_MSD_OUT_ID, &ep1config);
+            UsbCdc.OnConfiguredI(usbp);
             ISayIsReady = true;
             EvtMsg_t Msg(evtIdUsbReady);
             EvtQMain.SendNowOrExitI(Msg);    // Signal to main thread
@@ -78,20 +94,40 @@ static void usb_event(USBDriver *usbp, usbevent_t event) {
             return;
         } break;
         case USB_EVENT_SUSPEND:
+            chSysLockFromISR();
+            chEvtSignalI(PMsdThd, EVT_USB_SUSPEND);
+            UsbCdc.OnSuspendI();
+            chSysUnlockFromISR();
+            return;
         case USB_EVENT_WAKEUP:
-        case USB_EVENT_STALLED:
+            chSysLockFromISR();
+            UsbCdc.OnWakeupI();
+            chSysUnlockFromISR();
+            return;
         case USB_EVENT_UNCONFIGURED:
+            chSysLockFromISR();
+            UsbCdc.OnSuspendI();
+            chSysUnlockFromISR();
+            return;
+        case USB_EVENT_STALLED:
             return;
     } // switch
 }
 #endif
 
+// Flushes partially filled CDC output buffer every frame
+static void OnSof(USBDriver *usbp) {
+    chSysLockFromISR();
+    UsbCdc.OnSofI();
+    chSysUnlockFromISR();
+}
+
 #if 1  // ==== USB driver configuration ====
 const USBConfig UsbCfg = {
     usb_event,          // This callback is invoked when an USB driver event is registered
     GetDescriptor,      // Device GET_DESCRIPTOR request callback
     OnSetupPkt,         // This hook allows to be notified of standard requests or to handle non standard requests
-    NULL                // Start Of Frame callback
+    OnSof               // Start Of Frame callback
 };
 #endif
 
@@ -125,7 +161,7 @@ bool OnSetupPkt(USBDriver *usbp) {
         return true; // Acknowledge reception
     }
 
-    return false;
+    return UsbCdc.OnSetupPkt(usbp); // CDC class requests
 }
 
 void OnDataInCompleted(USBDriver *usbp, usbep_t ep) {
@@ -149,7 +185,14 @@ static MS_CommandStatusWrapper_t CmdStatus;
 static SCSI_RequestSenseResponse_t SenseData;
 static SCSI_ReadCapacity10Response_t ReadCapacity10Response;
 static SCSI_ReadFormatCapacitiesResponse_t ReadFormatCapacitiesResponse;
-static uint32_t Buf32[(MSD_DATABUF_SZ/4)];
+#if MSD_STORAGE_IS_MAPPED
+// Reads go straight from memory, buffer is needed for writes only
+#define MSD_BUF_CNT     1
+#else
+// Two buffers: one is on the bus while the other is being filled
+#define MSD_BUF_CNT     2
+#endif
+static uint32_t Buf32[MSD_BUF_CNT][(MSD_DATABUF_SZ/4)];
 
 static void SCSICmdHandler();
 // Scsi commands
@@ -163,28 +206,54 @@ static uint8_t CmdReadFormatCapacities();
 static uint8_t CmdRead10();
 static uint8_t CmdWrite10();
 static uint8_t CmdModeSense6();
+static uint8_t CmdSyncCache10();
 static uint8_t ReadWriteCommon(uint32_t *PAddr, uint16_t *PLen);
-static void BusyWaitIN();
+static uint8_t BusyWaitIN();
 static uint8_t BusyWaitOUT();
+static void StartReceiveCmd();
+static void DrainOut(uint32_t Len);
 
-static THD_WORKING_AREA(waUsbThd, 256);
+static THD_WORKING_AREA(waUsbThd, 512);
 static THD_FUNCTION(UsbThd, arg) {
     chRegSetThreadName("Usb");
     while(true) {
+#if MSD_WRITE_CACHE_EN
+        // Other traffic (reads, TEST UNIT READY polling) must not postpone idle flush
+        sysinterval_t Timeout = TIME_INFINITE;
+        if(MsdCache.IsDirty()) {
+            sysinterval_t Elapsed = chVTTimeElapsedSinceX(LastWrite);
+            Timeout = (Elapsed >= TIME_MS2I(MSD_CACHE_IDLE_FLUSH_MS))? TIME_IMMEDIATE : (TIME_MS2I(MSD_CACHE_IDLE_FLUSH_MS) - Elapsed);
+        }
+        uint32_t EvtMsk = chEvtWaitAnyTimeout(ALL_EVENTS, Timeout);
+        // Write cached blocks out when host stopped writing, suspended or gone
+        bool WrIdle = MsdCache.IsDirty() and chVTTimeElapsedSinceX(LastWrite) >= TIME_MS2I(MSD_CACHE_IDLE_FLUSH_MS);
+        if(WrIdle or (EvtMsk & (EVT_USB_SUSPEND | EVT_USB_DISCONNECTED))) {
+            if(MsdCache.Flush() == retvOk) DeferredWrFault = false;
+            else {
+                DeferredWrFault = true;
+                LastWrite = chVTGetSystemTimeX(); // Retry after next idle period
+            }
+        }
+        if(EvtMsk & EVT_USB_DISCONNECTED) {
+            chBSemSignal(&FlushedSem);
+            continue;
+        }
+#else
         uint32_t EvtMsk = chEvtWaitAny(ALL_EVENTS);
+#endif
         if(EvtMsk & EVT_USB_READY) {
-            // Receive header
-            chSysLock();
-            usbStartReceiveI(&USBDrv, EP_MSD_OUT_ID, (uint8_t*)&CmdBlock, MS_CMD_SZ);
-            chSysUnlock();
+            StartReceiveCmd(); // Receive header
         }
 
         if(EvtMsk & EVT_USB_OUT_DONE) {
+            systime_t Start = chVTGetSystemTimeX();
+            TRACE_USER(trcMsdCmd, CmdBlock.SCSICmdData[0]);
             SCSICmdHandler();
-            // Receive header again
-            chSysLock();
-            usbStartReceiveI(&USBDrv, EP_MSD_OUT_ID, (uint8_t*)&CmdBlock, MS_CMD_SZ);
-            chSysUnlock();
+            TRACE_USER(trcMsdCmdEnd, CmdBlock.SCSICmdData[0]);
+            uint32_t Time_st = chVTTimeElapsedSinceX(Start);
+            UsbMsd.Stat.AddCmd(CmdBlock.SCSICmdData[0], (CmdStatus.Status != SCSI_STATUS_OK), Time_st);
+            UsbMsd.Trace.Put(CmdBlock.SCSICmdData, CmdStatus.Status, Time_st);
+            StartReceiveCmd(); // Receive header again
         }
     } // while true
 }
@@ -206,11 +275,31 @@ void UsbMsd_t::Init() {
     // Variables
     SenseData.ResponseCode = 0x70;
     SenseData.AddSenseLen = 0x0A;
+    Stat.Reset();
+#if MSD_WRITE_CACHE_EN
+    chBSemObjectInit(&FlushedSem, true);
+#endif
     // Thread
     PMsdThd = chThdCreateStatic(waUsbThd, sizeof(waUsbThd), NORMALPRIO, (tfunc_t)UsbThd, NULL);
     usbInit();
 }
 
+void MsdStat_t::AddCmd(uint8_t Opcode, bool Failed, uint32_t Time_st) {
+    for(MsdCmdStat_t &C : Cmd) {
+        // Take slot of this opcode or first unused one; others are not counted
+        if(C.Cnt == 0) {
+            C.Opcode = Opcode;
+            C.Fails = 0;
+            C.Time_st = 0;
+        }
+        else if(C.Opcode != Opcode) continue;
+        C.Cnt++;
+        if(Failed) C.Fails++;
+        C.Time_st += Time_st;
+        return;
+    }
+}
+
 void UsbMsd_t::Reset() {
     // Wake thread if sleeping
     chSysLock();
@@ -227,24 +316,56 @@ void UsbMsd_t::Connect() {
 void UsbMsd_t::Disconnect() {
     usbDisconnectBus(&USBDrv);
     usbStop(&USBDrv);
+    chSysLock();
+    UsbCdc.OnSuspendI(); // Release threads waiting on CDC queues
+    chSchRescheduleS();
+    chSysUnlock();
+#if MSD_WRITE_CACHE_EN
+    // Wait until cached data is in memory: filesystem will be used right after
+    chBSemReset(&FlushedSem, true);
+    chEvtSignal(PMsdThd, EVT_USB_DISCONNECTED);
+    if(chBSemWaitTimeout(&FlushedSem, TIME_MS2I(2 * MSD_TIMEOUT_MS)) != MSG_OK) Printf("Cache flush timeout\r");
+#endif
+}
+
+/* Endpoints are gone after usbStop() or bus reset, and Disconnect() may
+ * come in the middle of command: then transfers are not started. */
+static inline bool EpIsUpI() {
+    usbstate_t State = usbGetDriverStateI(&USBDrv);
+    return (State == USB_ACTIVE or State == USB_SUSPENDED);
+}
+
+void StartReceiveCmd() {
+    chSysLock();
+    if(EpIsUpI()) usbStartReceiveI(&USBDrv, EP_MSD_OUT_ID, (uint8_t*)&CmdBlock, MS_CMD_SZ);
+    chSysUnlock();
 }
 
-void TransmitBuf(uint32_t *Ptr, uint32_t Len) {
+/* IN transfer which timed out is still on the endpoint until host takes it or
+ * resets the bus: new one is not started over it. */
+bool StartTransmitBuf(uint32_t *Ptr, uint32_t Len) {
     chSysLock();
-    usbStartTransmitI(&USBDrv, EP_MSD_IN_ID, (uint8_t*)Ptr, Len);
+    bool IsUp = EpIsUpI() and !usbGetTransmitStatusI(&USBDrv, EP_MSD_IN_ID);
+    if(IsUp) usbStartTransmitI(&USBDrv, EP_MSD_IN_ID, (uint8_t*)Ptr, Len);
     chSysUnlock();
-    BusyWaitIN();
+    return IsUp;
+}
+
+uint8_t TransmitBuf(uint32_t *Ptr, uint32_t Len) {
+    return StartTransmitBuf(Ptr, Len)? BusyWaitIN() : retvDisconnected;
 }
 
 uint8_t ReceiveToBuf(uint32_t *Ptr, uint32_t Len) {
     chSysLock();
-    usbStartReceiveI(&USBDrv, EP_MSD_IN_ID, (uint8_t*)Ptr, Len);
+    bool IsUp = EpIsUpI();
+    if(IsUp) usbStartReceiveI(&USBDrv, EP_MSD_IN_ID, (uint8_t*)Ptr, Len);
     chSysUnlock();
-    return BusyWaitOUT();
+    return IsUp? BusyWaitOUT() : retvDisconnected;
 }
 
-void BusyWaitIN() {
-    chEvtWaitAny(ALL_EVENTS);
+uint8_t BusyWaitIN() {
+    eventmask_t evt = chEvtWaitAnyTimeout(EVT_USB_IN_DONE, TIME_MS2I(MSD_TIMEOUT_MS));
+    return (evt == 0)? retvTimeout : retvOk;
 }
 
 uint8_t BusyWaitOUT() {
@@ -252,12 +373,31 @@ uint8_t BusyWaitOUT() {
     return (evt == 0)? retvTimeout : retvOk;
 }
 
+// Host sends OUT data of rejected command anyway: take it, or it is read as next CBW
+void DrainOut(uint32_t Len) {
+    while(Len != 0) {
+        uint32_t Sz = MIN_(Len, (uint32_t)MSD_DATABUF_SZ);
+        if(ReceiveToBuf(Buf32[0], Sz) != retvOk) return;
+        Len -= Sz;
+    }
+}
+
 #if 1 // =========================== SCSI ======================================
 //#define DBG_PRINT_CMD   TRUE
 void SCSICmdHandler() {
 //    Uart.Printf("Sgn=%X; Tag=%X; Len=%u; Flags=%X; LUN=%u; SLen=%u; SCmd=%A\r", CmdBlock.Signature, CmdBlock.Tag, CmdBlock.DataTransferLen, CmdBlock.Flags, CmdBlock.LUN, CmdBlock.SCSICmdLen, CmdBlock.SCSICmdData, CmdBlock.SCSICmdLen, ' ');
 //    Printf("SCmd=%A\r", CmdBlock.SCSICmdData, CmdBlock.SCSICmdLen, ' ');
     uint8_t CmdRslt = retvFail;
+#if MSD_WRITE_CACHE_EN
+    // Report failed background flush as deferred error on next command without data phase
+    if(DeferredWrFault and CmdBlock.DataTransferLen == 0) {
+        DeferredWrFault = false;
+        SenseData.SenseKey = SCSI_SENSE_KEY_MEDIUM_ERROR;
+        SenseData.AdditionalSenseCode = SCSI_ASENSE_WRITE_FAULT;
+        SenseData.AdditionalSenseQualifier = SCSI_ASENSEQ_NO_QUALIFIER;
+        goto SendStatus;
+    }
+#endif
     switch(CmdBlock.SCSICmdData[0]) {
         case SCSI_CMD_TEST_UNIT_READY:    CmdTestReady();     return; break;    // Will report itself
         case SCSI_CMD_START_STOP_UNIT:    CmdRslt = CmdStartStopUnit(); break;
@@ -269,21 +409,29 @@ void SCSICmdHandler() {
         case SCSI_CMD_WRITE_10:           CmdRslt = CmdWrite10(); break;
         case SCSI_CMD_READ_10:            CmdRslt = CmdRead10(); break;
         case SCSI_CMD_MODE_SENSE_6:       CmdRslt = CmdModeSense6(); break;
+        case SCSI_CMD_SYNCHRONIZE_CACHE_10: CmdRslt = CmdSyncCache10(); break;
         // These commands should just succeed, no handling required
         case SCSI_CMD_PREVENT_ALLOW_MEDIUM_REMOVAL:
         case SCSI_CMD_VERIFY_10:
-        case SCSI_CMD_SYNCHRONIZE_CACHE_10:
             CmdRslt = retvOk;
             CmdBlock.DataTransferLen = 0;
             break;
         default:
             Printf("MSCmd %X not supported\r", CmdBlock.SCSICmdData[0]);
+            if(!(CmdBlock.Flags & 0x80)) DrainOut(CmdBlock.DataTransferLen);
             // Update the SENSE key to reflect the invalid command
             SenseData.SenseKey = SCSI_SENSE_KEY_ILLEGAL_REQUEST;
             SenseData.AdditionalSenseCode = SCSI_ASENSE_INVALID_COMMAND;
             SenseData.AdditionalSenseQualifier = SCSI_ASENSEQ_NO_QUALIFIER;
             break;
     } // switch
+    /* Data phase failed: IN endpoint is busy or gone, so status cannot be sent.
+     * Host gets no CSW, times out and does reset recovery: phase error. */
+    if(CmdRslt == retvTimeout or CmdRslt == retvDisconnected) {
+        Printf("MSCmd %X: data phase aborted\r", CmdBlock.SCSICmdData[0]);
+        CmdStatus.Status = SCSI_STATUS_CHECK_CONDITION; // For statistics and trace
+        return;
+    }
     // Update Sense if command was successfully processed
     if(CmdRslt == retvOk) {
         SenseData.SenseKey = SCSI_SENSE_KEY_GOOD;
@@ -292,17 +440,12 @@ void SCSICmdHandler() {
     }
 
     // Send status
+    SendStatus:
     CmdStatus.Signature = MS_CSW_SIGNATURE;
     CmdStatus.Tag = CmdBlock.Tag;
-    if(CmdRslt == retvOk) {
-        CmdStatus.Status = SCSI_STATUS_OK;
-        // DataTransferLen decreased at cmd handlers
-        CmdStatus.DataTransferResidue = CmdBlock.DataTransferLen;
-    }
-    else {
-        CmdStatus.Status = SCSI_STATUS_CHECK_CONDITION;
-        CmdStatus.DataTransferResidue = 0;    // 0 or requested length?
-    }
+    CmdStatus.Status = (CmdRslt == retvOk)? SCSI_STATUS_OK : SCSI_STATUS_CHECK_CONDITION;
+    // Handlers decrease DataTransferLen by data actually processed
+    CmdStatus.DataTransferResidue = CmdBlock.DataTransferLen;
 
     // Stall if cmd failed and there is data to send
 //    bool ShouldSendStatus = true;
@@ -347,6 +490,16 @@ uint8_t CmdStartStopUnit() {
 #endif
     if((CmdBlock.SCSICmdData[4] & 0x03) == 0x02) {  // Eject
         ISayIsReady = false;
+#if MSD_WRITE_CACHE_EN
+        // Host removes the medium right after this: failed flush is the last chance to tell
+        DeferredWrFault = false;
+        if(MsdCache.Flush() != retvOk) {
+            SenseData.SenseKey = SCSI_SENSE_KEY_MEDIUM_ERROR;
+            SenseData.AdditionalSenseCode = SCSI_ASENSE_WRITE_FAULT;
+            SenseData.AdditionalSenseQualifier = SCSI_ASENSEQ_NO_QUALIFIER;
+            return retvFail;
+        }
+#endif
     }
     else if((CmdBlock.SCSICmdData[4] & 0x03) == 0x03) {  // Load
         ISayIsReady = true;
@@ -362,12 +515,12 @@ uint8_t CmdInquiry() {
     uint16_t BytesToTransfer;
     if(CmdBlock.SCSICmdData[1] & 0x01) { // Evpd is set
         BytesToTransfer = MIN_(RequestedLength, PAGE0_INQUIRY_DATA_SZ);
-        TransmitBuf((uint32_t*)&Page00InquiryData, BytesToTransfer);
+        if(TransmitBuf((uint32_t*)&Page00InquiryData, BytesToTransfer) != retvOk) return retvTimeout;
     }
     else {
         // Transmit InquiryData
         BytesToTransfer = MIN_(RequestedLength, sizeof(SCSI_InquiryResponse_t));
-        TransmitBuf((uint32_t*)&InquiryData, BytesToTransfer);
+        if(TransmitBuf((uint32_t*)&InquiryData, BytesToTransfer) != retvOk) return retvTimeout;
     }
     // Succeed the command and update the bytes transferred counter
     CmdBlock.DataTransferLen -= BytesToTransfer;
@@ -380,7 +533,7 @@ uint8_t CmdRequestSense() {
     uint16_t RequestedLength = CmdBlock.SCSICmdData[4];
     uint16_t BytesToTransfer = MIN_(RequestedLength, sizeof(SenseData));
     // Transmit SenceData
-    TransmitBuf((uint32_t*)&SenseData, BytesToTransfer);
+    if(TransmitBuf((uint32_t*)&SenseData, BytesToTransfer) != retvOk) return retvTimeout;
     // Succeed the command and update the bytes transferred counter
     CmdBlock.DataTransferLen -= BytesToTransfer;
     return retvOk;
@@ -392,7 +545,7 @@ uint8_t CmdReadCapacity10() {
     ReadCapacity10Response.LastBlockAddr = __REV((uint32_t)MSD_BLOCK_CNT - 1);
     ReadCapacity10Response.BlockSize = __REV((uint32_t)MSD_BLOCK_SZ);
     // Transmit SenceData
-    TransmitBuf((uint32_t*)&ReadCapacity10Response, sizeof(ReadCapacity10Response));
+    if(TransmitBuf((uint32_t*)&ReadCapacity10Response, sizeof(ReadCapacity10Response)) != retvOk) return retvTimeout;
     // Succeed the command and update the bytes transferred counter
     CmdBlock.DataTransferLen -= sizeof(ReadCapacity10Response);
     return retvOk;
@@ -415,7 +568,7 @@ uint8_t CmdReadFormatCapacities() {
     ReadFormatCapacitiesResponse.BlockSize[1] = (uint8_t)((uint32_t)MSD_BLOCK_SZ >> 8);
     ReadFormatCapacitiesResponse.BlockSize[2] = (uint8_t)((uint32_t)MSD_BLOCK_SZ);
     // Transmit Data
-    TransmitBuf((uint32_t*)&ReadFormatCapacitiesResponse, sizeof(ReadFormatCapacitiesResponse));
+    if(TransmitBuf((uint32_t*)&ReadFormatCapacitiesResponse, sizeof(ReadFormatCapacitiesResponse)) != retvOk) return retvTimeout;
     // Succeed the command and update the bytes transferred counter
     CmdBlock.DataTransferLen -= sizeof(ReadFormatCapacitiesResponse);
     return retvOk;
@@ -451,26 +604,66 @@ uint8_t CmdRead10() {
     uint32_t BlockAddress=0;
     uint16_t TotalBlocks=0;
     if(ReadWriteCommon(&BlockAddress, &TotalBlocks) != retvOk) return retvFail;
-    // ==== Send data ====
+    systime_t Start = chVTGetSystemTimeX();
     uint32_t BlocksToRead, BytesToSend; // Intermediate values
-    bool Rslt;
+#if MSD_STORAGE_IS_MAPPED
+    // ==== Send data: endpoint reads storage directly, no copying ====
+    while(TotalBlocks != 0) {
+#if MSD_WRITE_CACHE_EN
+        // Cached block is sent from cache, run of uncached ones from storage
+        uint32_t *PSrc = (uint32_t*)MsdCache.Get(BlockAddress);
+        if(PSrc != nullptr) BlocksToRead = 1;
+        else {
+            BlocksToRead = 1;
+            while(BlocksToRead < MIN_(MSD_ZEROCOPY_CHUNK_SZ / MSD_BLOCK_SZ, TotalBlocks) and
+                    MsdCache.Get(BlockAddress + BlocksToRead) == nullptr) BlocksToRead++;
+            PSrc = (uint32_t*)MSDGetPtr(BlockAddress);
+        }
+#else
+        BlocksToRead = MIN_(MSD_ZEROCOPY_CHUNK_SZ / MSD_BLOCK_SZ, TotalBlocks);
+        uint32_t *PSrc = (uint32_t*)MSDGetPtr(BlockAddress);
+#endif
+        BytesToSend = BlocksToRead * MSD_BLOCK_SZ;
+        if(PSrc == nullptr) {
+            Printf("Rd fail\r");
+            return retvFail;
+        }
+        if(TransmitBuf(PSrc, BytesToSend) != retvOk) return retvTimeout;
+        CmdBlock.DataTransferLen -= BytesToSend;
+        TotalBlocks  -= BlocksToRead;
+        BlockAddress += BlocksToRead;
+        UsbMsd.Stat.ReadBytes += BytesToSend;
+    } // while
+#else
+    // ==== Send data: read next chunk while previous one is on the bus ====
+    // Only built when storage is not mapped (MSD_USE_FTL or external memory)
+    uint32_t Indx = 0;
+    bool TxIsOngoing = false;
     while(TotalBlocks != 0) {
         BlocksToRead = MIN_(MSD_DATABUF_SZ / MSD_BLOCK_SZ, TotalBlocks);
         BytesToSend = BlocksToRead * MSD_BLOCK_SZ;
-        Rslt = MSDRead(BlockAddress, Buf32, BlocksToRead);
+        uint8_t Rslt = MSDRead(BlockAddress, Buf32[Indx], BlocksToRead);
+#if MSD_WRITE_CACHE_EN
+        if(Rslt == retvOk) MsdCache.Overlay(BlockAddress, Buf32[Indx], BlocksToRead);
+#endif
 //        Uart.Printf("%A\r", Buf, 50, ' ');
-        if(Rslt == retvOk) {
-            TransmitBuf(Buf32, BytesToSend);
-            CmdBlock.DataTransferLen -= BytesToSend;
-            TotalBlocks  -= BlocksToRead;
-            BlockAddress += BlocksToRead;
-        }
-        else {
+        if(TxIsOngoing and BusyWaitIN() != retvOk) return retvTimeout;
+        if(Rslt != retvOk) {
             Printf("Rd fail\r");
             // TODO: handle read error
             return retvFail;
         }
+        TxIsOngoing = StartTransmitBuf(Buf32[Indx], BytesToSend);
+        if(!TxIsOngoing) return retvDisconnected;
+        CmdBlock.DataTransferLen -= BytesToSend;
+        TotalBlocks  -= BlocksToRead;
+        BlockAddress += BlocksToRead;
+        UsbMsd.Stat.ReadBytes += BytesToSend;
+        Indx ^= 1;
     } // while
+    if(TxIsOngoing and BusyWaitIN() != retvOk) return retvTimeout;
+#endif
+    UsbMsd.Stat.ReadTime_st += chVTTimeElapsedSinceX(Start);
     return retvOk;
 }
 
@@ -499,29 +692,53 @@ uint8_t CmdWrite10() {
     uint32_t BlockAddress=0;
     uint16_t TotalBlocks=0;
     // Get transaction size
-    if(ReadWriteCommon(&BlockAddress, &TotalBlocks) != retvOk) return retvFail;
+    if(ReadWriteCommon(&BlockAddress, &TotalBlocks) != retvOk) {
+        DrainOut(CmdBlock.DataTransferLen);
+        return retvFail;
+    }
 //    Uart.Printf("Addr=%u; Len=%u\r", BlockAddress, TotalBlocks);
     uint32_t BlocksToWrite, BytesToReceive;
-    uint8_t Rslt = retvOk;
+    bool WriteFailed = false;
+    systime_t Start = chVTGetSystemTimeX();
 
     while(TotalBlocks != 0) {
-        // Fill Buf1
+        // Fill Buf. Flash erase and program hold the system lock (single bank),
+        // so reception cannot overlap them: one buffer is enough.
         BytesToReceive = MIN_(MSD_DATABUF_SZ, TotalBlocks * MSD_BLOCK_SZ);
         BlocksToWrite  = BytesToReceive / MSD_BLOCK_SZ;
-        if(ReceiveToBuf(Buf32, BytesToReceive) != retvOk) {
+        if(ReceiveToBuf(Buf32[0], BytesToReceive) != retvOk) {
             Printf("Rcv fail\r");
             return retvFail;
         }
-        // Write Buf to memory
-        Rslt = MSDWrite(BlockAddress, Buf32, BlocksToWrite);
-        if(Rslt != retvOk) {
-            Printf("Wr fail\r");
-            return retvFail;
+        // Write Buf to memory. After a failure, just drain the data phase.
+        if(!WriteFailed) {
+#if MSD_WRITE_CACHE_EN
+            uint8_t Rslt = MsdCache.Write(BlockAddress, Buf32[0], BlocksToWrite);
+#else
+            uint8_t Rslt = MSDWrite(BlockAddress, Buf32[0], BlocksToWrite);
+#endif
+            if(Rslt == retvOk) {
+                CmdBlock.DataTransferLen -= BytesToReceive;
+                UsbMsd.Stat.WriteBytes += BytesToReceive;
+            }
+            else {
+                Printf("Wr fail\r");
+                WriteFailed = true;
+            }
         }
-        CmdBlock.DataTransferLen -= BytesToReceive;
         TotalBlocks -= BlocksToWrite;
         BlockAddress += BlocksToWrite;
     } // while
+    UsbMsd.Stat.WriteTime_st += chVTTimeElapsedSinceX(Start);
+#if MSD_WRITE_CACHE_EN
+    LastWrite = chVTGetSystemTimeX();
+#endif
+    if(WriteFailed) {
+        SenseData.SenseKey = SCSI_SENSE_KEY_MEDIUM_ERROR;
+        SenseData.AdditionalSenseCode = SCSI_ASENSE_WRITE_FAULT;
+        SenseData.AdditionalSenseQualifier = SCSI_ASENSEQ_NO_QUALIFIER;
+        return retvFail;
+    }
     return retvOk;
 #endif
 }
@@ -531,10 +748,66 @@ uint8_t CmdModeSense6() {
     Printf("CmdModeSense6\r");
 #endif
     uint16_t RequestedLength = CmdBlock.SCSICmdData[4];
-    uint16_t BytesToTransfer = MIN_(RequestedLength, MODE_SENSE6_DATA_SZ);
-    TransmitBuf((uint32_t*)&Mode_Sense6_data, BytesToTransfer);
+    uint16_t DataSz = MODE_SENSE6_HDR_SZ;
+    uint8_t *PData = (uint8_t*)Buf32[0];
+    memcpy(PData, Mode_Sense6_data, MODE_SENSE6_DATA_SZ);
+    // Add caching page if it is requested directly or as part of all pages
+    uint8_t PageCode = CmdBlock.SCSICmdData[2] & 0x3F;
+    if(PageCode == SCSI_MODE_PAGE_CACHING or PageCode == SCSI_MODE_PAGE_ALL) {
+        memcpy(&PData[DataSz], Mode_Sense6_CachingPage, MODE_SENSE6_CACHING_PAGE_SZ);
+#if MSD_WRITE_CACHE_EN
+        PData[DataSz + 2] |= 0x04; // WCE: write cache enabled
+#endif
+        DataSz += MODE_SENSE6_CACHING_PAGE_SZ;
+    }
+    PData[0] = DataSz - 1; // Mode data length does not include itself
+    uint16_t BytesToTransfer = MIN_(RequestedLength, DataSz);
+    if(TransmitBuf(Buf32[0], BytesToTransfer) != retvOk) return retvTimeout;
     // Succeed the command and update the bytes transferred counter
     CmdBlock.DataTransferLen -= BytesToTransfer;
     return retvOk;
 }
+
+uint8_t CmdSyncCache10() {
+#if DBG_PRINT_CMD
+    Printf("CmdSyncCache10\r");
+#endif
+#if MSD_WRITE_CACHE_EN
+    DeferredWrFault = false; // Reported here if it persists
+    if(MsdCache.Flush() != retvOk) {
+        SenseData.SenseKey = SCSI_SENSE_KEY_MEDIUM_ERROR;
+        SenseData.AdditionalSenseCode = SCSI_ASENSE_WRITE_FAULT;
+        SenseData.AdditionalSenseQualifier = SCSI_ASENSEQ_NO_QUALIFIER;
+        return retvFail;
+    }
+#endif
+    return retvOk;
+}
+#endif
+
+#if 1 // ========================= Shell commands ==============================
+SHELL_CMD(MsdStat, "") {
+    MsdStat_t &Stat = UsbMsd.Stat;
+    uint32_t RdMs = TIME_I2MS(Stat.ReadTime_st), WrMs = TIME_I2MS(Stat.WriteTime_st);
+    PShell->Print("Rd: %u bytes, %u ms, %u KB/s\r", Stat.ReadBytes, RdMs, RdMs? (Stat.ReadBytes / RdMs) : 0);
+    PShell->Print("Wr: %u bytes, %u ms, %u KB/s\r", Stat.WriteBytes, WrMs, WrMs? (Stat.WriteBytes / WrMs) : 0);
+    for(MsdCmdStat_t &C : Stat.Cmd) {
+        if(C.Cnt == 0) break;
+        uint32_t Ms = TIME_I2MS(C.Time_st);
+        PShell->Print("Cmd %02X: %u, fails %u, %u ms, %u cmd/s\r", C.Opcode, C.Cnt, C.Fails, Ms, Ms? ((C.Cnt * 1000UL) / Ms) : 0);
+    }
+    Stat.Reset();
+#if MSD_WRITE_CACHE_EN
+    PShell->Print("Cache: hits %u, evictions %u, flushes %u\r", MsdCache.Hits, MsdCache.Evictions, MsdCache.Flushes);
+#endif
+}
+
+SHELL_CMD(MsdTrace, "") {
+    MsdTrace_t &Trace = UsbMsd.Trace;
+    uint32_t Cnt = MIN_(Trace.Cnt, (uint32_t)MSD_TRACE_DEPTH);
+    for(uint32_t i = Trace.Cnt - Cnt; i < Trace.Cnt; i++) {
+        MsdTraceRec_t &R = Trace.Rec[i % MSD_TRACE_DEPTH];
+        PShell->Print("%02X %u Lba %u Len %u %u us\r", R.Opcode, R.Status, R.Lba, R.Len, R.Time_st * (1000000UL / CH_CFG_ST_FREQUENCY));
+    }
+}
 #endif
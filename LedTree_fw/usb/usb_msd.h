@@ -45,10 +45,56 @@ struct MS_CommandStatusWrapper_t {
 #endif
 
 #define MSD_TIMEOUT_MS   2700
+#define MSD_WRITE_CACHE_EN  TRUE   // Write-back cache, see msd_cache.h
 #define MSD_DATABUF_SZ   4096
+// Zero-copy reads are split to keep within endpoint packet count limit
+#define MSD_ZEROCOPY_CHUNK_SZ   32768
+
+// Per-command counters: count, failures and time from CBW to CSW
+#define MSD_CMD_STAT_CNT    12  // Different opcodes to track
+struct MsdCmdStat_t {
+    uint8_t Opcode;
+    uint32_t Cnt, Fails, Time_st;
+};
+
+// Data phase throughput counters, time is in system ticks
+struct MsdStat_t {
+    uint32_t ReadBytes, ReadTime_st;
+    uint32_t WriteBytes, WriteTime_st;
+    MsdCmdStat_t Cmd[MSD_CMD_STAT_CNT];
+    void AddCmd(uint8_t Opcode, bool Failed, uint32_t Time_st);
+    void Reset() {
+        ReadBytes = 0; ReadTime_st = 0; WriteBytes = 0; WriteTime_st = 0;
+        for(MsdCmdStat_t &C : Cmd) C.Cnt = 0;
+    }
+};
+
+// Last commands received, to see what exactly host does
+#define MSD_TRACE_DEPTH     32
+struct MsdTraceRec_t {
+    uint8_t Opcode, Status;
+    uint16_t Len;       // Transfer length field of 10-byte command
+    uint32_t Lba;       // LBA field of 10-byte command
+    uint32_t Time_st;
+};
+
+struct MsdTrace_t {
+    MsdTraceRec_t Rec[MSD_TRACE_DEPTH];
+    uint32_t Cnt = 0;  // Total, Rec[Cnt % MSD_TRACE_DEPTH] is next to write
+    void Put(uint8_t *Cdb, uint8_t Status, uint32_t Time_st) {
+        MsdTraceRec_t &R = Rec[Cnt++ % MSD_TRACE_DEPTH];
+        R.Opcode = Cdb[0];
+        R.Status = Status;
+        R.Lba = ((uint32_t)Cdb[2] << 24) | ((uint32_t)Cdb[3] << 16) | ((uint32_t)Cdb[4] << 8) | Cdb[5];
+        R.Len = ((uint16_t)Cdb[7] << 8) | Cdb[8];
+        R.Time_st = Time_st;
+    }
+};
 
 class UsbMsd_t {
 public:
+    MsdStat_t Stat;
+    MsdTrace_t Trace;
     void Init();
     void Reset();
     void Connect();
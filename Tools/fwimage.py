@@ -0,0 +1,262 @@
+#!/usr/bin/env python3
+"""Firmware image tools for BootL476.
+
+Usage:
+    fwimage.py diff base.bin new.bin FwNew.dlt   # delta against image in flash
+    fwimage.py pack app.bin FwApp.fwz            # packed image
+    fwimage.py manifest app.bin 7 FwApp.bin      # append manifest of version 7
+    fwimage.py crc app.bin                       # CRC32 as bootloader computes it
+
+Manifest (see BootL476/FwCrc.h) holds image length, version and CRC32; its
+offset is put to reserved vector 7. Bootloader checks it by CRC unit before
+every jump to app. Add manifest first, then pack or diff the result.
+
+Packed image (see BootL476/FwPack.h) is LZ4 block format with match offset
+limited to bootloader window, so it is unpacked page by page with no more
+RAM than the window. It is checked by CRC before flash is touched.
+
+Delta (see BootL476/FwDelta.h) is applied by bootloader page by page over
+current image, so it has to be made against exactly the image in flash:
+bootloader checks CRC of base and refuses other one. Put it to the disk with
+name matching Fw*.dlt; full image Fw*.bin, if any, takes precedence.
+"""
+import struct
+import sys
+
+DELTA_MAGIC = 0x46444C4B
+RUN_HDR_SZ = 6      # Offset u32, Len u16
+RUN_MAX = 0xFFFF
+APP_MAX_SZ = 0x18000
+MANIFEST_MAGIC = 0x464D4B4C
+MANIFEST_PTR_OFFSET = 0x1C
+PACK_MAGIC = 0x5A504B4B
+PACK_WINDOW = 4096
+MIN_MATCH = 4
+CHAIN_MAX = 64
+
+
+def crc32(data):
+    """STM32 CRC unit defaults: poly 0x04C11DB7, init 0xFFFFFFFF, no reflection,
+    32-bit LE words, tail padded by 0xFF. Same as FwCrc32."""
+    data = bytes(data)
+    if len(data) % 4:
+        data += b'\xff' * (4 - len(data) % 4)
+    crc = 0xFFFFFFFF
+    for (word,) in struct.iter_unpack('<I', data):
+        crc ^= word
+        for _ in range(32):
+            crc = ((crc << 1) ^ 0x04C11DB7) if crc & 0x80000000 else (crc << 1)
+            crc &= 0xFFFFFFFF
+    return crc
+
+
+def diff_runs(base, new):
+    """(offset, length) of ranges to take from new image. Bytes beyond base are
+    unknown to bootloader, so they are always included. Runs closer than a run
+    header are merged."""
+    runs = []
+    i = 0
+    while i < len(new):
+        if i < len(base) and new[i] == base[i]:
+            i += 1
+            continue
+        start = i
+        while i < len(new) and (i >= len(base) or new[i] != base[i]):
+            i += 1
+        if runs and start - (runs[-1][0] + runs[-1][1]) <= RUN_HDR_SZ:
+            prev = runs.pop()
+            start = prev[0]
+        runs.append((start, i - start))
+    out = []
+    for offset, length in runs:
+        while length > 0:
+            n = min(length, RUN_MAX)
+            out.append((offset, n))
+            offset += n
+            length -= n
+    return out
+
+
+def make_delta(base, new):
+    runs = diff_runs(base, new)
+    out = bytearray(struct.pack('<5I', DELTA_MAGIC, len(base), crc32(base), len(new), crc32(new)))
+    for offset, length in runs:
+        out += struct.pack('<IH', offset, length) + new[offset:offset + length]
+    return bytes(out), runs
+
+
+def apply_delta(base, delta):
+    magic, base_len, base_crc, new_len, new_crc = struct.unpack_from('<5I', delta)
+    if magic != DELTA_MAGIC or base_len != len(base) or crc32(base) != base_crc:
+        raise ValueError('base mismatch')
+    img = bytearray(base[:new_len].ljust(new_len, b'\xff'))
+    pos = 20
+    while pos < len(delta):
+        offset, length = struct.unpack_from('<IH', delta, pos)
+        pos += RUN_HDR_SZ
+        img[offset:offset + length] = delta[pos:pos + length]
+        pos += length
+    if crc32(img) != new_crc:
+        raise ValueError('result mismatch')
+    return bytes(img)
+
+
+def _lz4_len(n):
+    out = bytearray()
+    while n >= 255:
+        out.append(255)
+        n -= 255
+    out.append(n)
+    return out
+
+
+def _sequence(literals, match_len, offset):
+    lit_n = len(literals)
+    token = min(lit_n, 15) << 4
+    if offset:
+        token |= min(match_len - MIN_MATCH, 15)
+    out = bytearray([token])
+    if lit_n >= 15:
+        out += _lz4_len(lit_n - 15)
+    out += literals
+    if offset:
+        out += struct.pack('<H', offset)
+        if match_len - MIN_MATCH >= 15:
+            out += _lz4_len(match_len - MIN_MATCH - 15)
+    return out
+
+
+def pack(data, window=PACK_WINDOW):
+    """Greedy LZ4 with hash chains; offsets do not exceed window."""
+    out = bytearray(struct.pack('<4I', PACK_MAGIC, len(data), crc32(data), window))
+    chains = {}
+    i = anchor = 0
+    n = len(data)
+    while i + MIN_MATCH <= n:
+        key = data[i:i + MIN_MATCH]
+        best_len = best_off = 0
+        for j in reversed(chains.get(key, ())):
+            if i - j > window:
+                break
+            length = MIN_MATCH
+            while i + length < n and data[j + length] == data[i + length]:
+                length += 1
+            if length > best_len:
+                best_len, best_off = length, i - j
+        chain = chains.setdefault(key, [])
+        chain.append(i)
+        if len(chain) > CHAIN_MAX:
+            del chain[0]
+        if best_len < MIN_MATCH:
+            i += 1
+            continue
+        out += _sequence(data[anchor:i], best_len, best_off)
+        for k in range(i + 1, min(i + best_len, n - MIN_MATCH + 1)):
+            c = chains.setdefault(data[k:k + MIN_MATCH], [])
+            c.append(k)
+            if len(c) > CHAIN_MAX:
+                del c[0]
+        i += best_len
+        anchor = i
+    if anchor < n or n == 0:
+        out += _sequence(data[anchor:], 0, 0)
+    return bytes(out)
+
+
+def unpack(packed):
+    magic, orig_len, orig_crc, window = struct.unpack_from('<4I', packed)
+    if magic != PACK_MAGIC:
+        raise ValueError('not a packed image')
+    out = bytearray()
+    pos = 16
+
+    def get_len(n):
+        nonlocal pos
+        if n == 15:
+            while True:
+                b = packed[pos]
+                pos += 1
+                n += b
+                if b != 255:
+                    break
+        return n
+
+    while len(out) < orig_len:
+        token = packed[pos]
+        pos += 1
+        lit_n = get_len(token >> 4)
+        out += packed[pos:pos + lit_n]
+        pos += lit_n
+        if len(out) >= orig_len:
+            break
+        offset = packed[pos] | (packed[pos + 1] << 8)
+        pos += 2
+        if offset == 0 or offset > window or offset > len(out):
+            raise ValueError('bad offset')
+        for _ in range(get_len(token & 15) + MIN_MATCH):
+            out.append(out[-offset])
+    if len(out) != orig_len or crc32(out) != orig_crc:
+        raise ValueError('result mismatch')
+    return bytes(out)
+
+
+def cmd_pack(in_name, out_name):
+    data = open(in_name, 'rb').read()
+    if len(data) > APP_MAX_SZ:
+        sys.exit('Image does not fit app area (%d bytes)' % APP_MAX_SZ)
+    packed = pack(data)
+    if unpack(packed) != data:
+        sys.exit('Self-check failed')
+    open(out_name, 'wb').write(packed)
+    sys.stderr.write('%d -> %d bytes, ratio %.2f, window %d\n' % (
+        len(data), len(packed), len(data) / len(packed), PACK_WINDOW))
+
+
+def add_manifest(data, version):
+    img = bytearray(data)
+    img += b'\xff' * (-len(img) % 8)
+    struct.pack_into('<I', img, MANIFEST_PTR_OFFSET, len(img))
+    img += struct.pack('<3I', MANIFEST_MAGIC, len(img), version)
+    img += struct.pack('<I', crc32(img))
+    return bytes(img)
+
+
+def cmd_manifest(in_name, version, out_name):
+    data = open(in_name, 'rb').read()
+    img = add_manifest(data, int(version, 0))
+    if len(img) > APP_MAX_SZ:
+        sys.exit('Image does not fit app area (%d bytes)' % APP_MAX_SZ)
+    open(out_name, 'wb').write(img)
+    sys.stderr.write('%d bytes + manifest: v%d, CRC %08X\n' % (len(img) - 16, int(version, 0), crc32(img[:-4])))
+
+
+def cmd_diff(base_name, new_name, out_name):
+    base = open(base_name, 'rb').read()
+    new = open(new_name, 'rb').read()
+    if len(base) > APP_MAX_SZ or len(new) > APP_MAX_SZ:
+        sys.exit('Image does not fit app area (%d bytes)' % APP_MAX_SZ)
+    delta, runs = make_delta(base, new)
+    if apply_delta(base, delta) != new:
+        sys.exit('Self-check failed')
+    open(out_name, 'wb').write(delta)
+    pages = {p for offset, length in runs for p in range(offset // 2048, (offset + length - 1) // 2048 + 1)}
+    sys.stderr.write('%d -> %d bytes: %d runs, %d changed bytes, %d pages; delta %d bytes (%.1f%% of image)\n' % (
+        len(base), len(new), len(runs), sum(r[1] for r in runs), len(pages), len(delta),
+        100.0 * len(delta) / max(len(new), 1)))
+
+
+def main():
+    if len(sys.argv) == 5 and sys.argv[1] == 'diff':
+        cmd_diff(*sys.argv[2:])
+    elif len(sys.argv) == 4 and sys.argv[1] == 'pack':
+        cmd_pack(*sys.argv[2:])
+    elif len(sys.argv) == 5 and sys.argv[1] == 'manifest':
+        cmd_manifest(*sys.argv[2:])
+    elif len(sys.argv) == 3 and sys.argv[1] == 'crc':
+        print('%08X' % crc32(open(sys.argv[2], 'rb').read()))
+    else:
+        sys.exit(__doc__)
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,93 @@
+#!/usr/bin/env python3
+"""Drive LedTree LEDs from host with binary frames (see LedTree_fw/LedStream.h).
+
+Usage:
+    ledstream.py /dev/ttyACM0 [fps] [seconds]     # needs pyserial
+    ledstream.py out.bin [fps] [seconds]          # write frames to file
+
+Sends shell command "Stream", then frames with a running wave, then stop frame.
+Firmware resumes its own profiles after stop frame or 1 s without frames.
+Counters are shown by "StreamStat" command.
+"""
+import math
+import struct
+import sys
+import time
+
+LED_CNT = 5
+FRAME_TYPE_VALUES = 0x01
+FRAME_TYPE_STOP = 0x02
+
+
+def cobs_encode(data):
+    out = bytearray()
+    block = bytearray()
+    for b in data:
+        if b == 0:
+            out.append(len(block) + 1)
+            out += block
+            block = bytearray()
+        else:
+            block.append(b)
+            if len(block) == 0xFE:
+                out.append(0xFF)
+                out += block
+                block = bytearray()
+    out.append(len(block) + 1)
+    out += block
+    return bytes(out)
+
+
+def crc16(data, crc=0xFFFF):
+    for b in data:
+        crc ^= b << 8
+        for _ in range(8):
+            crc = ((crc << 1) ^ 0x1021) if crc & 0x8000 else (crc << 1)
+            crc &= 0xFFFF
+    return crc
+
+
+def frame(ftype, seq, values):
+    body = struct.pack('<BBH%dB' % LED_CNT, ftype, LED_CNT, seq & 0xFFFF, *values)
+    return cobs_encode(body + struct.pack('<H', crc16(body))) + b'\x00'
+
+
+def open_dst(dst):
+    if dst.startswith('/dev/') or dst.upper().startswith('COM'):
+        import serial
+        port = serial.Serial(dst, 115200, timeout=1)
+        port.write(b'Stream\r')
+        reply = port.readline()
+        if not reply.startswith(b'Ack 0'):
+            sys.exit('No ack: %r' % reply)
+        return port
+    f = open(dst, 'wb')
+    f.write(b'Stream\r')
+    return f
+
+
+def main():
+    if len(sys.argv) < 2:
+        sys.exit(__doc__)
+    fps = float(sys.argv[2]) if len(sys.argv) > 2 else 100
+    seconds = float(sys.argv[3]) if len(sys.argv) > 3 else 10
+    dst = open_dst(sys.argv[1])
+    start = time.monotonic()
+    seq = 0
+    try:
+        while seq < fps * seconds:
+            t = seq / fps
+            values = [int(127.5 + 127.5 * math.sin(2 * math.pi * (t - n / LED_CNT))) for n in range(LED_CNT)]
+            dst.write(frame(FRAME_TYPE_VALUES, seq, values))
+            seq += 1
+            delay = start + seq / fps - time.monotonic()
+            if delay > 0 and hasattr(dst, 'in_waiting'):
+                time.sleep(delay)
+    except KeyboardInterrupt:
+        pass
+    dst.write(frame(FRAME_TYPE_STOP, seq, [0] * LED_CNT))
+    dst.close()
+
+
+if __name__ == '__main__':
+    main()
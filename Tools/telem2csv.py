@@ -0,0 +1,97 @@
+#!/usr/bin/env python3
+"""Decode LedTree binary telemetry (see LedTree_fw/Telemetry.h) into CSV.
+
+Usage:
+    telem2csv.py /dev/ttyUSB0 [baudrate] > out.csv   # needs pyserial
+    telem2csv.py capture.bin > out.csv               # raw capture file
+
+Start the stream with shell command "Telem <rate_hz>", stop with "Telem 0".
+Frames with bad CRC (e.g. text output between frames) are counted and skipped.
+"""
+import struct
+import sys
+
+FRAME_TYPE_LEDS = 0x01
+HDR = struct.Struct('<BBHI')
+
+
+def cobs_decode(data):
+    out = bytearray()
+    i = 0
+    while i < len(data):
+        code = data[i]
+        if code == 0 or i + code > len(data):
+            return None
+        out += data[i + 1:i + code]
+        i += code
+        if code != 0xFF and i < len(data):
+            out.append(0)
+    return bytes(out)
+
+
+def crc16(data, crc=0xFFFF):
+    for b in data:
+        crc ^= b << 8
+        for _ in range(8):
+            crc = ((crc << 1) ^ 0x1021) if crc & 0x8000 else (crc << 1)
+            crc &= 0xFFFF
+    return crc
+
+
+def parse(frame):
+    if len(frame) < HDR.size + 2 or crc16(frame[:-2]) != struct.unpack_from('<H', frame, len(frame) - 2)[0]:
+        return None
+    ftype, led_cnt, seq, time_ms = HDR.unpack_from(frame)
+    if ftype != FRAME_TYPE_LEDS or len(frame) != HDR.size + 2 * led_cnt + 8:
+        return None
+    pwm = struct.unpack_from('<%dH' % led_cnt, frame, HDR.size)
+    brt, adc, qmain, qleds = struct.unpack_from('<HHBB', frame, HDR.size + 2 * led_cnt)
+    return [seq, time_ms] + list(pwm) + [brt, adc, qmain, qleds]
+
+
+def chunks(src):
+    if src.startswith('/dev/') or src.upper().startswith('COM'):
+        import serial
+        baud = int(sys.argv[2]) if len(sys.argv) > 2 else 115200
+        port = serial.Serial(src, baud, timeout=1)
+        while True:
+            yield port.read(port.in_waiting or 1)
+    else:
+        with open(src, 'rb') as f:
+            while True:
+                b = f.read(4096)
+                if not b:
+                    return
+                yield b
+
+
+def main():
+    if len(sys.argv) < 2:
+        sys.exit(__doc__)
+    buf = bytearray()
+    header_done = False
+    bad = 0
+    try:
+        for chunk in chunks(sys.argv[1]):
+            buf += chunk
+            while 0 in buf:
+                i = buf.index(0)
+                raw, buf = bytes(buf[:i]), buf[i + 1:]
+                frame = cobs_decode(raw) if raw else None
+                row = parse(frame) if frame else None
+                if row is None:
+                    bad += 1 if raw else 0
+                    continue
+                if not header_done:
+                    led_cnt = len(row) - 6
+                    print(','.join(['seq', 'time_ms'] + ['pwm%d' % n for n in range(led_cnt)] +
+                                   ['brt', 'adc', 'q_main', 'q_leds']))
+                    header_done = True
+                print(','.join(str(v) for v in row))
+    except KeyboardInterrupt:
+        pass
+    sys.stderr.write('bad frames: %d\n' % bad)
+
+
+if __name__ == '__main__':
+    main()
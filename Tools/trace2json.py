@@ -0,0 +1,154 @@
+#!/usr/bin/env python3
+"""Convert LedTree kernel trace dump (see LedTree_fw/kl_lib/kl_trace.h) to
+Chrome trace JSON: open it in chrome://tracing or https://ui.perfetto.dev.
+
+Usage:
+    trace2json.py /dev/ttyACM0 [baudrate] > trace.json   # sends "Trace", needs pyserial
+    trace2json.py capture.bin > trace.json               # raw capture file
+
+Rows: one per thread (slice shows why thread left CPU), IRQ, MSD commands
+and flash programming.
+"""
+import json
+import struct
+import sys
+
+FRAME_HEADER, FRAME_NAME, FRAME_EVENT, FRAME_END = 0x10, 0x11, 0x12, 0x13
+EV_SWITCH, EV_ISR_ENTER, EV_ISR_LEAVE, EV_HALT, EV_USER = 1, 2, 3, 4, 5
+NO_ID = 0xFF
+STATE_NAMES = ["READY", "CURRENT", "WTSTART", "SUSPENDED", "QUEUED", "WTSEM", "WTMTX",
+               "WTCOND", "SLEEPING", "WTEXIT", "WTOREVT", "WTANDEVT", "SNDMSGQ",
+               "SNDMSG", "WTMSG", "FINAL"]
+# TraceTag_t: tag -> (row, begin)
+USER_TAGS = {1: ('MSD', True), 2: ('MSD', False), 3: ('Flash', True), 4: ('Flash', False)}
+TID_IRQ, TID_USER = 1000, {'MSD': 1001, 'Flash': 1002}
+RT_WRAP = 1 << 24
+
+
+def cobs_decode(data):
+    out = bytearray()
+    i = 0
+    while i < len(data):
+        code = data[i]
+        if code == 0 or i + code > len(data):
+            return None
+        out += data[i + 1:i + code]
+        i += code
+        if code != 0xFF and i < len(data):
+            out.append(0)
+    return bytes(out)
+
+
+def crc16(data, crc=0xFFFF):
+    for b in data:
+        crc ^= b << 8
+        for _ in range(8):
+            crc = ((crc << 1) ^ 0x1021) if crc & 0x8000 else (crc << 1)
+            crc &= 0xFFFF
+    return crc
+
+
+def frames(chunks):
+    buf = bytearray()
+    for chunk in chunks:
+        buf += chunk
+        while 0 in buf:
+            i = buf.index(0)
+            raw, buf = bytes(buf[:i]), buf[i + 1:]
+            f = cobs_decode(raw) if raw else None
+            if f and len(f) > 2 and crc16(f[:-2]) == struct.unpack_from('<H', f, len(f) - 2)[0]:
+                yield f[:-2]
+                if f[0] == FRAME_END:
+                    return
+
+
+def chunks(src):
+    if src.startswith('/dev/') or src.upper().startswith('COM'):
+        import serial
+        baud = int(sys.argv[2]) if len(sys.argv) > 2 else 115200
+        port = serial.Serial(src, baud, timeout=2)
+        port.reset_input_buffer()
+        port.write(b'Trace\r')
+        while True:
+            b = port.read(port.in_waiting or 1)
+            if not b:
+                return
+            yield b
+    else:
+        with open(src, 'rb') as f:
+            while True:
+                b = f.read(4096)
+                if not b:
+                    return
+                yield b
+
+
+def decode(src):
+    core_hz, st_freq = 64000000, 10000
+    threads, strs, events = {}, {}, []
+    for f in frames(chunks(src)):
+        if f[0] == FRAME_HEADER:
+            _, _, _, core_hz, st_freq = struct.unpack_from('<BBHII', f)
+        elif f[0] == FRAME_NAME:
+            (threads if f[1] == 0 else strs)[f[2]] = f[3:].decode('latin-1')
+        elif f[0] == FRAME_EVENT:
+            ev_type, state, ev_id, rt, time_st = struct.unpack_from('<BBBII', f, 1)
+            up = struct.unpack_from('<II', f, 12) if ev_type == EV_USER else (0, 0)
+            events.append((ev_type, state, ev_id, rt, time_st, up))
+    return core_hz, st_freq, threads, strs, events
+
+
+def timestamps(events, core_hz, st_freq):
+    """24-bit cycle stamps unwrapped with help of system time, in us."""
+    out, cyc = [], 0
+    prev = None
+    for ev in events:
+        rt, time_st = ev[3], ev[4]
+        if prev is not None:
+            d = (rt - prev[0]) % RT_WRAP
+            d_sys = ((time_st - prev[1]) & 0xFFFFFFFF) * core_hz // st_freq
+            if d_sys > RT_WRAP * 3 // 4:  # Counter wrapped more than once
+                d += round((d_sys - d) / RT_WRAP) * RT_WRAP
+            cyc += d
+        prev = (rt, time_st)
+        out.append(cyc * 1e6 / core_hz)
+    return out
+
+
+def main():
+    if len(sys.argv) < 2:
+        sys.exit(__doc__)
+    core_hz, st_freq, threads, strs, events = decode(sys.argv[1])
+    ts = timestamps(events, core_hz, st_freq)
+    trace = []
+    for tid, name in threads.items():
+        trace.append({'ph': 'M', 'name': 'thread_name', 'pid': 1, 'tid': tid, 'args': {'name': name}})
+    trace.append({'ph': 'M', 'name': 'thread_name', 'pid': 1, 'tid': TID_IRQ, 'args': {'name': 'IRQ'}})
+    for row, tid in TID_USER.items():
+        trace.append({'ph': 'M', 'name': 'thread_name', 'pid': 1, 'tid': tid, 'args': {'name': row}})
+    running, run_start = None, None
+    for (ev_type, state, ev_id, _, _, up), t in zip(events, ts):
+        if ev_type == EV_SWITCH:
+            if running is not None:
+                trace.append({'ph': 'X', 'name': threads.get(running, '?'), 'pid': 1, 'tid': running,
+                              'ts': run_start, 'dur': t - run_start,
+                              'args': {'left as': STATE_NAMES[state] if state < len(STATE_NAMES) else state}})
+            running, run_start = ev_id, t
+        elif ev_type in (EV_ISR_ENTER, EV_ISR_LEAVE):
+            trace.append({'ph': 'B' if ev_type == EV_ISR_ENTER else 'E', 'name': strs.get(ev_id, '?'),
+                          'pid': 1, 'tid': TID_IRQ, 'ts': t})
+        elif ev_type == EV_HALT:
+            trace.append({'ph': 'i', 's': 'g', 'name': 'HALT ' + strs.get(ev_id, '?'), 'pid': 1, 'tid': TID_IRQ, 'ts': t})
+        elif ev_type == EV_USER:
+            row, begin = USER_TAGS.get(up[0], ('User', None))
+            if begin is None:
+                trace.append({'ph': 'i', 's': 't', 'name': 'User %u: %u' % up, 'pid': 1, 'tid': TID_IRQ, 'ts': t})
+            else:
+                name = 'SCSI %02X' % up[1] if row == 'MSD' else 'Prg %08X' % up[1]
+                trace.append({'ph': 'B' if begin else 'E', 'name': name, 'pid': 1, 'tid': TID_USER[row], 'ts': t})
+    json.dump({'traceEvents': trace, 'displayTimeUnit': 'ns'}, sys.stdout, indent=0)
+    sys.stderr.write('%d events, %d threads, %.1f ms\n' % (len(events), len(threads), ts[-1] / 1000 if ts else 0))
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,124 @@
+#!/usr/bin/env python3
+"""USB capture to Bulk-Only Transport stream of HostTest/scsi_test.
+
+Usage:
+    usbcap2stream.py capture.pcap stream.bin [device]
+
+Capture is pcap file of bulk traffic of the mass storage device:
+- Linux: usbmon, by Wireshark or "tcpdump -i usbmonN -w capture.pcap"
+  (link types 189 and 220). Text interface of usbmon cuts data to 32 bytes,
+  so it does not do.
+- Windows: USBPcap, by Wireshark or USBPcapCMD (link type 249).
+Take it from plugging the device in, with snap length big enough for whole
+transfers, which is the default of all of them.
+
+Stream is what scsi_test records and replays: CBW, OUT data if any, CSW.
+Replay checks status and residue of every command:
+    scsi_test replay stream.bin
+or both steps at once: make -C HostTest replay CAP=capture.pcap
+
+Device is its address on the bus; by default it is the one sending the first
+CBW. Commands without CSW (reset recovery) are dropped, as their outcome
+depends on host timing.
+"""
+import struct
+import sys
+
+CBW_SIGNATURE = 0x43425355
+CSW_SIGNATURE = 0x53425355
+CBW_SZ = 31
+CSW_SZ = 13
+XFER_BULK = 3           # usbmon
+USBPCAP_BULK = 3
+
+
+def records(data):
+    """Yields (device, endpoint, is_completion, payload) of bulk transfers."""
+    magic, = struct.unpack_from('<I', data, 0)
+    if magic == 0xA1B2C3D4 or magic == 0xA1B23C4D:
+        endian = '<'
+    elif magic in (0xD4C3B2A1, 0x4D3CB2A1):
+        endian = '>'
+    else:
+        sys.exit('Not a pcap file (pcapng is to be saved as pcap)')
+    link, = struct.unpack_from(endian + 'I', data, 20)
+    pos = 24
+    while pos + 16 <= len(data):
+        caplen, = struct.unpack_from(endian + 'I', data, pos + 8)
+        pkt = data[pos + 16:pos + 16 + caplen]
+        pos += 16 + caplen
+        if link in (189, 220):     # usbmon, host byte order: little endian
+            hdr_sz = 64 if link == 220 else 48
+            if len(pkt) < hdr_sz:
+                continue
+            ev, xfer, ep, dev, _bus, _fs, flag_data = struct.unpack_from('<cBBBHbb', pkt, 8)
+            length, len_cap = struct.unpack_from('<II', pkt, 32)
+            if xfer != XFER_BULK:
+                continue
+            payload = pkt[hdr_sz:hdr_sz + len_cap] if flag_data == 0 else b''
+            if len(payload) < len_cap:
+                sys.exit('Capture is cut: snap length is too small')
+            yield dev, ep, ev == b'C', payload
+        elif link == 249:           # USBPcap
+            hdr_len, = struct.unpack_from('<H', pkt, 0)
+            info, _bus, dev, ep, xfer, length = struct.unpack_from('<BHHBBI', pkt, 16)
+            if xfer != USBPCAP_BULK:
+                continue
+            payload = pkt[hdr_len:hdr_len + length]
+            if len(payload) < length:
+                sys.exit('Capture is cut: snap length is too small')
+            yield dev, ep, bool(info & 1), payload
+        else:
+            sys.exit('Link type %d is not USB capture' % link)
+
+
+def convert(data, device=None):
+    """Returns stream and number of commands in it."""
+    out = bytearray()
+    cbw, out_data, cnt = None, bytearray(), 0
+    for dev, ep, done, payload in records(data):
+        if not payload:
+            continue
+        is_in = bool(ep & 0x80)
+        # OUT data is seen at submission, IN data at completion
+        if is_in != done:
+            continue
+        if device is None:
+            if is_in or len(payload) != CBW_SZ or struct.unpack_from('<I', payload)[0] != CBW_SIGNATURE:
+                continue
+            device = dev
+        if dev != device:
+            continue
+        if not is_in:
+            if len(payload) == CBW_SZ and struct.unpack_from('<I', payload)[0] == CBW_SIGNATURE:
+                cbw, out_data = payload, bytearray()
+            elif cbw is not None:
+                out_data += payload
+        elif cbw is not None and len(payload) == CSW_SZ:
+            sig, tag = struct.unpack_from('<II', payload)
+            if sig != CSW_SIGNATURE or tag != struct.unpack_from('<I', cbw, 4)[0]:
+                continue
+            data_len, flags = struct.unpack_from('<IB', cbw, 8)
+            out += cbw
+            if not flags & 0x80:
+                # Host may send less than announced: rest is padded, residue tells
+                out += out_data[:data_len] + bytes(max(0, data_len - len(out_data)))
+            out += payload
+            cbw = None
+            cnt += 1
+    return bytes(out), cnt
+
+
+def main():
+    if len(sys.argv) not in (3, 4):
+        sys.exit(__doc__)
+    device = int(sys.argv[3]) if len(sys.argv) == 4 else None
+    stream, cnt = convert(open(sys.argv[1], 'rb').read(), device)
+    if cnt == 0:
+        sys.exit('No mass storage commands found')
+    open(sys.argv[2], 'wb').write(stream)
+    sys.stderr.write('%d commands, %d bytes\n' % (cnt, len(stream)))
+
+
+if __name__ == '__main__':
+    main()